@@ -309,7 +309,8 @@ extern pgd_t swapper_pg_dir[PTRS_PER_PGD];
 
 #define pmd_none(pmd)		(!pmd_val(pmd))
 #define pmd_present(pmd)	(pmd_val(pmd))
-#define pmd_bad(pmd)		(pmd_val(pmd) & 2)
+#define pmd_bad(pmd)		(pmd_val(pmd) &&			\
+				 (pmd_val(pmd) & PMD_TYPE_MASK) != PMD_TYPE_TABLE)
 
 #define copy_pmd(pmdpd,pmdps)		\
 	do {				\
@@ -330,7 +331,12 @@ static inline pte_t *pmd_page_vaddr(pmd_t pmd)
 	return __va(pmd_val(pmd) & PAGE_MASK);
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define pmd_page(pmd)		pfn_to_page(__phys_to_pfn(pmd_val(pmd) &	\
+				(pmd_trans_huge(pmd) ? SECTION_MASK : PAGE_MASK)))
+#else
 #define pmd_page(pmd)		pfn_to_page(__phys_to_pfn(pmd_val(pmd)))
+#endif
 
 /* we don't need complex calculations here as the pmd is folded into the pgd */
 #define pmd_addr_end(addr,end)	(end)
@@ -412,6 +418,87 @@ static inline pte_t pte_modify(pte_t pte, pgprot_t newprot)
 	return pte;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#include <asm/domain.h>
+
+/*
+ * Transparent huge pages are mapped by a pair of 1MB sections, so that a
+ * huge pmd covers the same 2MB as a pair of page tables.  TEX remapping
+ * (ARMv7) leaves TEX[2:1] of section entries to software; TEX[2] marks a
+ * huge pmd that is being split.
+ *
+ * Sections have no "accessed" bit either.  An old huge pmd keeps its
+ * value but has its type cleared, so the hardware faults on it and
+ * huge_pmd_set_accessed() makes it young again.  This means any non-empty
+ * pmd that does not point to a page table is a huge pmd.  There is no
+ * "dirty" bit: only anonymous memory is mapped huge, and that is always
+ * dirty.
+ */
+#define HPAGE_SHIFT		PMD_SHIFT
+#define HPAGE_SIZE		(_AC(1, UL) << HPAGE_SHIFT)
+#define HPAGE_MASK		(~(HPAGE_SIZE - 1))
+
+#define PMD_SECT_SPLITTING	PMD_SECT_TEX(4)
+
+#ifdef CONFIG_SMP
+#define PMD_SECT_HUGE_S		PMD_SECT_S
+#else
+#define PMD_SECT_HUGE_S		0
+#endif
+
+#define PMD_SECT_HUGE_USER	(PMD_TYPE_SECT | PMD_SECT_AP_WRITE |	\
+				 PMD_SECT_nG | PMD_SECT_WBWA |		\
+				 PMD_SECT_HUGE_S | PMD_DOMAIN(DOMAIN_USER))
+
+#define pmd_trans_huge(pmd)	\
+	(pmd_val(pmd) && !(pmd_val(pmd) & PMD_TYPE_TABLE))
+#define pmd_trans_splitting(pmd) \
+	(pmd_trans_huge(pmd) && (pmd_val(pmd) & PMD_SECT_SPLITTING))
+#define pmd_young(pmd)		((pmd_val(pmd) & PMD_TYPE_MASK) == PMD_TYPE_SECT)
+#define pmd_write(pmd)		(!(pmd_val(pmd) & PMD_SECT_APX))
+
+#define PMD_BIT_FUNC(fn,op) \
+static inline pmd_t pmd_##fn(pmd_t pmd) { pmd_val(pmd) op; return pmd; }
+
+PMD_BIT_FUNC(wrprotect,		|= PMD_SECT_APX);
+PMD_BIT_FUNC(mkwrite,		&= ~PMD_SECT_APX);
+PMD_BIT_FUNC(mkold,		&= ~PMD_TYPE_MASK);
+PMD_BIT_FUNC(mkyoung,		|= PMD_TYPE_SECT);
+PMD_BIT_FUNC(mknotpresent,	&= ~PMD_TYPE_MASK);
+PMD_BIT_FUNC(mksplitting,	|= PMD_SECT_SPLITTING);
+
+static inline pmd_t pmd_mkdirty(pmd_t pmd) { return pmd; }
+static inline pmd_t pmd_mkhuge(pmd_t pmd) { return pmd; }
+
+static inline pmd_t pmd_modify(pmd_t pmd, pgprot_t newprot)
+{
+	const unsigned long mask = PMD_SECT_APX | PMD_SECT_XN |
+				   PMD_SECT_AP_READ;
+	unsigned long val = 0;
+
+	if (pgprot_val(newprot) & L_PTE_RDONLY)
+		val |= PMD_SECT_APX;
+	if (pgprot_val(newprot) & L_PTE_XN)
+		val |= PMD_SECT_XN;
+	if (pgprot_val(newprot) & L_PTE_USER)
+		val |= PMD_SECT_AP_READ;
+
+	pmd_val(pmd) = (pmd_val(pmd) & ~mask) | val;
+	return pmd;
+}
+
+#define mk_pmd(page,prot)	\
+	pmd_modify(__pmd(__pfn_to_phys(page_to_pfn(page)) | PMD_SECT_HUGE_USER), \
+		   prot)
+
+extern void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+		       pmd_t *pmdp, pmd_t pmd);
+
+#define __HAVE_ARCH_PMDP_GET_AND_CLEAR
+#define pmdp_get_and_clear(mm, addr, pmdp)	\
+	({ pmd_t __old = *(pmdp); pmd_clear(pmdp); __old; })
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 /*
  * Encode and decode a swap entry.  Swap entries are stored in the Linux
  * page tables as follows:
@@ -580,6 +580,9 @@ static inline void update_mmu_cache(struct vm_area_struct *vma,
 }
 #endif
 
+/* huge pmds are made coherent by set_pmd_at() */
+#define update_mmu_cache_pmd(vma, addr, pmd) do { } while (0)
+
 #endif
 
 #endif /* CONFIG_MMU */
@@ -216,6 +216,8 @@ static int need_topology_update(void)
 }
 
 #define ARM_CORTEX_A9_FAMILY 0x410FC090
+#define ARM_CORTEX_A15_FAMILY 0x410FC0F0
+#define ARM_CORTEX_A7_FAMILY 0x410FC070
 
 /* update_cpu_topology_policy select a cpu topology policy according to the
  * available cores.
@@ -248,6 +250,62 @@ static int update_cpu_topology_mask(void)
 	return 0;
 }
 
+/*
+ * cpu capacity management
+ * Relative throughput of each core type at the same frequency. It tells the
+ * scheduler which cpus of a big.LITTLE system are the fast ones. Capacities
+ * are normalized so that the fastest core present gets SCHED_POWER_SCALE;
+ * cores missing from the table count as the fastest.
+ */
+struct cpu_efficiency {
+	int id;
+	unsigned int efficiency;
+};
+
+static const struct cpu_efficiency table_efficiency[] = {
+	{ ARM_CORTEX_A15_FAMILY, 3891 },
+	{ ARM_CORTEX_A7_FAMILY, 2048 },
+	{ 0, 0 },
+};
+
+static DEFINE_PER_CPU(unsigned int, cpu_efficiency);
+static DEFINE_PER_CPU(unsigned int, cpu_capacity);
+
+unsigned long arch_scale_cpu_capacity(int cpu)
+{
+	return per_cpu(cpu_capacity, cpu);
+}
+
+static void update_cpu_capacity(unsigned int cpuid)
+{
+	const struct cpu_efficiency *cpu_eff;
+	unsigned int max_efficiency = 0;
+	unsigned int cpu;
+
+	for (cpu_eff = table_efficiency; cpu_eff->id; cpu_eff++) {
+		if (cpu_eff->id == cpu_topology[cpuid].id) {
+			per_cpu(cpu_efficiency, cpuid) = cpu_eff->efficiency;
+			break;
+		}
+	}
+
+	for_each_possible_cpu(cpu)
+		max_efficiency = max(max_efficiency, per_cpu(cpu_efficiency, cpu));
+	if (!max_efficiency)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		unsigned int efficiency = per_cpu(cpu_efficiency, cpu);
+
+		if (efficiency)
+			per_cpu(cpu_capacity, cpu) =
+				efficiency * SCHED_POWER_SCALE / max_efficiency;
+		else
+			per_cpu(cpu_capacity, cpu) = SCHED_POWER_SCALE;
+	}
+	sched_update_cpu_capacity();
+}
+
 /*
  * store_cpu_topology is called at boot when only one cpu is running
  * and with the mutex cpu_hotplug.lock locked, when several cpus have booted,
@@ -307,6 +365,7 @@ void store_cpu_topology(unsigned int cpuid)
 	 */
 	default_cpu_topology_mask(cpuid);
 
+	update_cpu_capacity(cpuid);
 
 	printk(KERN_INFO "CPU%u: thread %d, cpu %d, socket %d, mpidr %x\n",
 		cpuid, cpu_topology[cpuid].thread_id,
@@ -356,6 +415,7 @@ void init_cpu_topology(void)
 		cpumask_clear(&cpu_topo->thread_sibling);
 
 		per_cpu(cpu_scale, cpu) = SCHED_POWER_SCALE;
+		per_cpu(cpu_capacity, cpu) = SCHED_POWER_SCALE;
 	}
 	smp_wmb();
 }
@@ -402,6 +462,21 @@ static const struct file_operations debugfs_fops = {
 	.write = dbg_write,
 };
 
+static ssize_t dbg_capacity_write(struct file *file, const char __user *buf,
+						size_t size, loff_t *off)
+{
+	ssize_t ret = dbg_write(file, buf, size, off);
+
+	if (ret > 0)
+		sched_update_cpu_capacity();
+	return ret;
+}
+
+static const struct file_operations debugfs_capacity_fops = {
+	.read = dbg_read,
+	.write = dbg_capacity_write,
+};
+
 static struct dentry *topo_debugfs_register(unsigned int cpu,
 						struct dentry *parent)
 {
@@ -419,6 +494,12 @@ static struct dentry *topo_debugfs_register(unsigned int cpu,
 	if (!d)
 		goto err_out;
 
+	d = debugfs_create_file("cpu_capacity", S_IRUGO  | S_IWUGO,
+				cpu_d, &per_cpu(cpu_capacity, cpu),
+				&debugfs_capacity_fops);
+	if (!d)
+		goto err_out;
+
 	return cpu_d;
 
 err_out:
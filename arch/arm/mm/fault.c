@@ -473,6 +473,11 @@ do_translation_fault(unsigned long addr, unsigned int fsr,
 static int
 do_sect_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 {
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* a write to a read-only huge pmd, e.g. copy-on-write after fork */
+	if (addr < TASK_SIZE)
+		return do_page_fault(addr, fsr, regs);
+#endif
 	do_bad_area(addr, fsr, regs);
 	return 0;
 }
@@ -257,6 +257,32 @@ void __sync_icache_dcache(pte_t pteval)
 }
 #endif
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Install a huge pmd: both 1MB sections of the pair, see pgtable.h.
+ * Like set_pte_at(), make the pages coherent with the instruction
+ * cache before user space can execute from them.
+ */
+void set_pmd_at(struct mm_struct *mm, unsigned long addr, pmd_t *pmdp,
+		pmd_t pmd)
+{
+	pmdp[0] = pmd;
+	pmdp[1] = __pmd(pmd_val(pmd) ? pmd_val(pmd) + SECTION_SIZE : 0);
+	flush_pmd_entry(pmdp);
+
+	if (addr < TASK_SIZE && pmd_young(pmd) &&
+	    !(pmd_val(pmd) & PMD_SECT_XN)) {
+		struct page *page = pmd_page(pmd);
+		int i;
+
+		for (i = 0; i < HPAGE_PMD_NR; i++, page++)
+			if (!test_and_set_bit(PG_dcache_clean, &page->flags))
+				__flush_dcache_page(NULL, page);
+		__flush_icache_all();
+	}
+}
+#endif
+
 /*
  * Ensure cache coherency between kernel mapping and userspace mapping
  * of this page.
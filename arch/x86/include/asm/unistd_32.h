@@ -352,10 +352,13 @@
 #define __NR_syncfs             344
 #define __NR_sendmmsg		345
 #define __NR_setns		346
+/* 347 - 350 are reserved for process_vm_readv .. finit_module */
+#define __NR_sched_setattr	351
+#define __NR_sched_getattr	352
 
 #ifdef __KERNEL__
 
-#define NR_syscalls 347
+#define NR_syscalls 353
 
 #define __ARCH_WANT_IPC_PARSE_VERSION
 #define __ARCH_WANT_OLD_READDIR
@@ -681,6 +681,11 @@ __SYSCALL(__NR_syncfs, sys_syncfs)
 __SYSCALL(__NR_sendmmsg, sys_sendmmsg)
 #define __NR_setns				308
 __SYSCALL(__NR_setns, sys_setns)
+/* 309 - 313 are reserved for getcpu .. finit_module */
+#define __NR_sched_setattr			314
+__SYSCALL(__NR_sched_setattr, sys_sched_setattr)
+#define __NR_sched_getattr			315
+__SYSCALL(__NR_sched_getattr, sys_sched_getattr)
 
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
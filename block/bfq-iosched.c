@@ -821,6 +821,25 @@ static inline unsigned long bfq_min_budget(struct bfq_data *bfqd)
 		bfqd->bfq_max_budget / 32;
 }
 
+/*
+ * Flash mode is in effect on non-rotational devices, unless disabled
+ * through sysfs.
+ */
+static inline bool bfq_flash_mode(struct bfq_data *bfqd)
+{
+	return bfqd->bfq_flash_mode && blk_queue_nonrot(bfqd->queue);
+}
+
+/*
+ * A queue is a sequential reader if its recent requests are sync reads
+ * and enough seek samples show that they are not seeky.
+ */
+static inline bool bfq_bfqq_seq_reader(struct bfq_queue *bfqq)
+{
+	return bfq_bfqq_sync(bfqq) && bfq_bfqq_reader(bfqq) &&
+		bfq_sample_valid(bfqq->seek_samples) && !BFQQ_SEEKY(bfqq);
+}
+
 /*
  * Decides whether idling should be done for given device and
  * given active queue.
@@ -830,6 +849,15 @@ static inline bool bfq_queue_nonrot_noidle(struct bfq_data *bfqd,
 {
 	if (active_bfqq == NULL)
 		return false;
+	/*
+	 * In flash mode idling is only worth it for sequential sync
+	 * readers, whose next request is likely to arrive before the
+	 * device would switch to another queue; weight-raised queues
+	 * keep idling to preserve their guarantees.
+	 */
+	if (bfq_flash_mode(bfqd))
+		return !bfq_bfqq_seq_reader(active_bfqq) &&
+			active_bfqq->raising_coeff == 1;
 	/*
 	 * If device is SSD it has no seek penalty, disable idling; but
 	 * do so only if:
@@ -1542,6 +1570,7 @@ static void update_raising_data(struct bfq_data *bfqd, struct bfq_queue *bfqq)
 				bfqq->raising_cur_max_time =
 					bfqd->bfq_raising_rt_max_time;
 			else {
+				bfq_bfqq_flush_served(bfqq);
 				bfqq->raising_coeff = 1;
 				entity->ioprio_changed = 1;
 				__bfq_entity_update_weight_prio(
@@ -1599,8 +1628,15 @@ static int bfq_dispatch_request(struct bfq_data *bfqd,
 		goto expire;
 	}
 
-	/* Finally, insert request into driver dispatch list. */
-	bfq_bfqq_served(bfqq, service_to_charge);
+	/*
+	 * Finally, insert request into driver dispatch list.  In flash
+	 * mode the service trees are updated once per service slot
+	 * instead of once per request, see bfq_bfqq_served_batched().
+	 */
+	if (bfq_flash_mode(bfqd))
+		bfq_bfqq_served_batched(bfqq, service_to_charge);
+	else
+		bfq_bfqq_served(bfqq, service_to_charge);
 	bfq_dispatch_insert(bfqd->queue, rq);
 
 	update_raising_data(bfqd, bfqq);
@@ -1676,18 +1712,10 @@ static int bfq_forced_dispatch(struct bfq_data *bfqd)
 	return dispatched;
 }
 
-static int bfq_dispatch_requests(struct request_queue *q, int force)
+static int __bfq_dispatch_requests(struct bfq_data *bfqd)
 {
-	struct bfq_data *bfqd = q->elevator->elevator_data;
 	struct bfq_queue *bfqq;
-	int max_dispatch;
-
-	bfq_log(bfqd, "dispatch requests: %d busy queues", bfqd->busy_queues);
-	if (bfqd->busy_queues == 0)
-		return 0;
-
-	if (unlikely(force))
-		return bfq_forced_dispatch(bfqd);
+	int max_dispatch, dispatched = 0;
 
 	if((bfqq = bfq_select_queue(bfqd)) == NULL)
 		return 0;
@@ -1714,11 +1742,45 @@ static int bfq_dispatch_requests(struct request_queue *q, int force)
 
 	if (! bfq_dispatch_request(bfqd, bfqq))
 		return 0;
+	dispatched++;
 
-	bfq_log_bfqq(bfqd, bfqq, "dispatched one request of %d"
-		     "(max_disp %d)", bfqq->pid, max_dispatch);
+	/*
+	 * A flash device gains nothing from getting one request per
+	 * call: keep feeding it from the active queue, as long as that
+	 * queue stays in service and within its dispatch limit, without
+	 * going through bfq_select_queue() again.
+	 */
+	while (bfq_flash_mode(bfqd) && bfqd->active_queue == bfqq &&
+	       bfqq->next_rq != NULL && bfqq->dispatched < max_dispatch &&
+	       bfq_dispatch_request(bfqd, bfqq))
+		dispatched++;
 
-	return 1;
+	bfq_log_bfqq(bfqd, bfqq, "dispatched %d request(s) of %d"
+		     "(max_disp %d)", dispatched, bfqq->pid, max_dispatch);
+
+	return dispatched;
+}
+
+static int bfq_dispatch_requests(struct request_queue *q, int force)
+{
+	struct bfq_data *bfqd = q->elevator->elevator_data;
+	u64 start;
+	int dispatched;
+
+	bfq_log(bfqd, "dispatch requests: %d busy queues", bfqd->busy_queues);
+	if (bfqd->busy_queues == 0)
+		return 0;
+
+	if (unlikely(force))
+		return bfq_forced_dispatch(bfqd);
+
+	start = local_clock();
+	dispatched = __bfq_dispatch_requests(bfqd);
+	bfqd->dispatch_ns += local_clock() - start;
+	bfqd->dispatch_calls++;
+	bfqd->dispatch_rqs += dispatched;
+
+	return dispatched;
 }
 
 /*
@@ -2105,6 +2167,11 @@ static void bfq_rq_enqueued(struct bfq_data *bfqd, struct bfq_queue *bfqq,
 	if (rq->cmd_flags & REQ_META)
 		bfqq->meta_pending++;
 
+	if (rq_data_dir(rq) == READ)
+		bfq_mark_bfqq_reader(bfqq);
+	else
+		bfq_clear_bfqq_reader(bfqq);
+
 	bfq_update_io_thinktime(bfqd, cic);
 	bfq_update_io_seektime(bfqd, bfqq, rq);
 	if (bfqq->entity.service > bfq_max_budget(bfqd) / 8 ||
@@ -2678,6 +2745,8 @@ static void *bfq_init_queue(struct request_queue *q)
 	bfqd->bfq_raising_min_inter_arr_async = msecs_to_jiffies(500);
 	bfqd->bfq_raising_max_softrt_rate = 7000;
 
+	bfqd->bfq_flash_mode = 1;
+
 	return bfqd;
 }
 
@@ -2773,6 +2842,7 @@ SHOW_FUNCTION(bfq_max_budget_async_rq_show, bfqd->bfq_max_budget_async_rq, 0);
 SHOW_FUNCTION(bfq_timeout_sync_show, bfqd->bfq_timeout[BLK_RW_SYNC], 1);
 SHOW_FUNCTION(bfq_timeout_async_show, bfqd->bfq_timeout[BLK_RW_ASYNC], 1);
 SHOW_FUNCTION(bfq_low_latency_show, bfqd->low_latency, 0);
+SHOW_FUNCTION(bfq_flash_mode_show, bfqd->bfq_flash_mode, 0);
 SHOW_FUNCTION(bfq_raising_coeff_show, bfqd->bfq_raising_coeff, 0);
 SHOW_FUNCTION(bfq_raising_max_time_show, bfqd->bfq_raising_max_time, 1);
 SHOW_FUNCTION(bfq_raising_rt_max_time_show, bfqd->bfq_raising_rt_max_time, 1);
@@ -2885,6 +2955,48 @@ static ssize_t bfq_timeout_sync_store(struct elevator_queue *e,
 	return ret;
 }
 
+static ssize_t bfq_flash_mode_store(struct elevator_queue *e,
+				    const char *page, size_t count)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	unsigned long __data;
+	int ret = bfq_var_store(&__data, (page), count);
+
+	if (__data > 1)
+		__data = 1;
+	bfqd->bfq_flash_mode = __data;
+
+	return ret;
+}
+
+static ssize_t bfq_dispatch_stats_show(struct elevator_queue *e, char *page)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	u64 avg_ns = 0;
+
+	if (bfqd->dispatch_rqs != 0) {
+		avg_ns = bfqd->dispatch_ns;
+		do_div(avg_ns, bfqd->dispatch_rqs);
+	}
+
+	return sprintf(page, "calls %lu, requests %lu, ns/request %llu\n",
+		       bfqd->dispatch_calls, bfqd->dispatch_rqs,
+		       (unsigned long long)avg_ns);
+}
+
+/* any write resets the counters */
+static ssize_t bfq_dispatch_stats_store(struct elevator_queue *e,
+					const char *page, size_t count)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+
+	bfqd->dispatch_calls = 0;
+	bfqd->dispatch_rqs = 0;
+	bfqd->dispatch_ns = 0;
+
+	return count;
+}
+
 static ssize_t bfq_low_latency_store(struct elevator_queue *e,
 				     const char *page, size_t count)
 {
@@ -2921,6 +3033,8 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(raising_min_inter_arr_async),
 	BFQ_ATTR(raising_max_softrt_rate),
 	BFQ_ATTR(weights),
+	BFQ_ATTR(flash_mode),
+	BFQ_ATTR(dispatch_stats),
 	__ATTR_NULL
 };
 
@@ -600,6 +600,37 @@ static void bfq_bfqq_served(struct bfq_queue *bfqq, unsigned long served)
 	bfq_log_bfqq(bfqq->bfqd, bfqq, "bfqq_served %lu secs", served);
 }
 
+/**
+ * bfq_bfqq_served_batched - charge service to the queue only.
+ * @bfqq: the queue being served.
+ * @served: bytes to transfer.
+ *
+ * Keeps the budget accounting of @bfqq exact, but defers the walk
+ * through the upper level entities and service trees to
+ * bfq_bfqq_flush_served(), that __bfq_bfqd_reset_active() runs before
+ * @bfqq stops being in service.
+ */
+static inline void bfq_bfqq_served_batched(struct bfq_queue *bfqq,
+					   unsigned long served)
+{
+	BUG_ON(bfqq->entity.service + served > bfqq->entity.budget);
+
+	bfqq->entity.service += served;
+	bfqq->service_pending += served;
+}
+
+static void bfq_bfqq_flush_served(struct bfq_queue *bfqq)
+{
+	unsigned long served = bfqq->service_pending;
+
+	if (served == 0)
+		return;
+
+	bfqq->service_pending = 0;
+	bfqq->entity.service -= served;
+	bfq_bfqq_served(bfqq, served);
+}
+
 /**
  * bfq_bfqq_charge_full_budget - set the service to the entity budget.
  * @bfqq: the queue that needs a service update.
@@ -616,6 +647,7 @@ static inline void bfq_bfqq_charge_full_budget(struct bfq_queue *bfqq)
 
 	bfq_log_bfqq(bfqq->bfqd, bfqq, "charge_full_budget");
 
+	bfq_bfqq_flush_served(bfqq);
 	bfq_bfqq_served(bfqq, entity->budget - entity->service);
 }
 
@@ -1002,6 +1034,13 @@ static void bfq_get_next_queue_forced(struct bfq_data *bfqd,
 
 static void __bfq_bfqd_reset_active(struct bfq_data *bfqd)
 {
+	/*
+	 * Charge the batched service to the hierarchy the queue was
+	 * served in, before it can be deactivated or moved.
+	 */
+	if (bfqd->active_queue != NULL)
+		bfq_bfqq_flush_served(bfqd->active_queue);
+
 	if (bfqd->active_cic != NULL) {
 		put_io_context(bfqd->active_cic->ioc);
 		bfqd->active_cic = NULL;
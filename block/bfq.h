@@ -236,6 +236,9 @@ struct bfq_queue {
 	unsigned int raising_cur_max_time;
 	u64 last_rais_start_finish, soft_rt_next_start;
 	unsigned int raising_coeff;
+
+	/* service charged to the entity but not yet to the service trees */
+	unsigned long service_pending;
 };
 
 /**
@@ -299,6 +302,11 @@ struct bfq_queue {
  *                                   (in jiffies)
  * @bfq_raising_max_softrt_rate: max service-rate for a soft real-time queue,
  *			         sectors per seconds
+ * @bfq_flash_mode: on non-rotational devices, idle only for sequential
+ *		    sync readers and batch service tree updates.
+ * @dispatch_calls: number of non-forced dispatch rounds.
+ * @dispatch_rqs: number of requests they dispatched.
+ * @dispatch_ns: CPU time spent in them, in ns.
  * @oom_bfqq: fallback dummy bfqq for extreme OOM conditions
  *
  * All the fields are protected by the @queue lock.
@@ -362,6 +370,11 @@ struct bfq_data {
 	unsigned int bfq_raising_min_inter_arr_async;
 	unsigned int bfq_raising_max_softrt_rate;
 
+	unsigned int bfq_flash_mode;
+	unsigned long dispatch_calls;
+	unsigned long dispatch_rqs;
+	u64 dispatch_ns;
+
 	struct bfq_queue oom_bfqq;
 };
 
@@ -377,6 +390,7 @@ enum bfqq_state_flags {
 	BFQ_BFQQ_FLAG_coop,		/* bfqq is shared */
 	BFQ_BFQQ_FLAG_split_coop,	/* shared bfqq will be splitted */
 	BFQ_BFQQ_FLAG_some_coop_idle,   /* some cooperator is inactive */
+	BFQ_BFQQ_FLAG_reader,		/* last queued request was a read */
 };
 
 #define BFQ_BFQQ_FNS(name)						\
@@ -404,6 +418,7 @@ BFQ_BFQQ_FNS(budget_new);
 BFQ_BFQQ_FNS(coop);
 BFQ_BFQQ_FNS(split_coop);
 BFQ_BFQQ_FNS(some_coop_idle);
+BFQ_BFQQ_FNS(reader);
 #undef BFQ_BFQQ_FNS
 
 /* Logging facilities. */
@@ -0,0 +1,539 @@
+/*
+ * Multi-queue submission path
+ *
+ * Bios submitted to a queue created with blk_mq_init_queue() never touch
+ * q->queue_lock, the request_list or the elevator.  Each CPU has its own
+ * software queue, and each software queue is mapped to one hardware
+ * dispatch context that owns a fixed set of preallocated, tagged
+ * requests.  Completions are steered back to the submitting CPU.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/cpu.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+
+#include "blk.h"
+
+/*
+ * Per-CPU software queue.  ->lock is only ever taken from process
+ * context: the hardware queues are run from kblockd when kicked from
+ * interrupt context.
+ */
+struct blk_mq_ctx {
+	spinlock_t		lock;
+	struct list_head	rq_list;
+	unsigned int		cpu;
+	unsigned int		index_hw;	/* bit in hctx->ctx_map */
+	unsigned int		last_tag;	/* tag allocation hint */
+	struct request_queue	*queue;
+} ____cacheline_aligned_in_smp;
+
+static inline struct blk_mq_ctx *blk_mq_get_ctx(struct request_queue *q,
+						int cpu)
+{
+	return per_cpu_ptr(q->queue_ctx, cpu);
+}
+
+struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q, const int cpu)
+{
+	return q->queue_hw_ctx[q->mq_map[cpu]];
+}
+EXPORT_SYMBOL(blk_mq_map_queue);
+
+/*
+ * Tag allocation starts where this CPU left off, so CPUs sharing a
+ * hardware context mostly work on different words of the tag map.
+ */
+static int blk_mq_get_tag(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx)
+{
+	unsigned int depth = hctx->queue_depth;
+	unsigned int tag = ctx->last_tag;
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		while ((tag = find_next_zero_bit(hctx->tag_map, depth,
+						 tag)) < depth) {
+			if (!test_and_set_bit_lock(tag, hctx->tag_map)) {
+				ctx->last_tag = tag + 1 < depth ? tag + 1 : 0;
+				return tag;
+			}
+		}
+		tag = 0;
+	}
+
+	return -1;
+}
+
+static void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, unsigned int tag)
+{
+	clear_bit_unlock(tag, hctx->tag_map);
+	smp_mb__after_clear_bit();
+
+	if (waitqueue_active(&hctx->tag_wait))
+		wake_up(&hctx->tag_wait);
+}
+
+static bool blk_mq_tags_exhausted(struct blk_mq_hw_ctx *hctx)
+{
+	return find_first_zero_bit(hctx->tag_map, hctx->queue_depth) >=
+		hctx->queue_depth;
+}
+
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	int bit, ret;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	/*
+	 * Requests the driver bounced earlier go out first.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	/*
+	 * The pending bit is cleared before the software queue is
+	 * emptied and set after it is filled, so a request is never
+	 * left behind without a run to pick it up.
+	 */
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	while (!list_empty(&rq_list)) {
+		rq = list_first_entry(&rq_list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+
+		ret = q->mq_ops->queue_rq(hctx, rq);
+		if (ret == BLK_MQ_RQ_QUEUE_OK)
+			continue;
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY) {
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		}
+
+		blk_mq_end_io(rq, -EIO);
+	}
+
+	if (!list_empty(&rq_list)) {
+		spin_lock(&hctx->lock);
+		list_splice(&rq_list, &hctx->dispatch);
+		spin_unlock(&hctx->lock);
+	}
+}
+
+static void blk_mq_run_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+/**
+ * blk_mq_run_hw_queue - dispatch pending requests of a hardware context
+ * @hctx:	the hardware context
+ * @async:	punt the run to kblockd
+ *
+ * Runs from interrupt context are always punted to kblockd.
+ */
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (!async && !in_interrupt() && !irqs_disabled())
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_work(hctx->queue, &hctx->run_work);
+}
+EXPORT_SYMBOL(blk_mq_run_hw_queue);
+
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return !list_empty_careful(&hctx->dispatch) ||
+		find_first_bit(hctx->ctx_map, hctx->nr_ctx) < hctx->nr_ctx;
+}
+
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		if (blk_mq_hctx_has_pending(hctx))
+			blk_mq_run_hw_queue(hctx, async);
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	clear_bit(BLK_MQ_S_STOPPED, &hctx->state);
+	blk_mq_run_hw_queue(hctx, false);
+}
+EXPORT_SYMBOL(blk_mq_start_hw_queue);
+
+/*
+ * Restart every stopped hardware context, safe from interrupt context.
+ */
+void blk_mq_start_stopped_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		if (test_and_clear_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			blk_mq_run_hw_queue(hctx, true);
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+/*
+ * Get a free tagged request from the hardware context of the current
+ * CPU.  May sleep until a completion releases a tag, but can not fail.
+ */
+static struct request *blk_mq_get_request(struct request_queue *q,
+					  struct blk_mq_hw_ctx **hctxp)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	DEFINE_WAIT(wait);
+	int cpu, tag;
+
+	for (;;) {
+		cpu = get_cpu();
+		ctx = blk_mq_get_ctx(q, cpu);
+		hctx = q->mq_ops->map_queue(q, cpu);
+		tag = blk_mq_get_tag(hctx, ctx);
+		put_cpu();
+		if (tag >= 0)
+			break;
+
+		/*
+		 * Out of tags: push out whatever is pending, then wait
+		 * for a completion to release a tag.
+		 */
+		blk_mq_run_hw_queue(hctx, false);
+
+		prepare_to_wait(&hctx->tag_wait, &wait, TASK_UNINTERRUPTIBLE);
+		if (blk_mq_tags_exhausted(hctx))
+			io_schedule();
+		finish_wait(&hctx->tag_wait, &wait);
+	}
+
+	rq = hctx->rqs[tag];
+	blk_rq_init(q, rq);
+	rq->tag = tag;
+	rq->mq_ctx = ctx;
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+
+	*hctxp = hctx;
+	return rq;
+}
+
+static void blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				  struct request *rq)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	spin_lock(&ctx->lock);
+	list_add_tail(&rq->queuelist, &ctx->rq_list);
+	spin_unlock(&ctx->lock);
+
+	set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+static int blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct request *rq;
+
+	blk_queue_bounce(q, &bio);
+
+	rq = blk_mq_get_request(q, &hctx);
+	init_request_from_bio(rq, bio);
+	drive_stat_acct(rq, 1);
+
+	blk_mq_insert_request(hctx, rq);
+	blk_mq_run_hw_queue(hctx, false);
+
+	return 0;
+}
+
+/**
+ * blk_mq_end_io - end all the bios of a request and release its tag
+ * @rq:		the request being completed
+ * @error:	%0 for success, < %0 for error
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	struct request_queue *q = rq->q;
+
+	if (blk_update_request(rq, error, blk_rq_bytes(rq)))
+		BUG();
+
+	blk_account_io_done(rq);
+	blk_mq_put_tag(q->mq_ops->map_queue(q, rq->mq_ctx->cpu), rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+static void __blk_mq_complete_request(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	if (q->mq_ops->complete)
+		q->mq_ops->complete(rq);
+	else
+		blk_mq_end_io(rq, rq->errors);
+}
+
+#if defined(CONFIG_SMP) && defined(CONFIG_USE_GENERIC_SMP_HELPERS)
+static void blk_mq_complete_remote(void *data)
+{
+	__blk_mq_complete_request(data);
+}
+
+static bool blk_mq_complete_on(struct request *rq, int cpu)
+{
+	struct request_queue *q = rq->q;
+	int ccpu = rq->mq_ctx->cpu;
+
+	if (!test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) || ccpu == cpu)
+		return false;
+	if (!test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags) &&
+	    blk_cpu_to_group(ccpu) == blk_cpu_to_group(cpu))
+		return false;
+	if (!cpu_online(ccpu))
+		return false;
+
+	rq->csd.func = blk_mq_complete_remote;
+	rq->csd.info = rq;
+	rq->csd.flags = 0;
+	__smp_call_function_single(ccpu, &rq->csd, 0);
+	return true;
+}
+#else
+static bool blk_mq_complete_on(struct request *rq, int cpu)
+{
+	return false;
+}
+#endif
+
+/**
+ * blk_mq_complete_request - complete a request on its submitting CPU
+ * @rq:		the request being completed
+ *
+ * Meant to be called from the driver's interrupt handler.  Ends the
+ * request through ->complete() if the driver has one.
+ */
+void blk_mq_complete_request(struct request *rq)
+{
+	bool remote;
+
+	remote = blk_mq_complete_on(rq, get_cpu());
+	put_cpu();
+
+	if (!remote)
+		__blk_mq_complete_request(rq);
+}
+EXPORT_SYMBOL(blk_mq_complete_request);
+
+static int blk_mq_init_rq_map(struct blk_mq_hw_ctx *hctx,
+			      unsigned int cmd_size)
+{
+	unsigned int i;
+
+	hctx->tag_map = kzalloc_node(BITS_TO_LONGS(hctx->queue_depth) *
+				     sizeof(unsigned long), GFP_KERNEL,
+				     hctx->numa_node);
+	hctx->rqs = kzalloc_node(hctx->queue_depth * sizeof(struct request *),
+				 GFP_KERNEL, hctx->numa_node);
+	if (!hctx->tag_map || !hctx->rqs)
+		return -ENOMEM;
+
+	for (i = 0; i < hctx->queue_depth; i++) {
+		hctx->rqs[i] = kzalloc_node(sizeof(struct request) + cmd_size,
+					    GFP_KERNEL, hctx->numa_node);
+		if (!hctx->rqs[i])
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void blk_mq_free_hw_ctx(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned int i;
+
+	if (hctx->rqs)
+		for (i = 0; i < hctx->queue_depth; i++)
+			kfree(hctx->rqs[i]);
+	kfree(hctx->rqs);
+	kfree(hctx->tag_map);
+	kfree(hctx->ctx_map);
+	kfree(hctx->ctxs);
+	kfree(hctx);
+}
+
+static struct blk_mq_hw_ctx *blk_mq_alloc_hw_ctx(struct request_queue *q,
+						 struct blk_mq_reg *reg,
+						 unsigned int hctx_idx)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = kzalloc_node(sizeof(*hctx), GFP_KERNEL, reg->numa_node);
+	if (!hctx)
+		return NULL;
+
+	spin_lock_init(&hctx->lock);
+	INIT_LIST_HEAD(&hctx->dispatch);
+	INIT_WORK(&hctx->run_work, blk_mq_run_work_fn);
+	init_waitqueue_head(&hctx->tag_wait);
+	hctx->queue = q;
+	hctx->queue_num = hctx_idx;
+	hctx->queue_depth = reg->queue_depth;
+	hctx->numa_node = reg->numa_node;
+
+	hctx->ctxs = kzalloc_node(nr_cpu_ids * sizeof(struct blk_mq_ctx *),
+				  GFP_KERNEL, reg->numa_node);
+	hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+				     sizeof(unsigned long), GFP_KERNEL,
+				     reg->numa_node);
+	if (!hctx->ctxs || !hctx->ctx_map ||
+	    blk_mq_init_rq_map(hctx, reg->cmd_size))
+		goto fail;
+
+	return hctx;
+fail:
+	blk_mq_free_hw_ctx(hctx);
+	return NULL;
+}
+
+/**
+ * blk_mq_init_queue - create a queue using the multi-queue submission path
+ * @reg:	number and depth of the hardware contexts, and driver hooks
+ * @driver_data: passed to ->init_hctx()
+ *
+ * Returns %NULL on failure.  The queue is torn down with
+ * blk_cleanup_queue() as usual.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_ctx *ctx;
+	struct request_queue *q;
+	unsigned int i;
+	int cpu;
+
+	if (!reg->nr_hw_queues || !reg->queue_depth ||
+	    !reg->ops->queue_rq || !reg->ops->map_queue)
+		return NULL;
+
+	if (reg->nr_hw_queues > nr_cpu_ids)
+		reg->nr_hw_queues = nr_cpu_ids;
+	if (reg->queue_depth > BLK_MQ_MAX_DEPTH)
+		reg->queue_depth = BLK_MQ_MAX_DEPTH;
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		return NULL;
+
+	q->mq_ops = reg->ops;
+	q->queue_ctx = alloc_percpu(struct blk_mq_ctx);
+	q->queue_hw_ctx = kzalloc_node(reg->nr_hw_queues * sizeof(hctx),
+				       GFP_KERNEL, reg->numa_node);
+	q->mq_map = kzalloc_node(nr_cpu_ids * sizeof(unsigned int),
+				 GFP_KERNEL, reg->numa_node);
+	if (!q->queue_ctx || !q->queue_hw_ctx || !q->mq_map)
+		goto fail;
+
+	/*
+	 * Neighbouring CPUs share a hardware context.
+	 */
+	for_each_possible_cpu(cpu)
+		q->mq_map[cpu] = cpu * reg->nr_hw_queues / nr_cpu_ids;
+
+	/*
+	 * ->nr_hw_queues only counts fully set up contexts, so that
+	 * blk_mq_free_queue() can undo a partial setup.
+	 */
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		hctx = blk_mq_alloc_hw_ctx(q, reg, i);
+		if (!hctx)
+			goto fail;
+		if (reg->ops->init_hctx &&
+		    reg->ops->init_hctx(hctx, driver_data, i)) {
+			blk_mq_free_hw_ctx(hctx);
+			goto fail;
+		}
+		q->queue_hw_ctx[q->nr_hw_queues++] = hctx;
+	}
+
+	for_each_possible_cpu(cpu) {
+		ctx = blk_mq_get_ctx(q, cpu);
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->cpu = cpu;
+		ctx->queue = q;
+
+		hctx = reg->ops->map_queue(q, cpu);
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->queue_flags |= QUEUE_FLAG_DEFAULT;
+
+	return q;
+fail:
+	blk_cleanup_queue(q);
+	return NULL;
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/*
+ * Called on the final put of a multi-queue request_queue.
+ */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		cancel_work_sync(&hctx->run_work);
+		if (q->mq_ops->exit_hctx)
+			q->mq_ops->exit_hctx(hctx, i);
+		blk_mq_free_hw_ctx(hctx);
+	}
+
+	kfree(q->queue_hw_ctx);
+	kfree(q->mq_map);
+	free_percpu(q->queue_ctx);
+}
@@ -0,0 +1,105 @@
+/*
+ * Hybrid polling for synchronous I/O completions.
+ *
+ * For fast devices the interrupt -> softirq -> wakeup -> context switch
+ * chain can take longer than the I/O itself.  When io_poll is set on a
+ * queue, a task waiting for a synchronous direct I/O first sleeps on a
+ * timer for half of the mean completion latency seen on the queue, then
+ * spins until the completion shows up.  It only falls back to a normal
+ * sleep when the I/O takes much longer than usual.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+
+/*
+ * Devices slower than this gain nothing from spinning.
+ */
+#define BLK_POLL_MAX_NS		(200 * NSEC_PER_USEC)
+
+/*
+ * Keep spinning until this many mean latencies after submission.
+ */
+#define BLK_POLL_SPIN_FACTOR	2
+
+static inline u64 blk_poll_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+/**
+ * blk_poll_account - feed a completion latency into the queue's mean
+ * @q:		the queue the I/O was submitted to
+ * @submit_ns:	submission time of the completed bio, from ktime_get()
+ *
+ * Called from the completion path, possibly in interrupt context and
+ * on several cpus at once.
+ */
+void blk_poll_account(struct request_queue *q, u64 submit_ns)
+{
+	u64 lat = blk_poll_now() - submit_ns;
+	u64 old, new;
+
+	/* exponential moving average, weight 1/8 */
+	do {
+		old = atomic64_read(&q->poll_mean_ns);
+		new = old ? old - (old >> 3) + (lat >> 3) : lat;
+	} while (atomic64_cmpxchg(&q->poll_mean_ns, old, new) != old);
+}
+EXPORT_SYMBOL_GPL(blk_poll_account);
+
+/**
+ * blk_poll_wait - wait for a synchronous I/O by polling
+ * @q:		the queue the I/O was submitted to
+ * @submit_ns:	submission time, from ktime_get()
+ * @done:	returns true once the I/O has completed
+ * @data:	argument for @done
+ *
+ * Returns true if the completion was seen while polling.  False means
+ * polling gave up, and the caller should sleep until it is woken up as
+ * usual.  Must be called in process context with no locks held.
+ */
+bool blk_poll_wait(struct request_queue *q, u64 submit_ns,
+		   bool (*done)(void *), void *data)
+{
+	u64 mean = atomic64_read(&q->poll_mean_ns);
+	u64 start, now, deadline;
+	bool hit = false;
+
+	/*
+	 * No estimate yet, or a device too slow to be worth it: let the
+	 * caller sleep, the completion will still update the mean.
+	 */
+	if (!mean || mean > BLK_POLL_MAX_NS)
+		return false;
+
+	this_cpu_inc(q->poll_stats->polls);
+
+	start = blk_poll_now();
+	if (start - submit_ns < mean / 2) {
+		ktime_t expires = ns_to_ktime(submit_ns + mean / 2);
+
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+		this_cpu_inc(q->poll_stats->sleeps);
+		start = blk_poll_now();
+	}
+
+	deadline = submit_ns + BLK_POLL_SPIN_FACTOR * mean;
+	now = start;
+	while (!(hit = done(data))) {
+		if (need_resched() || now > deadline)
+			break;
+		cpu_relax();
+		now = blk_poll_now();
+	}
+
+	if (hit)
+		this_cpu_inc(q->poll_stats->hits);
+	this_cpu_add(q->poll_stats->spin_ns, now - start);
+
+	return hit;
+}
+EXPORT_SYMBOL_GPL(blk_poll_wait);
@@ -217,6 +217,7 @@ queue_store_##name(struct request_queue *q, const char *page, size_t count) \
 QUEUE_SYSFS_BIT_FNS(nonrot, NONROT, 1);
 QUEUE_SYSFS_BIT_FNS(random, ADD_RANDOM, 0);
 QUEUE_SYSFS_BIT_FNS(iostats, IO_STAT, 0);
+QUEUE_SYSFS_BIT_FNS(io_poll, POLL, 0);
 #undef QUEUE_SYSFS_BIT_FNS
 
 static ssize_t queue_nomerges_show(struct request_queue *q, char *page)
@@ -243,6 +244,27 @@ static ssize_t queue_nomerges_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+static ssize_t queue_poll_stats_show(struct request_queue *q, char *page)
+{
+	struct blk_poll_stats sum = { 0 };
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct blk_poll_stats *ps = per_cpu_ptr(q->poll_stats, cpu);
+
+		sum.polls += ps->polls;
+		sum.hits += ps->hits;
+		sum.sleeps += ps->sleeps;
+		sum.spin_ns += ps->spin_ns;
+	}
+
+	return sprintf(page, "mean_ns %llu\npolls %lu\nhits %lu\n"
+		       "sleeps %lu\nspin_ns %llu\n",
+		       (unsigned long long)atomic64_read(&q->poll_mean_ns),
+		       sum.polls, sum.hits, sum.sleeps,
+		       (unsigned long long)sum.spin_ns);
+}
+
 static ssize_t queue_rq_affinity_show(struct request_queue *q, char *page)
 {
 	bool set = test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags);
@@ -387,6 +409,17 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+static struct queue_sysfs_entry queue_io_poll_entry = {
+	.attr = {.name = "io_poll", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_show_io_poll,
+	.store = queue_store_io_poll,
+};
+
+static struct queue_sysfs_entry queue_poll_stats_entry = {
+	.attr = {.name = "io_poll_stats", .mode = S_IRUGO },
+	.show = queue_poll_stats_show,
+};
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -409,6 +442,8 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+	&queue_io_poll_entry.attr,
+	&queue_poll_stats_entry.attr,
 	NULL,
 };
 
@@ -483,6 +518,12 @@ static void blk_release_queue(struct kobject *kobj)
 		elevator_exit(q->elevator);
 
 	blk_throtl_exit(q);
+	free_percpu(q->poll_stats);
+
+#ifdef CONFIG_BLK_MQ
+	if (q->mq_ops)
+		blk_mq_free_queue(q);
+#endif
 
 	if (rl->rq_pool)
 		mempool_destroy(rl->rq_pool);
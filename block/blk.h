@@ -16,6 +16,12 @@ void blk_rq_bio_prep(struct request_queue *q, struct request *rq,
 int blk_rq_append_bio(struct request_queue *q, struct request *rq,
 		      struct bio *bio);
 void blk_dequeue_request(struct request *rq);
+void drive_stat_acct(struct request *rq, int new_io);
+void blk_account_io_done(struct request *req);
+
+#ifdef CONFIG_BLK_MQ
+void blk_mq_free_queue(struct request_queue *q);
+#endif
 void __blk_queue_free_tags(struct request_queue *q);
 
 void blk_rq_timed_out_timer(unsigned long data);
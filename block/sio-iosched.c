@@ -19,6 +19,9 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/version.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include "blk-cgroup.h"
 
 enum { ASYNC, SYNC };
 
@@ -32,12 +35,38 @@ static const int async_write_expire =  2 * HZ;	/* ditto for async, these limits
 static const int writes_starved = 2;		/* max times reads can starve a write */
 static const int fifo_batch     = 2;		/* # of sequential requests treated as one
 											   by the above parameters. For throughput. */
+static const int group_quantum  = 4;		/* requests a group at the default blkio
+						   weight dispatches per round. 0 disables groups. */
 
-/* Elevator data */
-struct sio_data {
+#define SIO_GROUP_HASH_SHIFT	4
+
+/*
+ * Requests are kept per blkio cgroup. Groups with queued requests sit on a
+ * round-robin list and each dispatches a quantum proportional to its weight
+ * before the next group gets its turn.
+ */
+struct sio_group {
 	/* Request queues */
 	struct list_head fifo_list[2][2];
 
+	struct list_head rr_node;	/* on sio_data->group_rr while busy */
+	struct hlist_node hash_node;
+	unsigned short blkcg_id;
+	unsigned int weight;
+	int credit;			/* requests left in this round */
+	unsigned int nr_queued;
+	int ref;			/* allocated requests pointing here */
+};
+
+/* Elevator data */
+struct sio_data {
+	/* Requests of tasks we could not or did not classify */
+	struct sio_group root_group;
+
+	/* Groups with requests queued, in service order */
+	struct list_head group_rr;
+	struct hlist_head group_hash[1 << SIO_GROUP_HASH_SHIFT];
+
 	/* Attributes */
 	unsigned int batched;
 	unsigned int starved;
@@ -46,17 +75,221 @@ struct sio_data {
 	int fifo_expire[2][2];
 	int fifo_batch;
 	int writes_starved;
+	int group_quantum;
 };
 
+static void
+sio_init_group(struct sio_group *sg)
+{
+	INIT_LIST_HEAD(&sg->fifo_list[SYNC][READ]);
+	INIT_LIST_HEAD(&sg->fifo_list[SYNC][WRITE]);
+	INIT_LIST_HEAD(&sg->fifo_list[ASYNC][READ]);
+	INIT_LIST_HEAD(&sg->fifo_list[ASYNC][WRITE]);
+	INIT_LIST_HEAD(&sg->rr_node);
+	INIT_HLIST_NODE(&sg->hash_node);
+	sg->blkcg_id = 0;
+	sg->weight = BLKIO_WEIGHT_DEFAULT;
+	sg->credit = 0;
+	sg->nr_queued = 0;
+	sg->ref = 0;
+}
+
+static inline struct sio_group *
+sio_rq_group(struct sio_data *sd, struct request *rq)
+{
+	struct sio_group *sg = rq->elevator_private[0];
+
+	return sg ? sg : &sd->root_group;
+}
+
+static int
+sio_group_quantum(struct sio_data *sd, struct sio_group *sg)
+{
+	int quantum = sd->group_quantum * sg->weight / BLKIO_WEIGHT_DEFAULT;
+
+	return max(quantum, 1);
+}
+
+#ifdef CONFIG_SIO_GROUP_IOSCHED
+static dev_t
+sio_queue_dev(struct request_queue *q)
+{
+	struct backing_dev_info *bdi = &q->backing_dev_info;
+	unsigned int major, minor;
+
+	if (bdi->dev && dev_name(bdi->dev) &&
+	    sscanf(dev_name(bdi->dev), "%u:%u", &major, &minor) == 2)
+		return MKDEV(major, minor);
+
+	return 0;
+}
+
+static struct sio_group *
+sio_find_group(struct sio_data *sd, struct blkio_cgroup *blkcg)
+{
+	unsigned short id = css_id(&blkcg->css);
+	struct hlist_head *head;
+	struct hlist_node *n;
+	struct sio_group *sg;
+
+	head = &sd->group_hash[hash_long(id, SIO_GROUP_HASH_SHIFT)];
+	hlist_for_each_entry(sg, n, head, hash_node)
+		if (sg->blkcg_id == id)
+			return sg;
+
+	return NULL;
+}
+
+/*
+ * Find or create the group of the current task. Called with the queue
+ * lock held. Falls back to the root group on allocation failure.
+ */
+static struct sio_group *
+sio_get_group(struct request_queue *q, struct sio_data *sd)
+{
+	struct blkio_cgroup *blkcg;
+	struct sio_group *sg;
+
+	if (!sd->group_quantum)
+		return &sd->root_group;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	sg = sio_find_group(sd, blkcg);
+	if (!sg) {
+		sg = kmalloc_node(sizeof(*sg), GFP_ATOMIC, q->node);
+		if (!sg) {
+			sg = &sd->root_group;
+			goto out;
+		}
+		sio_init_group(sg);
+		sg->blkcg_id = css_id(&blkcg->css);
+		hlist_add_head(&sg->hash_node,
+			       &sd->group_hash[hash_long(sg->blkcg_id,
+							 SIO_GROUP_HASH_SHIFT)]);
+	}
+
+	/* Pick up weight changes whenever the group goes idle */
+	if (!sg->nr_queued)
+		sg->weight = blkcg_get_weight(blkcg, sio_queue_dev(q));
+out:
+	rcu_read_unlock();
+	return sg;
+}
+
+static int
+sio_allow_merge(struct request_queue *q, struct request *rq, struct bio *bio)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	struct sio_group *sg;
+
+	/* Don't let a bio be charged to another group */
+	if (!sd->group_quantum)
+		return 1;
+
+	rcu_read_lock();
+	sg = sio_find_group(sd, task_blkio_cgroup(current));
+	rcu_read_unlock();
+
+	return (sg ? sg : &sd->root_group) == sio_rq_group(sd, rq);
+}
+#else
+static inline struct sio_group *
+sio_get_group(struct request_queue *q, struct sio_data *sd)
+{
+	return &sd->root_group;
+}
+#endif
+
+static void
+sio_put_group(struct sio_data *sd, struct sio_group *sg)
+{
+	BUG_ON(sg->ref <= 0);
+	sg->ref--;
+	if (sg->ref || sg == &sd->root_group)
+		return;
+
+	BUG_ON(sg->nr_queued);
+	hlist_del(&sg->hash_node);
+	kfree(sg);
+}
+
+static int
+sio_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	struct sio_group *sg;
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	sg = sio_get_group(q, sd);
+	sg->ref++;
+	rq->elevator_private[0] = sg;
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	return 0;
+}
+
+static void
+sio_put_request(struct request *rq)
+{
+	struct sio_data *sd = rq->q->elevator->elevator_data;
+	struct sio_group *sg = rq->elevator_private[0];
+
+	if (sg) {
+		rq->elevator_private[0] = NULL;
+		sio_put_group(sd, sg);
+	}
+}
+
+static void
+sio_del_request(struct sio_data *sd, struct request *rq)
+{
+	struct sio_group *sg = sio_rq_group(sd, rq);
+
+	rq_fifo_clear(rq);
+
+	/* An empty group leaves the round-robin */
+	if (!--sg->nr_queued)
+		list_del_init(&sg->rr_node);
+}
+
+/*
+ * Return the group to dispatch from. The group at the head of the list is
+ * served until it has used its credit, then it goes to the tail with fresh
+ * credit. O(1) per dispatch.
+ */
+static struct sio_group *
+sio_select_group(struct sio_data *sd)
+{
+	struct sio_group *sg;
+
+	if (list_empty(&sd->group_rr))
+		return NULL;
+
+	sg = list_first_entry(&sd->group_rr, struct sio_group, rr_node);
+	if (sg->credit <= 0) {
+		sg->credit = sio_group_quantum(sd, sg);
+		list_move_tail(&sg->rr_node, &sd->group_rr);
+		sg = list_first_entry(&sd->group_rr, struct sio_group, rr_node);
+	}
+
+	return sg;
+}
+
 static void
 sio_merged_requests(struct request_queue *q, struct request *rq,
 		    struct request *next)
 {
+	struct sio_data *sd = q->elevator->elevator_data;
+
 	/*
 	 * If next expires before rq, assign its expire time to rq
 	 * and move into next position (next will be deleted) in fifo.
+	 * Requests are never moved to another group's fifo.
 	 */
-	if (!list_empty(&rq->queuelist) && !list_empty(&next->queuelist)) {
+	if (!list_empty(&rq->queuelist) && !list_empty(&next->queuelist) &&
+	    sio_rq_group(sd, rq) == sio_rq_group(sd, next)) {
 		if (time_before(rq_fifo_time(next), rq_fifo_time(rq))) {
 			list_move(&rq->queuelist, &next->queuelist);
 			rq_set_fifo_time(rq, rq_fifo_time(next));
@@ -64,13 +297,14 @@ sio_merged_requests(struct request_queue *q, struct request *rq,
 	}
 
 	/* Delete next request */
-	rq_fifo_clear(next);
+	sio_del_request(sd, next);
 }
 
 static void
 sio_add_request(struct request_queue *q, struct request *rq)
 {
 	struct sio_data *sd = q->elevator->elevator_data;
+	struct sio_group *sg = sio_rq_group(sd, rq);
 	const int sync = rq_is_sync(rq);
 	const int data_dir = rq_data_dir(rq);
 
@@ -79,7 +313,13 @@ sio_add_request(struct request_queue *q, struct request *rq)
 	 * expire time.
 	 */
 	rq_set_fifo_time(rq, jiffies + sd->fifo_expire[sync][data_dir]);
-	list_add_tail(&rq->queuelist, &sd->fifo_list[sync][data_dir]);
+	list_add_tail(&rq->queuelist, &sg->fifo_list[sync][data_dir]);
+
+	/* A group that becomes busy joins the round-robin */
+	if (!sg->nr_queued++) {
+		sg->credit = sio_group_quantum(sd, sg);
+		list_add_tail(&sg->rr_node, &sd->group_rr);
+	}
 }
 
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,38)
@@ -88,16 +328,15 @@ sio_queue_empty(struct request_queue *q)
 {
 	struct sio_data *sd = q->elevator->elevator_data;
 
-	/* Check if fifo lists are empty */
-	return list_empty(&sd->fifo_list[SYNC][READ]) && list_empty(&sd->fifo_list[SYNC][WRITE]) &&
-	       list_empty(&sd->fifo_list[ASYNC][READ]) && list_empty(&sd->fifo_list[ASYNC][WRITE]);
+	/* Only groups with queued requests are on the round-robin */
+	return list_empty(&sd->group_rr);
 }
 #endif
 
 static struct request *
-sio_expired_request(struct sio_data *sd, int sync, int data_dir)
+sio_expired_request(struct sio_group *sg, int sync, int data_dir)
 {
-	struct list_head *list = &sd->fifo_list[sync][data_dir];
+	struct list_head *list = &sg->fifo_list[sync][data_dir];
 	struct request *rq;
 
 	if (list_empty(list))
@@ -114,7 +353,7 @@ sio_expired_request(struct sio_data *sd, int sync, int data_dir)
 }
 
 static struct request *
-sio_choose_expired_request(struct sio_data *sd)
+sio_choose_expired_request(struct sio_group *sg)
 {
 	struct request *rq;
 
@@ -123,17 +362,17 @@ sio_choose_expired_request(struct sio_data *sd)
 	 * Asynchronous requests have priority over synchronous.
 	 * Write requests have priority over read.
 	 */
-	rq = sio_expired_request(sd, ASYNC, WRITE);
+	rq = sio_expired_request(sg, ASYNC, WRITE);
 	if (rq)
 		return rq;
-	rq = sio_expired_request(sd, ASYNC, READ);
+	rq = sio_expired_request(sg, ASYNC, READ);
 	if (rq)
 		return rq;
 
-	rq = sio_expired_request(sd, SYNC, WRITE);
+	rq = sio_expired_request(sg, SYNC, WRITE);
 	if (rq)
 		return rq;
-	rq = sio_expired_request(sd, SYNC, READ);
+	rq = sio_expired_request(sg, SYNC, READ);
 	if (rq)
 		return rq;
 
@@ -141,10 +380,10 @@ sio_choose_expired_request(struct sio_data *sd)
 }
 
 static struct request *
-sio_choose_request(struct sio_data *sd, int data_dir)
+sio_choose_request(struct sio_group *sg, int data_dir)
 {
-	struct list_head *sync = sd->fifo_list[SYNC];
-	struct list_head *async = sd->fifo_list[ASYNC];
+	struct list_head *sync = sg->fifo_list[SYNC];
+	struct list_head *async = sg->fifo_list[ASYNC];
 
 	/*
 	 * Retrieve request from available fifo list.
@@ -168,10 +407,11 @@ static inline void
 sio_dispatch_request(struct sio_data *sd, struct request *rq)
 {
 	/*
-	 * Remove the request from the fifo list
-	 * and dispatch it.
+	 * Charge the request to its group, remove it from
+	 * the fifo list and dispatch it.
 	 */
-	rq_fifo_clear(rq);
+	sio_rq_group(sd, rq)->credit--;
+	sio_del_request(sd, rq);
 	elv_dispatch_add_tail(rq->q, rq);
 
 	sd->batched++;
@@ -186,16 +426,21 @@ static int
 sio_dispatch_requests(struct request_queue *q, int force)
 {
 	struct sio_data *sd = q->elevator->elevator_data;
+	struct sio_group *sg;
 	struct request *rq = NULL;
 	int data_dir = READ;
 
+	sg = sio_select_group(sd);
+	if (!sg)
+		return 0;
+
 	/*
 	 * Retrieve any expired request after a batch of
 	 * sequential requests.
 	 */
 	if (sd->batched > sd->fifo_batch) {
 		sd->batched = 0;
-		rq = sio_choose_expired_request(sd);
+		rq = sio_choose_expired_request(sg);
 	}
 
 	/* Retrieve request */
@@ -203,7 +448,7 @@ sio_dispatch_requests(struct request_queue *q, int force)
 		if (sd->starved > sd->writes_starved)
 			data_dir = WRITE;
 
-		rq = sio_choose_request(sd, data_dir);
+		rq = sio_choose_request(sg, data_dir);
 		if (!rq)
 			return 0;
 	}
@@ -218,10 +463,11 @@ static struct request *
 sio_former_request(struct request_queue *q, struct request *rq)
 {
 	struct sio_data *sd = q->elevator->elevator_data;
+	struct sio_group *sg = sio_rq_group(sd, rq);
 	const int sync = rq_is_sync(rq);
 	const int data_dir = rq_data_dir(rq);
 
-	if (rq->queuelist.prev == &sd->fifo_list[sync][data_dir])
+	if (rq->queuelist.prev == &sg->fifo_list[sync][data_dir])
 		return NULL;
 
 	/* Return former request */
@@ -232,10 +478,11 @@ static struct request *
 sio_latter_request(struct request_queue *q, struct request *rq)
 {
 	struct sio_data *sd = q->elevator->elevator_data;
+	struct sio_group *sg = sio_rq_group(sd, rq);
 	const int sync = rq_is_sync(rq);
 	const int data_dir = rq_data_dir(rq);
 
-	if (rq->queuelist.next == &sd->fifo_list[sync][data_dir])
+	if (rq->queuelist.next == &sg->fifo_list[sync][data_dir])
 		return NULL;
 
 	/* Return latter request */
@@ -246,17 +493,18 @@ static void *
 sio_init_queue(struct request_queue *q)
 {
 	struct sio_data *sd;
+	int i;
 
 	/* Allocate structure */
 	sd = kmalloc_node(sizeof(*sd), GFP_KERNEL, q->node);
 	if (!sd)
 		return NULL;
 
-	/* Initialize fifo lists */
-	INIT_LIST_HEAD(&sd->fifo_list[SYNC][READ]);
-	INIT_LIST_HEAD(&sd->fifo_list[SYNC][WRITE]);
-	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][READ]);
-	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][WRITE]);
+	/* Initialize groups */
+	sio_init_group(&sd->root_group);
+	INIT_LIST_HEAD(&sd->group_rr);
+	for (i = 0; i < ARRAY_SIZE(sd->group_hash); i++)
+		INIT_HLIST_HEAD(&sd->group_hash[i]);
 
 	/* Initialize data */
 	sd->batched = 0;
@@ -265,6 +513,7 @@ sio_init_queue(struct request_queue *q)
 	sd->fifo_expire[ASYNC][READ] = async_read_expire;
 	sd->fifo_expire[ASYNC][WRITE] = async_write_expire;
 	sd->fifo_batch = fifo_batch;
+	sd->group_quantum = group_quantum;
 
 	return sd;
 }
@@ -274,10 +523,8 @@ sio_exit_queue(struct elevator_queue *e)
 {
 	struct sio_data *sd = e->elevator_data;
 
-	BUG_ON(!list_empty(&sd->fifo_list[SYNC][READ]));
-	BUG_ON(!list_empty(&sd->fifo_list[SYNC][WRITE]));
-	BUG_ON(!list_empty(&sd->fifo_list[ASYNC][READ]));
-	BUG_ON(!list_empty(&sd->fifo_list[ASYNC][WRITE]));
+	BUG_ON(!list_empty(&sd->group_rr));
+	BUG_ON(sd->root_group.nr_queued);
 
 	/* Free structure */
 	kfree(sd);
@@ -317,6 +564,7 @@ SHOW_FUNCTION(sio_async_read_expire_show, sd->fifo_expire[ASYNC][READ], 1);
 SHOW_FUNCTION(sio_async_write_expire_show, sd->fifo_expire[ASYNC][WRITE], 1);
 SHOW_FUNCTION(sio_fifo_batch_show, sd->fifo_batch, 0);
 SHOW_FUNCTION(sio_writes_starved_show, sd->writes_starved, 0);
+SHOW_FUNCTION(sio_group_quantum_show, sd->group_quantum, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -341,6 +589,7 @@ STORE_FUNCTION(sio_async_read_expire_store, &sd->fifo_expire[ASYNC][READ], 0, IN
 STORE_FUNCTION(sio_async_write_expire_store, &sd->fifo_expire[ASYNC][WRITE], 0, INT_MAX, 1);
 STORE_FUNCTION(sio_fifo_batch_store, &sd->fifo_batch, 0, INT_MAX, 0);
 STORE_FUNCTION(sio_writes_starved_store, &sd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(sio_group_quantum_store, &sd->group_quantum, 0, INT_MAX / BLKIO_WEIGHT_MAX, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -354,6 +603,7 @@ static struct elv_fs_entry sio_attrs[] = {
 	DD_ATTR(async_write_expire),
 	DD_ATTR(fifo_batch),
 	DD_ATTR(writes_starved),
+	DD_ATTR(group_quantum),
 	__ATTR_NULL
 };
 
@@ -367,6 +617,11 @@ static struct elevator_type iosched_sio = {
 #endif
 		.elevator_former_req_fn		= sio_former_request,
 		.elevator_latter_req_fn		= sio_latter_request,
+		.elevator_set_req_fn		= sio_set_request,
+		.elevator_put_req_fn		= sio_put_request,
+#ifdef CONFIG_SIO_GROUP_IOSCHED
+		.elevator_allow_merge_fn	= sio_allow_merge,
+#endif
 		.elevator_init_fn		= sio_init_queue,
 		.elevator_exit_fn		= sio_exit_queue,
 	},
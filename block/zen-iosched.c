@@ -13,23 +13,48 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/init.h>
+#include <linux/hash.h>
+#include "blk-cgroup.h"
 
 enum zen_data_dir { ASYNC, SYNC };
 
 static const int sync_expire  = HZ / 4;    /* max time before a sync is submitted. */
 static const int async_expire = 2 * HZ;    /* ditto for async, these limits are SOFT! */
 static const int fifo_batch = 1;
+static const int group_quantum = 4;	/* requests per round at the default
+					   blkio weight, 0 disables groups */
 
-struct zen_data {
-	/* Runtime Data */
+#define ZEN_GROUP_HASH_SHIFT	4
+
+/*
+ * Requests are queued per blkio cgroup. Busy groups are served in
+ * round-robin, each dispatching a quantum scaled by its weight.
+ */
+struct zen_group {
 	/* Requests are only present on fifo_list */
 	struct list_head fifo_list[2];
 
+	struct list_head rr_node;	/* on zen_data->group_rr while busy */
+	struct hlist_node hash_node;
+	unsigned short blkcg_id;
+	unsigned int weight;
+	int credit;			/* requests left in this round */
+	unsigned int nr_queued;
+	int ref;			/* allocated requests pointing here */
+};
+
+struct zen_data {
+	/* Runtime Data */
+	struct zen_group root_group;
+	struct list_head group_rr;
+	struct hlist_head group_hash[1 << ZEN_GROUP_HASH_SHIFT];
+
         unsigned int batching;          /* number of sequential requests made */
 
 	/* tunables */
 	int fifo_expire[2];
 	int fifo_batch;
+	int group_quantum;
 };
 
 static inline struct zen_data *
@@ -37,17 +62,208 @@ zen_get_data(struct request_queue *q) {
 	return q->elevator->elevator_data;
 }
 
+static void zen_init_group(struct zen_group *zg)
+{
+	INIT_LIST_HEAD(&zg->fifo_list[SYNC]);
+	INIT_LIST_HEAD(&zg->fifo_list[ASYNC]);
+	INIT_LIST_HEAD(&zg->rr_node);
+	INIT_HLIST_NODE(&zg->hash_node);
+	zg->blkcg_id = 0;
+	zg->weight = BLKIO_WEIGHT_DEFAULT;
+	zg->credit = 0;
+	zg->nr_queued = 0;
+	zg->ref = 0;
+}
+
+static inline struct zen_group *
+zen_rq_group(struct zen_data *zdata, struct request *rq)
+{
+	struct zen_group *zg = rq->elevator_private[0];
+
+	return zg ? zg : &zdata->root_group;
+}
+
+static int zen_group_quantum(struct zen_data *zdata, struct zen_group *zg)
+{
+	int quantum = zdata->group_quantum * zg->weight / BLKIO_WEIGHT_DEFAULT;
+
+	return max(quantum, 1);
+}
+
+#ifdef CONFIG_ZEN_GROUP_IOSCHED
+static dev_t zen_queue_dev(struct request_queue *q)
+{
+	struct backing_dev_info *bdi = &q->backing_dev_info;
+	unsigned int major, minor;
+
+	if (bdi->dev && dev_name(bdi->dev) &&
+	    sscanf(dev_name(bdi->dev), "%u:%u", &major, &minor) == 2)
+		return MKDEV(major, minor);
+
+	return 0;
+}
+
+static struct zen_group *
+zen_find_group(struct zen_data *zdata, struct blkio_cgroup *blkcg)
+{
+	unsigned short id = css_id(&blkcg->css);
+	struct hlist_head *head;
+	struct hlist_node *n;
+	struct zen_group *zg;
+
+	head = &zdata->group_hash[hash_long(id, ZEN_GROUP_HASH_SHIFT)];
+	hlist_for_each_entry(zg, n, head, hash_node)
+		if (zg->blkcg_id == id)
+			return zg;
+
+	return NULL;
+}
+
+/* Called with the queue lock held */
+static struct zen_group *
+zen_get_group(struct request_queue *q, struct zen_data *zdata)
+{
+	struct blkio_cgroup *blkcg;
+	struct zen_group *zg;
+
+	if (!zdata->group_quantum)
+		return &zdata->root_group;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	zg = zen_find_group(zdata, blkcg);
+	if (!zg) {
+		zg = kmalloc_node(sizeof(*zg), GFP_ATOMIC, q->node);
+		if (!zg) {
+			zg = &zdata->root_group;
+			goto out;
+		}
+		zen_init_group(zg);
+		zg->blkcg_id = css_id(&blkcg->css);
+		hlist_add_head(&zg->hash_node,
+			       &zdata->group_hash[hash_long(zg->blkcg_id,
+							    ZEN_GROUP_HASH_SHIFT)]);
+	}
+
+	/* Pick up weight changes whenever the group goes idle */
+	if (!zg->nr_queued)
+		zg->weight = blkcg_get_weight(blkcg, zen_queue_dev(q));
+out:
+	rcu_read_unlock();
+	return zg;
+}
+
+static int
+zen_allow_merge(struct request_queue *q, struct request *rq, struct bio *bio)
+{
+	struct zen_data *zdata = zen_get_data(q);
+	struct zen_group *zg;
+
+	/* Don't let a bio be charged to another group */
+	if (!zdata->group_quantum)
+		return 1;
+
+	rcu_read_lock();
+	zg = zen_find_group(zdata, task_blkio_cgroup(current));
+	rcu_read_unlock();
+
+	return (zg ? zg : &zdata->root_group) == zen_rq_group(zdata, rq);
+}
+#else
+static inline struct zen_group *
+zen_get_group(struct request_queue *q, struct zen_data *zdata)
+{
+	return &zdata->root_group;
+}
+#endif
+
+static void zen_put_group(struct zen_data *zdata, struct zen_group *zg)
+{
+	BUG_ON(zg->ref <= 0);
+	zg->ref--;
+	if (zg->ref || zg == &zdata->root_group)
+		return;
+
+	BUG_ON(zg->nr_queued);
+	hlist_del(&zg->hash_node);
+	kfree(zg);
+}
+
+static int
+zen_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct zen_data *zdata = zen_get_data(q);
+	struct zen_group *zg;
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	zg = zen_get_group(q, zdata);
+	zg->ref++;
+	rq->elevator_private[0] = zg;
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	return 0;
+}
+
+static void zen_put_request(struct request *rq)
+{
+	struct zen_data *zdata = zen_get_data(rq->q);
+	struct zen_group *zg = rq->elevator_private[0];
+
+	if (zg) {
+		rq->elevator_private[0] = NULL;
+		zen_put_group(zdata, zg);
+	}
+}
+
+static void zen_del_request(struct zen_data *zdata, struct request *rq)
+{
+	struct zen_group *zg = zen_rq_group(zdata, rq);
+
+	rq_fifo_clear(rq);
+
+	/* An empty group leaves the round-robin */
+	if (!--zg->nr_queued)
+		list_del_init(&zg->rr_node);
+}
+
+/*
+ * Serve the head group until its credit is used, then rotate it to the
+ * tail with fresh credit. O(1) per dispatch.
+ */
+static struct zen_group *zen_select_group(struct zen_data *zdata)
+{
+	struct zen_group *zg;
+
+	if (list_empty(&zdata->group_rr))
+		return NULL;
+
+	zg = list_first_entry(&zdata->group_rr, struct zen_group, rr_node);
+	if (zg->credit <= 0) {
+		zg->credit = zen_group_quantum(zdata, zg);
+		list_move_tail(&zg->rr_node, &zdata->group_rr);
+		zg = list_first_entry(&zdata->group_rr, struct zen_group,
+				      rr_node);
+	}
+
+	return zg;
+}
+
 static void zen_dispatch(struct zen_data *, struct request *);
 
 static void
 zen_merged_requests(struct request_queue *q, struct request *req,
                     struct request *next)
 {
+	struct zen_data *zdata = zen_get_data(q);
+
 	/*
 	 * if next expires before rq, assign its expire time to arq
-	 * and move into next position (next will be deleted) in fifo
+	 * and move into next position (next will be deleted) in fifo,
+	 * as long as both belong to the same group
 	 */
-	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    zen_rq_group(zdata, req) == zen_rq_group(zdata, next)) {
 		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
 			list_move(&req->queuelist, &next->queuelist);
 			rq_set_fifo_time(req, rq_fifo_time(next));
@@ -55,24 +271,32 @@ zen_merged_requests(struct request_queue *q, struct request *req,
 	}
 
 	/* next request is gone */
-	rq_fifo_clear(next);
+	zen_del_request(zdata, next);
 }
 
 static void zen_add_request(struct request_queue *q, struct request *rq)
 {
 	struct zen_data *zdata = zen_get_data(q);
+	struct zen_group *zg = zen_rq_group(zdata, rq);
 	const int dir = rq_data_dir(rq);
 
 	if (zdata->fifo_expire[dir]) {
 		rq_set_fifo_time(rq, jiffies + zdata->fifo_expire[dir]);
-		list_add_tail(&rq->queuelist, &zdata->fifo_list[dir]);
+		list_add_tail(&rq->queuelist, &zg->fifo_list[dir]);
+
+		/* A group that becomes busy joins the round-robin */
+		if (!zg->nr_queued++) {
+			zg->credit = zen_group_quantum(zdata, zg);
+			list_add_tail(&zg->rr_node, &zdata->group_rr);
+		}
 	}
 }
 
 static void zen_dispatch(struct zen_data *zdata, struct request *rq)
 {
-	/* Remove request from list and dispatch it */
-	rq_fifo_clear(rq);
+	/* Charge the group, remove request from list and dispatch it */
+	zen_rq_group(zdata, rq)->credit--;
+	zen_del_request(zdata, rq);
 	elv_dispatch_add_tail(rq->q, rq);
 
 	/* Increment # of sequential requests */
@@ -83,14 +307,14 @@ static void zen_dispatch(struct zen_data *zdata, struct request *rq)
  * get the first expired request in direction ddir
  */
 static struct request *
-zen_expired_request(struct zen_data *zdata, int ddir)
+zen_expired_request(struct zen_group *zg, int ddir)
 {
         struct request *rq;
 
-        if (list_empty(&zdata->fifo_list[ddir]))
+        if (list_empty(&zg->fifo_list[ddir]))
                 return NULL;
 
-        rq = rq_entry_fifo(zdata->fifo_list[ddir].next);
+        rq = rq_entry_fifo(zg->fifo_list[ddir].next);
         if (time_after(jiffies, rq_fifo_time(rq)))
                 return rq;
 
@@ -102,10 +326,10 @@ zen_expired_request(struct zen_data *zdata, int ddir)
  * otherwise it returns the next expired request
  */
 static struct request *
-zen_check_fifo(struct zen_data *zdata)
+zen_check_fifo(struct zen_group *zg)
 {
-        struct request *rq_sync = zen_expired_request(zdata, SYNC);
-        struct request *rq_async = zen_expired_request(zdata, ASYNC);
+        struct request *rq_sync = zen_expired_request(zg, SYNC);
+        struct request *rq_async = zen_expired_request(zg, ASYNC);
 
         if (rq_async && rq_sync) {
 	if (time_after(rq_fifo_time(rq_async), rq_fifo_time(rq_sync)))
@@ -120,16 +344,16 @@ zen_check_fifo(struct zen_data *zdata)
 }
 
 static struct request *
-zen_choose_request(struct zen_data *zdata)
+zen_choose_request(struct zen_group *zg)
 {
         /*
          * Retrieve request from available fifo list.
          * Synchronous requests have priority over asynchronous.
          */
-        if (!list_empty(&zdata->fifo_list[SYNC]))
-                return rq_entry_fifo(zdata->fifo_list[SYNC].next);
-        if (!list_empty(&zdata->fifo_list[ASYNC]))
-                return rq_entry_fifo(zdata->fifo_list[ASYNC].next);
+        if (!list_empty(&zg->fifo_list[SYNC]))
+                return rq_entry_fifo(zg->fifo_list[SYNC].next);
+        if (!list_empty(&zg->fifo_list[ASYNC]))
+                return rq_entry_fifo(zg->fifo_list[ASYNC].next);
 
         return NULL;
 }
@@ -137,16 +361,21 @@ zen_choose_request(struct zen_data *zdata)
 static int zen_dispatch_requests(struct request_queue *q, int force)
 {
 	struct zen_data *zdata = zen_get_data(q);
+	struct zen_group *zg;
 	struct request *rq = NULL;
 
+	zg = zen_select_group(zdata);
+	if (!zg)
+		return 0;
+
 	/* Check for and issue expired requests */
 	if (zdata->batching > zdata->fifo_batch) {
 		zdata->batching = 0;
-		rq = zen_check_fifo(zdata);
+		rq = zen_check_fifo(zg);
 	}
 
 	if (!rq) {
-		rq = zen_choose_request(zdata);
+		rq = zen_choose_request(zg);
 		if (!rq)
 			return 0;
 	}
@@ -159,15 +388,19 @@ static int zen_dispatch_requests(struct request_queue *q, int force)
 static void *zen_init_queue(struct request_queue *q)
 {
 	struct zen_data *zdata;
+	int i;
 
 	zdata = kmalloc_node(sizeof(*zdata), GFP_KERNEL, q->node);
 	if (!zdata)
 		return NULL;
-	INIT_LIST_HEAD(&zdata->fifo_list[SYNC]);
-	INIT_LIST_HEAD(&zdata->fifo_list[ASYNC]);
+	zen_init_group(&zdata->root_group);
+	INIT_LIST_HEAD(&zdata->group_rr);
+	for (i = 0; i < ARRAY_SIZE(zdata->group_hash); i++)
+		INIT_HLIST_HEAD(&zdata->group_hash[i]);
 	zdata->fifo_expire[SYNC] = sync_expire;
 	zdata->fifo_expire[ASYNC] = async_expire;
 	zdata->fifo_batch = fifo_batch;
+	zdata->group_quantum = group_quantum;
 	return zdata;
 }
 
@@ -175,8 +408,8 @@ static void zen_exit_queue(struct elevator_queue *e)
 {
 	struct zen_data *zdata = e->elevator_data;
 
-	BUG_ON(!list_empty(&zdata->fifo_list[SYNC]));
-	BUG_ON(!list_empty(&zdata->fifo_list[ASYNC]));
+	BUG_ON(!list_empty(&zdata->group_rr));
+	BUG_ON(zdata->root_group.nr_queued);
 	kfree(zdata);
 }
 
@@ -206,6 +439,7 @@ static ssize_t __FUNC(struct elevator_queue *e, char *page) \
 SHOW_FUNCTION(zen_sync_expire_show, zdata->fifo_expire[SYNC], 1);
 SHOW_FUNCTION(zen_async_expire_show, zdata->fifo_expire[ASYNC], 1);
 SHOW_FUNCTION(zen_fifo_batch_show, zdata->fifo_batch, 0);
+SHOW_FUNCTION(zen_group_quantum_show, zdata->group_quantum, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV) \
@@ -227,6 +461,7 @@ static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)
 STORE_FUNCTION(zen_sync_expire_store, &zdata->fifo_expire[SYNC], 0, INT_MAX, 1);
 STORE_FUNCTION(zen_async_expire_store, &zdata->fifo_expire[ASYNC], 0, INT_MAX, 1);
 STORE_FUNCTION(zen_fifo_batch_store, &zdata->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(zen_group_quantum_store, &zdata->group_quantum, 0, INT_MAX / BLKIO_WEIGHT_MAX, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -237,6 +472,7 @@ static struct elv_fs_entry zen_attrs[] = {
         DD_ATTR(sync_expire),
         DD_ATTR(async_expire),
         DD_ATTR(fifo_batch),
+        DD_ATTR(group_quantum),
         __ATTR_NULL
 };
 
@@ -247,6 +483,11 @@ static struct elevator_type iosched_zen = {
 		.elevator_add_req_fn		= zen_add_request,
 		.elevator_former_req_fn         = elv_rb_former_request,
 		.elevator_latter_req_fn         = elv_rb_latter_request,
+		.elevator_set_req_fn		= zen_set_request,
+		.elevator_put_req_fn		= zen_put_request,
+#ifdef CONFIG_ZEN_GROUP_IOSCHED
+		.elevator_allow_merge_fn	= zen_allow_merge,
+#endif
 		.elevator_init_fn		= zen_init_queue,
 		.elevator_exit_fn		= zen_exit_queue,
 	},
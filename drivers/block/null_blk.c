@@ -0,0 +1,603 @@
+/*
+ * Null block device driver.
+ *
+ * Every request is completed without moving any data, so whatever time
+ * is spent between submission and completion is block layer overhead.
+ * The queue can be bio based, request based (going through the I/O
+ * scheduler) or multi-queue, and completions can be inline, deferred
+ * to softirq or delayed by a timer.  See Documentation/block/null_blk.txt.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bio.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+
+struct nullb_cmd {
+	struct list_head list;
+	struct request *rq;
+	struct bio *bio;
+	unsigned int tag;
+	struct nullb_queue *nq;
+};
+
+struct nullb_queue {
+	unsigned long *tag_map;
+	wait_queue_head_t wait;
+	unsigned int queue_depth;
+	struct nullb_cmd *cmds;
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+	spinlock_t lock;		/* queue_lock in request mode */
+
+	struct nullb_queue *queues;
+	unsigned int nr_queues;
+};
+
+static LIST_HEAD(nullb_list);
+static DEFINE_MUTEX(nullb_lock);
+static int null_major;
+static int nullb_indexes;
+
+/*
+ * Per-CPU list of commands waiting for the completion timer.
+ */
+struct completion_queue {
+	struct list_head list;
+	struct hrtimer timer;
+};
+
+static DEFINE_PER_CPU(struct completion_queue, completion_queues);
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+};
+
+enum {
+	NULL_Q_BIO		= 0,
+	NULL_Q_RQ		= 1,
+	NULL_Q_MQ		= 2,
+};
+
+static int submit_queues;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Number of submission queues (default: nr of CPUs)");
+
+static int home_node = -1;
+module_param(home_node, int, S_IRUGO);
+MODULE_PARM_DESC(home_node, "Home node for the device");
+
+static int queue_mode = NULL_Q_RQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface to use (0=bio,1=rq,2=multiqueue)");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size (in bytes)");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "IRQ completion handler (0=none,1=softirq,2=timer)");
+
+static int completion_nsec = 10000;
+module_param(completion_nsec, int, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware (timer mode)");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each submission queue");
+
+static void put_tag(struct nullb_queue *nq, unsigned int tag)
+{
+	clear_bit_unlock(tag, nq->tag_map);
+	smp_mb__after_clear_bit();
+
+	if (waitqueue_active(&nq->wait))
+		wake_up(&nq->wait);
+}
+
+static unsigned int get_tag(struct nullb_queue *nq)
+{
+	unsigned int tag;
+
+	do {
+		tag = find_first_zero_bit(nq->tag_map, nq->queue_depth);
+		if (tag >= nq->queue_depth)
+			return -1U;
+	} while (test_and_set_bit_lock(tag, nq->tag_map));
+
+	return tag;
+}
+
+static struct nullb_cmd *__alloc_cmd(struct nullb_queue *nq)
+{
+	struct nullb_cmd *cmd;
+	unsigned int tag;
+
+	tag = get_tag(nq);
+	if (tag == -1U)
+		return NULL;
+
+	cmd = &nq->cmds[tag];
+	cmd->tag = tag;
+	cmd->nq = nq;
+	return cmd;
+}
+
+static struct nullb_cmd *alloc_cmd(struct nullb_queue *nq, int can_wait)
+{
+	struct nullb_cmd *cmd;
+	DEFINE_WAIT(wait);
+
+	cmd = __alloc_cmd(nq);
+	if (cmd || !can_wait)
+		return cmd;
+
+	for (;;) {
+		prepare_to_wait(&nq->wait, &wait, TASK_UNINTERRUPTIBLE);
+		cmd = __alloc_cmd(nq);
+		if (cmd)
+			break;
+		io_schedule();
+	}
+	finish_wait(&nq->wait, &wait);
+
+	return cmd;
+}
+
+/*
+ * Request mode stops the queue when it runs out of tags, see
+ * null_rq_prep_fn(); the first completion after that restarts it.
+ */
+static void null_restart_queue(struct request_queue *q)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	if (blk_queue_stopped(q)) {
+		queue_flag_clear(QUEUE_FLAG_STOPPED, q);
+		blk_run_queue_async(q);
+	}
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+static void end_cmd(struct nullb_cmd *cmd)
+{
+	struct request_queue *q = NULL;
+
+	switch (queue_mode) {
+#ifdef CONFIG_BLK_MQ
+	case NULL_Q_MQ:
+		blk_mq_end_io(cmd->rq, 0);
+		return;
+#endif
+	case NULL_Q_RQ:
+		q = cmd->rq->q;
+		blk_end_request_all(cmd->rq, 0);
+		break;
+	case NULL_Q_BIO:
+		bio_endio(cmd->bio, 0);
+		break;
+	}
+
+	put_tag(cmd->nq, cmd->tag);
+
+	if (q && blk_queue_stopped(q))
+		null_restart_queue(q);
+}
+
+static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
+{
+	struct completion_queue *cq;
+	struct nullb_cmd *cmd;
+	LIST_HEAD(list);
+
+	cq = container_of(timer, struct completion_queue, timer);
+	list_splice_init(&cq->list, &list);
+
+	while (!list_empty(&list)) {
+		cmd = list_first_entry(&list, struct nullb_cmd, list);
+		list_del(&cmd->list);
+		end_cmd(cmd);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+static void null_cmd_end_timer(struct nullb_cmd *cmd)
+{
+	struct completion_queue *cq;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cq = &__get_cpu_var(completion_queues);
+	list_add_tail(&cmd->list, &cq->list);
+
+	/* the first command on the list arms the timer for all of them */
+	if (cq->list.next == &cmd->list)
+		hrtimer_start(&cq->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL_PINNED);
+	local_irq_restore(flags);
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+#ifdef CONFIG_BLK_MQ
+	if (queue_mode == NULL_Q_MQ) {
+		end_cmd(blk_mq_rq_to_pdu(rq));
+		return;
+	}
+#endif
+	end_cmd(rq->special);
+}
+
+static inline void null_handle_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		switch (queue_mode) {
+#ifdef CONFIG_BLK_MQ
+		case NULL_Q_MQ:
+			blk_mq_complete_request(cmd->rq);
+			break;
+#endif
+		case NULL_Q_RQ:
+			blk_complete_request(cmd->rq);
+			break;
+		case NULL_Q_BIO:
+			/* bios have no softirq completion, end inline */
+			end_cmd(cmd);
+			break;
+		}
+		break;
+	case NULL_IRQ_NONE:
+		end_cmd(cmd);
+		break;
+	case NULL_IRQ_TIMER:
+		null_cmd_end_timer(cmd);
+		break;
+	}
+}
+
+static struct nullb_queue *nullb_to_queue(struct nullb *nullb)
+{
+	int index = 0;
+
+	if (nullb->nr_queues != 1)
+		index = raw_smp_processor_id() /
+			((nr_cpu_ids + nullb->nr_queues - 1) / nullb->nr_queues);
+
+	return &nullb->queues[index];
+}
+
+static int null_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nullb_to_queue(nullb), 1);
+	cmd->bio = bio;
+
+	null_handle_cmd(cmd);
+	return 0;
+}
+
+static int null_rq_prep_fn(struct request_queue *q, struct request *req)
+{
+	struct nullb *nullb = q->queuedata;
+	struct nullb_queue *nq = nullb_to_queue(nullb);
+	struct nullb_cmd *cmd;
+
+	cmd = alloc_cmd(nq, 0);
+	if (!cmd) {
+		blk_stop_queue(q);
+
+		/*
+		 * Pairs with the barrier in put_tag(): either the
+		 * completion sees the stopped queue, or we see its tag.
+		 */
+		smp_mb();
+		cmd = alloc_cmd(nq, 0);
+		if (!cmd)
+			return BLKPREP_DEFER;
+		queue_flag_clear(QUEUE_FLAG_STOPPED, q);
+	}
+
+	cmd->rq = req;
+	req->special = cmd;
+	return BLKPREP_OK;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct request *rq;
+
+	while ((rq = blk_fetch_request(q)) != NULL) {
+		struct nullb_cmd *cmd = rq->special;
+
+		spin_unlock_irq(q->queue_lock);
+		null_handle_cmd(cmd);
+		spin_lock_irq(q->queue_lock);
+	}
+}
+
+#ifdef CONFIG_BLK_MQ
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->rq = rq;
+	cmd->nq = hctx->driver_data;
+
+	null_handle_cmd(cmd);
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int null_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			  unsigned int index)
+{
+	struct nullb *nullb = data;
+
+	hctx->driver_data = &nullb->queues[index];
+	return 0;
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+	.map_queue	= blk_mq_map_queue,
+	.complete	= null_softirq_done_fn,
+	.init_hctx	= null_init_hctx,
+};
+#endif
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static int setup_commands(struct nullb_queue *nq)
+{
+	unsigned int i;
+
+	nq->cmds = kzalloc(nq->queue_depth * sizeof(struct nullb_cmd),
+			   GFP_KERNEL);
+	nq->tag_map = kzalloc(BITS_TO_LONGS(nq->queue_depth) *
+			      sizeof(unsigned long), GFP_KERNEL);
+	if (!nq->cmds || !nq->tag_map)
+		return -ENOMEM;
+
+	for (i = 0; i < nq->queue_depth; i++)
+		INIT_LIST_HEAD(&nq->cmds[i].list);
+
+	return 0;
+}
+
+static void cleanup_queues(struct nullb *nullb)
+{
+	unsigned int i;
+
+	if (nullb->queues)
+		for (i = 0; i < nullb->nr_queues; i++) {
+			kfree(nullb->queues[i].cmds);
+			kfree(nullb->queues[i].tag_map);
+		}
+	kfree(nullb->queues);
+}
+
+/*
+ * Multi-queue mode uses the requests and tags of blk-mq, the other
+ * modes carry their own commands and tags per submission queue.
+ */
+static int setup_queues(struct nullb *nullb)
+{
+	struct nullb_queue *nq;
+	unsigned int i;
+
+	nullb->queues = kzalloc(submit_queues * sizeof(struct nullb_queue),
+				GFP_KERNEL);
+	if (!nullb->queues)
+		return -ENOMEM;
+
+	for (i = 0; i < submit_queues; i++) {
+		nq = &nullb->queues[i];
+		init_waitqueue_head(&nq->wait);
+		nq->queue_depth = hw_queue_depth;
+		nullb->nr_queues++;
+
+		if (queue_mode != NULL_Q_MQ && setup_commands(nq))
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+#ifdef CONFIG_BLK_MQ
+	struct blk_mq_reg reg = {
+		.ops		= &null_mq_ops,
+		.nr_hw_queues	= submit_queues,
+		.queue_depth	= hw_queue_depth,
+		.cmd_size	= sizeof(struct nullb_cmd),
+		.numa_node	= home_node,
+	};
+#endif
+
+	nullb = kzalloc_node(sizeof(*nullb), GFP_KERNEL, home_node);
+	if (!nullb)
+		return -ENOMEM;
+
+	spin_lock_init(&nullb->lock);
+
+	if (setup_queues(nullb))
+		goto out_cleanup_queues;
+
+	switch (queue_mode) {
+#ifdef CONFIG_BLK_MQ
+	case NULL_Q_MQ:
+		nullb->q = blk_mq_init_queue(&reg, nullb);
+		break;
+#endif
+	case NULL_Q_BIO:
+		nullb->q = blk_alloc_queue_node(GFP_KERNEL, home_node);
+		if (nullb->q)
+			blk_queue_make_request(nullb->q, null_queue_bio);
+		break;
+	case NULL_Q_RQ:
+		nullb->q = blk_init_queue_node(null_request_fn, &nullb->lock,
+					       home_node);
+		if (nullb->q) {
+			blk_queue_prep_rq(nullb->q, null_rq_prep_fn);
+			blk_queue_softirq_done(nullb->q, null_softirq_done_fn);
+		}
+		break;
+	}
+	if (!nullb->q)
+		goto out_cleanup_queues;
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	disk = nullb->disk = alloc_disk_node(1, home_node);
+	if (!disk)
+		goto out_cleanup_blk_queue;
+
+	mutex_lock(&nullb_lock);
+	list_add_tail(&nullb->list, &nullb_list);
+	nullb->index = nullb_indexes++;
+	mutex_unlock(&nullb_lock);
+
+	set_capacity(disk, (sector_t)gb << (30 - 9));
+
+	disk->flags |= GENHD_FL_EXT_DEVT;
+	disk->major		= null_major;
+	disk->first_minor	= nullb->index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(disk->disk_name, "nullb%d", nullb->index);
+	add_disk(disk);
+	return 0;
+
+out_cleanup_blk_queue:
+	blk_cleanup_queue(nullb->q);
+out_cleanup_queues:
+	cleanup_queues(nullb);
+	kfree(nullb);
+	return -ENOMEM;
+}
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del_init(&nullb->list);
+
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	cleanup_queues(nullb);
+	kfree(nullb);
+}
+
+static void null_cleanup(void)
+{
+	struct nullb *nullb;
+	int cpu;
+
+	mutex_lock(&nullb_lock);
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	mutex_unlock(&nullb_lock);
+
+	if (irqmode == NULL_IRQ_TIMER)
+		for_each_possible_cpu(cpu)
+			hrtimer_cancel(&per_cpu(completion_queues, cpu).timer);
+
+	unregister_blkdev(null_major, "nullb");
+}
+
+static int __init null_init(void)
+{
+	struct completion_queue *cq;
+	unsigned int i;
+
+	if (bs > PAGE_SIZE) {
+		pr_warning("null_blk: invalid block size\n");
+		pr_warning("null_blk: defaults block size to %lu\n", PAGE_SIZE);
+		bs = PAGE_SIZE;
+	}
+
+#ifndef CONFIG_BLK_MQ
+	if (queue_mode == NULL_Q_MQ) {
+		pr_warning("null_blk: multi-queue mode needs CONFIG_BLK_MQ, using request mode\n");
+		queue_mode = NULL_Q_RQ;
+	}
+#endif
+	if (queue_mode < NULL_Q_BIO || queue_mode > NULL_Q_MQ ||
+	    irqmode < NULL_IRQ_NONE || irqmode > NULL_IRQ_TIMER ||
+	    hw_queue_depth <= 0 || gb <= 0)
+		return -EINVAL;
+
+	if (submit_queues <= 0 || submit_queues > nr_cpu_ids)
+		submit_queues = nr_cpu_ids;
+
+	for_each_possible_cpu(i) {
+		cq = &per_cpu(completion_queues, i);
+		INIT_LIST_HEAD(&cq->list);
+
+		if (irqmode != NULL_IRQ_TIMER)
+			continue;
+
+		hrtimer_init(&cq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		cq->timer.function = null_cmd_timer_expired;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		if (null_add_dev()) {
+			null_cleanup();
+			return -EINVAL;
+		}
+	}
+
+	pr_info("null_blk: module loaded\n");
+	return 0;
+}
+
+static void __exit null_exit(void)
+{
+	null_cleanup();
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_LICENSE("GPL");
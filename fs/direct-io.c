@@ -35,6 +35,7 @@
 #include <linux/buffer_head.h>
 #include <linux/rwsem.h>
 #include <linux/uio.h>
+#include <linux/ktime.h>
 #include <asm/atomic.h>
 
 /*
@@ -105,6 +106,9 @@ struct dio {
 	unsigned long refcount;		/* direct_io_worker() and bios */
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
+	struct request_queue *poll_queue; /* queue to poll, see blk-poll.c */
+	struct bio *poll_bio;		/* first bio until it completes */
+	u64 submit_ns;			/* ... and when it was submitted */
 
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
@@ -298,6 +302,14 @@ static void dio_bio_end_io(struct bio *bio, int error)
 	unsigned long flags;
 
 	spin_lock_irqsave(&dio->bio_lock, flags);
+	/*
+	 * Forget the sample once accounted: a later bio of this dio may
+	 * be allocated at the same address.
+	 */
+	if (bio == dio->poll_bio) {
+		blk_poll_account(dio->poll_queue, dio->submit_ns);
+		dio->poll_bio = NULL;
+	}
 	bio->bi_private = dio->bio_list;
 	dio->bio_list = bio;
 	if (--dio->refcount == 1 && dio->waiter)
@@ -369,6 +381,22 @@ static void dio_bio_submit(struct dio *dio)
 	if (dio->is_async && dio->rw == READ)
 		bio_set_pages_dirty(bio);
 
+	if (!dio->is_async && dio->rw == READ) {
+		struct request_queue *q = bdev_get_queue(bio->bi_bdev);
+
+		/*
+		 * Time the first bio only: later ones of the same dio are
+		 * queued behind it, and overwriting the submission time
+		 * would make the measured latency too short.  poll_queue
+		 * stays set after the sample completes.
+		 */
+		if (!dio->poll_queue && blk_queue_poll(q)) {
+			dio->poll_queue = q;
+			dio->poll_bio = bio;
+			dio->submit_ns = ktime_to_ns(ktime_get());
+		}
+	}
+
 	if (dio->submit_io)
 		dio->submit_io(dio->rw, bio, dio->inode,
 			       dio->logical_offset_in_bio);
@@ -389,6 +417,14 @@ static void dio_cleanup(struct dio *dio)
 		page_cache_release(dio_get_page(dio));
 }
 
+static bool dio_bio_done(void *data)
+{
+	struct dio *dio = data;
+
+	return ACCESS_ONCE(dio->refcount) == 1 ||
+		ACCESS_ONCE(dio->bio_list) != NULL;
+}
+
 /*
  * Wait for the next BIO to complete.  Remove it and return it.  NULL is
  * returned once all BIOs have been completed.  This must only be called once
@@ -399,6 +435,7 @@ static struct bio *dio_await_one(struct dio *dio)
 {
 	unsigned long flags;
 	struct bio *bio = NULL;
+	bool polled = false;
 
 	spin_lock_irqsave(&dio->bio_lock, flags);
 
@@ -409,6 +446,18 @@ static struct bio *dio_await_one(struct dio *dio)
 	 * and can call it after testing our condition.
 	 */
 	while (dio->refcount > 1 && dio->bio_list == NULL) {
+		/*
+		 * On queues with io_poll set, try polling once before
+		 * going to sleep; nobody wakes us up while we poll.
+		 */
+		if (dio->poll_queue && !polled) {
+			polled = true;
+			spin_unlock_irqrestore(&dio->bio_lock, flags);
+			blk_poll_wait(dio->poll_queue, dio->submit_ns,
+				      dio_bio_done, dio);
+			spin_lock_irqsave(&dio->bio_lock, flags);
+			continue;
+		}
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		dio->waiter = current;
 		spin_unlock_irqrestore(&dio->bio_lock, flags);
@@ -28,6 +28,7 @@
 #include <linux/syscalls.h>
 #include <linux/rbtree.h>
 #include <linux/wait.h>
+#include <linux/llist.h>
 #include <linux/eventpoll.h>
 #include <linux/mount.h>
 #include <linux/bitops.h>
@@ -48,11 +49,12 @@
  * 3) ep->lock (spinlock)
  *
  * The acquire order is the one listed above, from 1 to 3.
- * We need a spinlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
- * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
+ * We need a spinlock (ep->lock) because the ready list is fed by
+ * the poll callback, that might be triggered from a wake_up() that
+ * in turn might be called from IRQ context. The poll callback itself
+ * takes no epoll lock: it pushes the item on the lockless ep->rdllq
+ * queue, and whoever holds ep->lock next moves the queued items to
+ * the ready list. During the event transfer loop (from kernel to
  * user space) we could end up sleeping due a copy_to_user(), so
  * we need a lock that will allow us to sleep. This lock is a
  * mutex (ep->mtx). It is acquired during the event transfer loop,
@@ -88,7 +90,13 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE)
+
+#define EPOLLINOUT_BITS (POLLIN | POLLOUT)
+
+/* The only event bits that may be combined with EPOLLEXCLUSIVE */
+#define EPOLLEXCLUSIVE_OK_BITS (EPOLLINOUT_BITS | POLLERR | POLLHUP | \
+				EPOLLET | EPOLLEXCLUSIVE)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -99,6 +107,12 @@
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/* Bit in epitem->rdlqueued, set while the item sits on ep->rdllq */
+#define EPI_RDLQUEUED 0
+
+/* Ready events copied to userspace at once by ep_send_events_proc() */
+#define EP_SEND_BATCH 16
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -140,6 +154,10 @@ struct epitem {
 	 */
 	struct epitem *next;
 
+	/* Links this item to the lockless ready queue ep->rdllq */
+	struct llist_node rdlnode;
+	unsigned long rdlqueued;
+
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
 
@@ -185,6 +203,12 @@ struct eventpoll {
 	/* List of ready file descriptors */
 	struct list_head rdllist;
 
+	/*
+	 * Items made ready by the poll callback, pushed without taking
+	 * ->lock. Drained into ->rdllist (or ->ovflist) under ->lock.
+	 */
+	struct llist_head rdllq;
+
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root rbr;
 
@@ -360,7 +384,49 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR ||
+		!llist_empty(&ep->rdllq);
+}
+
+/**
+ * ep_drain_ready_queue - Moves the items queued by ep_poll_callback() on
+ *                        the lockless ready queue to the ready list.
+ *
+ * @ep: Pointer to the eventpoll context.
+ *
+ * Must be called with "ep->lock" held, which makes the caller the only
+ * consumer of the queue. While ep_scan_ready_list() transfers events
+ * without the lock, the items are chained in ep->ovflist instead, exactly
+ * like the poll callback used to do.
+ */
+static void ep_drain_ready_queue(struct eventpoll *ep)
+{
+	struct llist_node *node, *next, *prev = NULL;
+	struct epitem *epi;
+
+	/* The queue hands the items back newest first, restore their order */
+	for (node = llist_del_all(&ep->rdllq); node; node = next) {
+		next = node->next;
+		node->next = prev;
+		prev = node;
+	}
+
+	for (node = prev; node; node = next) {
+		epi = llist_entry(node, struct epitem, rdlnode);
+		next = node->next;
+
+		/* From now on the poll callback may queue the item again */
+		smp_mb__before_clear_bit();
+		clear_bit(EPI_RDLQUEUED, &epi->rdlqueued);
+
+		if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
+			if (epi->next == EP_UNACTIVE_PTR) {
+				epi->next = ep->ovflist;
+				ep->ovflist = epi;
+			}
+		} else if (!ep_is_linked(&epi->rdllink))
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+	}
 }
 
 /**
@@ -541,6 +607,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_drain_ready_queue(ep);
 	list_splice_init(&ep->rdllist, &txlist);
 	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -556,6 +623,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * other events might have been queued by the poll callback.
 	 * We re-insert them inside the main ready-list here.
 	 */
+	ep_drain_ready_queue(ep);
 	for (nepi = ep->ovflist; (epi = nepi) != NULL;
 	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
 		/*
@@ -585,7 +653,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		 * the ->poll() wait list (delayed after we release the lock).
 		 */
 		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+			wake_up(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -615,7 +683,8 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 	 * sequence of the lock acquisition. Here we do "ep->lock" then the wait
 	 * queue head lock when unregistering the wait queue. The wakeup callback
 	 * will run by holding the wait queue head lock and will call our callback
-	 * that will try to get "ep->lock".
+	 * that will wake up "ep->wq" under its own lock. Once this returns, the
+	 * callback cannot queue the item on ep->rdllq anymore.
 	 */
 	ep_unregister_pollwait(ep, epi);
 
@@ -628,6 +697,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 	rb_erase(&epi->rbn, &ep->rbr);
 
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_drain_ready_queue(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -805,6 +875,7 @@ static int ep_alloc(struct eventpoll **pep)
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
+	init_llist_head(&ep->rdllq);
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
@@ -854,24 +925,10 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
-	unsigned long flags;
+	int pwake = 0, ewake = 0;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 
-	if ((unsigned long)key & POLLFREE) {
-		ep_pwq_from_wait(wait)->whead = NULL;
-		/*
-		 * whead = NULL above can race with ep_remove_wait_queue()
-		 * which can do another remove_wait_queue() after us, so we
-		 * can't use __remove_wait_queue(). whead->lock is held by
-		 * the caller.
-		 */
-		list_del_init(&wait->task_list);
-	}
-
-	spin_lock_irqsave(&ep->lock, flags);
-
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
 	 * descriptor to be disabled. This condition is likely the effect of the
@@ -879,7 +936,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -888,43 +945,76 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (key && !((unsigned long) key & epi->event.events))
-		goto out_unlock;
+		goto out;
 
 	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * Queue the item without taking "ep->lock", so that the wakeup
+	 * sources of a busy epoll set do not serialize on it, nor against
+	 * epoll_wait() harvesting the ready list. The holder of "ep->lock"
+	 * moves it to ep->rdllist, or to ep->ovflist if we are transferring
+	 * events to userspace. If it is already queued we exit soon.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-		}
-		goto out_unlock;
-	}
-
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink))
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	if (!test_and_set_bit(EPI_RDLQUEUED, &epi->rdlqueued))
+		llist_add(&epi->rdlnode, &ep->rdllq);
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. The atomic operations above order the queueing before
+	 * the checks, pairing with set_current_state() in ep_poll().
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+	if (waitqueue_active(&ep->wq)) {
+		/*
+		 * An exclusive item only consumes the wakeup if it is one
+		 * the waiter asked for: otherwise the source goes on to
+		 * wake the next exclusive entry on its wait queue.
+		 */
+		if ((epi->event.events & EPOLLEXCLUSIVE) &&
+		    !((unsigned long)key & POLLFREE)) {
+			switch ((unsigned long)key & EPOLLINOUT_BITS) {
+			case POLLIN:
+				if (epi->event.events & POLLIN)
+					ewake = 1;
+				break;
+			case POLLOUT:
+				if (epi->event.events & POLLOUT)
+					ewake = 1;
+				break;
+			case 0:
+				ewake = 1;
+				break;
+			}
+		}
+		wake_up(&ep->wq);
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
+out:
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
-	return 1;
+	if (!(epi->event.events & EPOLLEXCLUSIVE))
+		ewake = 1;
+
+	if ((unsigned long)key & POLLFREE) {
+		/*
+		 * If we race with ep_remove_wait_queue() it can miss
+		 * ->whead = NULL and do another remove_wait_queue() after
+		 * us, so we can't use __remove_wait_queue(). whead->lock
+		 * is held by the caller.
+		 */
+		list_del_init(&wait->task_list);
+		/*
+		 * ->whead != NULL keeps ep_remove() from freeing the item
+		 * under us, since ep_remove_wait_queue() then takes the
+		 * whead->lock we are called with. Clear it last: once it
+		 * is NULL, nothing protects ep, epi or even wait.
+		 */
+		smp_mb();
+		ep_pwq_from_wait(wait)->whead = NULL;
+	}
+
+	return ewake;
 }
 
 /*
@@ -941,7 +1031,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1093,6 +1186,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	epi->event = *event;
 	epi->nwait = 0;
 	epi->next = EP_UNACTIVE_PTR;
+	epi->rdlqueued = 0;
 
 	/* Initialize the poll table using the queue callback */
 	epq.epi = epi;
@@ -1141,7 +1235,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 
 		/* Notify waiting tasks that events are available */
 		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+			wake_up(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -1174,6 +1268,7 @@ error_unregister:
 	 * And ep_insert() is called with "mtx" held.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_drain_ready_queue(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -1206,9 +1301,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 * 1) Flush epi changes above to other CPUs.  This ensures
 	 *    we do not miss events from ep_poll_callback if an
 	 *    event occurs immediately after we call f_op->poll().
-	 *    We need this because we did not take ep->lock while
-	 *    changing epi above (but ep_poll_callback does take
-	 *    ep->lock).
+	 *    We need this because ep_poll_callback reads the
+	 *    event mask without taking any lock.
 	 *
 	 * 2) We also need to ensure we do not miss _past_ events
 	 *    when calling f_op->poll().  This barrier also
@@ -1237,7 +1331,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 
 			/* Notify waiting tasks that events are available */
 			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
+				wake_up(&ep->wq);
 			if (waitqueue_active(&ep->poll_wait))
 				pwake++;
 		}
@@ -1255,39 +1349,55 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 			       void *priv)
 {
 	struct ep_send_events_data *esed = priv;
-	int eventcnt;
+	int eventcnt, nr, i;
 	unsigned int revents;
 	struct epitem *epi;
-	struct epoll_event __user *uevent;
+	struct epitem *harvest[EP_SEND_BATCH];
+	struct epoll_event batch[EP_SEND_BATCH];
 
 	/*
 	 * We can loop without lock because we are passed a task private list.
 	 * Items cannot vanish during the loop because ep_scan_ready_list() is
 	 * holding "mtx" during this call.
 	 */
-	for (eventcnt = 0, uevent = esed->events;
-	     !list_empty(head) && eventcnt < esed->maxevents;) {
-		epi = list_first_entry(head, struct epitem, rdllink);
+	for (eventcnt = 0; !list_empty(head) && eventcnt < esed->maxevents;) {
+		/*
+		 * Harvest a batch of ready events in kernel memory, so that
+		 * they reach userspace with a single copy.
+		 */
+		for (nr = 0; !list_empty(head) && nr < EP_SEND_BATCH &&
+			     eventcnt + nr < esed->maxevents;) {
+			epi = list_first_entry(head, struct epitem, rdllink);
 
-		list_del_init(&epi->rdllink);
+			list_del_init(&epi->rdllink);
 
-		revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
-			epi->event.events;
+			revents = epi->ffd.file->f_op->poll(epi->ffd.file, NULL) &
+				epi->event.events;
 
-		/*
-		 * If the event mask intersect the caller-requested one,
-		 * deliver the event to userspace. Again, ep_scan_ready_list()
-		 * is holding "mtx", so no operations coming from userspace
-		 * can change the item.
-		 */
-		if (revents) {
-			if (__put_user(revents, &uevent->events) ||
-			    __put_user(epi->event.data, &uevent->data)) {
-				list_add(&epi->rdllink, head);
-				return eventcnt ? eventcnt : -EFAULT;
+			/*
+			 * If the event mask intersect the caller-requested one,
+			 * deliver the event to userspace. Again,
+			 * ep_scan_ready_list() is holding "mtx", so no
+			 * operations coming from userspace can change the item.
+			 */
+			if (revents) {
+				batch[nr].events = revents;
+				batch[nr].data = epi->event.data;
+				harvest[nr++] = epi;
 			}
-			eventcnt++;
-			uevent++;
+		}
+
+		if (__copy_to_user(esed->events + eventcnt, batch,
+				   nr * sizeof(struct epoll_event))) {
+			/* Put the whole batch back, in its original order */
+			while (nr--)
+				list_add(&harvest[nr]->rdllink, head);
+			return eventcnt ? eventcnt : -EFAULT;
+		}
+		eventcnt += nr;
+
+		for (i = 0; i < nr; i++) {
+			epi = harvest[i];
 			if (epi->event.events & EPOLLONESHOT)
 				epi->event.events &= EP_PRIVATE_BITS;
 			else if (!(epi->event.events & EPOLLET)) {
@@ -1300,7 +1410,8 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * items queued by the poll callback are moved
+				 * to ep->ovflist.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
 			}
@@ -1384,7 +1495,10 @@ fetch_events:
 		 * ep_poll_callback() when events will become available.
 		 */
 		init_waitqueue_entry(&wait, current);
+		/* ep_poll_callback() wakes us up without holding ep->lock */
+		spin_lock(&ep->wq.lock);
 		__add_wait_queue_exclusive(&ep->wq, &wait);
+		spin_unlock(&ep->wq.lock);
 
 		for (;;) {
 			/*
@@ -1406,7 +1520,9 @@ fetch_events:
 
 			spin_lock_irqsave(&ep->lock, flags);
 		}
+		spin_lock(&ep->wq.lock);
 		__remove_wait_queue(&ep->wq, &wait);
+		spin_unlock(&ep->wq.lock);
 
 		set_current_state(TASK_RUNNING);
 	}
@@ -1624,6 +1740,19 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (file == tfile || !is_file_epoll(file))
 		goto error_tgt_fput;
 
+	/*
+	 * epoll adds to the wakeup queue at EPOLL_CTL_ADD time only,
+	 * so EPOLLEXCLUSIVE is not allowed for a EPOLL_CTL_MOD operation.
+	 * Exclusive wakeups are not supported on nested epoll sets either.
+	 */
+	if (ep_op_has_event(op) && (epds.events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD)
+			goto error_tgt_fput;
+		if (op == EPOLL_CTL_ADD && (is_file_epoll(tfile) ||
+				(epds.events & ~EPOLLEXCLUSIVE_OK_BITS)))
+			goto error_tgt_fput;
+	}
+
 	/*
 	 * At this point it is safe to assume that the "private_data" contains
 	 * our own data structure.
@@ -1682,8 +1811,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds.events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, &epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
@@ -699,6 +699,8 @@ static void do_checkpoint(struct f2fs_sb_info *sbi, bool is_umount)
 		start_blk += NR_CURSEG_NODE_TYPE;
 	}
 
+	sbi->cp_pack_blks = le32_to_cpu(ckpt->cp_pack_total_block_count);
+
 	/* writeout checkpoint block */
 	cp_page = grab_meta_page(sbi, start_blk);
 	kaddr = page_address(cp_page);
@@ -753,6 +755,8 @@ void write_checkpoint(struct f2fs_sb_info *sbi, bool blocked, bool is_umount)
 	ckpt->checkpoint_ver = cpu_to_le64(++ckpt_ver);
 
 	/* write cached NAT/SIT entries to NAT/SIT area */
+	sbi->cp_nat_blks = 0;
+	sbi->cp_sit_blks = 0;
 	flush_nat_entries(sbi);
 	flush_sit_entries(sbi);
 
@@ -761,6 +765,10 @@ void write_checkpoint(struct f2fs_sb_info *sbi, bool blocked, bool is_umount)
 	/* unlock all the fs_lock[] in do_checkpoint() */
 	do_checkpoint(sbi, is_umount);
 
+	sbi->cp_count++;
+	sbi->cp_meta_blks += sbi->cp_nat_blks + sbi->cp_sit_blks +
+						sbi->cp_pack_blks;
+
 	unblock_operations(sbi);
 	mutex_unlock(&sbi->cp_mutex);
 }
@@ -57,6 +57,15 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->sits = SIT_I(sbi)->dirty_sentries;
 	si->fnids = NM_I(sbi)->fcnt;
 	si->bg_gc = sbi->bg_gc;
+	si->sits_in_journal =
+		sits_in_cursum(CURSEG_I(sbi, CURSEG_COLD_DATA)->sum_blk);
+	si->nats_in_journal =
+		nats_in_cursum(CURSEG_I(sbi, CURSEG_HOT_DATA)->sum_blk);
+	si->cp_count = sbi->cp_count;
+	si->cp_sit_blks = sbi->cp_sit_blks;
+	si->cp_nat_blks = sbi->cp_nat_blks;
+	si->cp_pack_blks = sbi->cp_pack_blks;
+	si->cp_meta_blks = sbi->cp_meta_blks;
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
 		* 100 / (int)(sbi->user_block_count >> sbi->log_blocks_per_seg)
 		/ 2;
@@ -243,6 +252,17 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "Try to move %d blocks\n", si->tot_blks);
 		seq_printf(s, "  - data blocks : %d\n", si->data_blks);
 		seq_printf(s, "  - node blocks : %d\n", si->node_blks);
+		seq_printf(s, "\nCP calls: %u\n", si->cp_count);
+		seq_printf(s, "  - meta blocks : %u (SIT: %u, NAT: %u, "
+			   "pack: %u)\n",
+			   si->cp_sit_blks + si->cp_nat_blks + si->cp_pack_blks,
+			   si->cp_sit_blks, si->cp_nat_blks, si->cp_pack_blks);
+		seq_printf(s, "  - avg. meta blocks : %llu\n",
+			   si->cp_count ?
+			   div_u64(si->cp_meta_blks, si->cp_count) : 0);
+		seq_printf(s, "  - journal : SIT %d / %zu, NAT %d / %zu\n",
+			   si->sits_in_journal, SIT_JOURNAL_ENTRIES,
+			   si->nats_in_journal, NAT_JOURNAL_ENTRIES);
 		seq_printf(s, "\nExtent Hit Ratio: %d / %d\n",
 			   si->hit_ext, si->total_ext);
 		seq_printf(s, "\nBalancing F2FS Async:\n");
@@ -28,6 +28,7 @@
 #define F2FS_MOUNT_XATTR_USER		0x00000010
 #define F2FS_MOUNT_POSIX_ACL		0x00000020
 #define F2FS_MOUNT_DISABLE_EXT_IDENTIFY	0x00000040
+#define F2FS_MOUNT_BATCH_CP_FLUSH	0x00000080
 
 #define clear_opt(sbi, option)	(sbi->mount_opt.opt &= ~F2FS_MOUNT_##option)
 #define set_opt(sbi, option)	(sbi->mount_opt.opt |= F2FS_MOUNT_##option)
@@ -404,6 +405,13 @@ struct f2fs_sb_info {
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
 	int bg_gc;				/* background gc calls */
 	spinlock_t stat_lock;			/* lock for stat operations */
+
+	/* meta blocks written by checkpoints, see write_checkpoint() */
+	unsigned int cp_count;			/* # of checkpoints */
+	unsigned int cp_sit_blks;		/* SIT blocks in the last cp */
+	unsigned int cp_nat_blks;		/* NAT blocks in the last cp */
+	unsigned int cp_pack_blks;		/* cp pack blocks in the last cp */
+	unsigned long long cp_meta_blks;	/* total meta blocks of all cps */
 };
 
 /*
@@ -1010,6 +1018,9 @@ struct f2fs_stat_info {
 	int nats, sits, fnids;
 	int total_count, utilization;
 	int bg_gc;
+	int sits_in_journal, nats_in_journal;
+	unsigned int cp_count, cp_sit_blks, cp_nat_blks, cp_pack_blks;
+	unsigned long long cp_meta_blks;
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
 	int util_free, util_valid, util_invalid;
@@ -77,6 +77,7 @@ static struct page *get_next_nat_page(struct f2fs_sb_info *sbi, nid_t nid)
 	f2fs_put_page(src_page, 1);
 
 	set_to_next_nat(nm_i, nid);
+	sbi->cp_nat_blks++;
 
 	return dst_page;
 }
@@ -1539,6 +1540,35 @@ retry:
 	return true;
 }
 
+/*
+ * With batch_cp_flush, move the journal entries covered by the NAT block
+ * that is being written into that block, and free their journal slots.
+ * The caller should hold curseg_mutex.
+ */
+static void evict_nats_in_journal(struct f2fs_sb_info *sbi,
+		struct f2fs_nat_block *nat_blk, nid_t start_nid, nid_t end_nid)
+{
+	struct curseg_info *curseg = CURSEG_I(sbi, CURSEG_HOT_DATA);
+	struct f2fs_summary_block *sum = curseg->sum_blk;
+	int i, last;
+
+	for (i = nats_in_cursum(sum) - 1; i >= 0; i--) {
+		nid_t nid = le32_to_cpu(nid_in_journal(sum, i));
+
+		if (nid < start_nid || nid > end_nid)
+			continue;
+
+		nat_blk->entries[nid - start_nid] = nat_in_journal(sum, i);
+
+		/* entries after i are already checked, so fill the hole */
+		last = update_nats_in_cursum(sum, -1) - 1;
+		if (i != last) {
+			nid_in_journal(sum, i) = nid_in_journal(sum, last);
+			nat_in_journal(sum, i) = nat_in_journal(sum, last);
+		}
+	}
+}
+
 /*
  * This function is called during the checkpointing process.
  */
@@ -1551,9 +1581,11 @@ void flush_nat_entries(struct f2fs_sb_info *sbi)
 	struct page *page = NULL;
 	struct f2fs_nat_block *nat_blk = NULL;
 	nid_t start_nid = 0, end_nid = 0;
-	bool flushed;
+	bool batched = test_opt(sbi, BATCH_CP_FLUSH);
+	bool flushed = false;
 
-	flushed = flush_nats_in_journal(sbi);
+	if (!batched)
+		flushed = flush_nats_in_journal(sbi);
 
 	if (!flushed)
 		mutex_lock(&curseg->curseg_mutex);
@@ -1574,6 +1606,10 @@ void flush_nat_entries(struct f2fs_sb_info *sbi)
 		if (flushed)
 			goto to_nat_page;
 
+		/* the NAT block being written costs nothing more */
+		if (batched && page && start_nid <= nid && nid <= end_nid)
+			goto to_nat_page;
+
 		/* if there is room for nat enries in curseg->sumpage */
 		offset = lookup_journal_in_cursum(sum, NAT_JOURNAL, nid, 1);
 		if (offset >= 0) {
@@ -1595,6 +1631,10 @@ to_nat_page:
 			 */
 			page = get_next_nat_page(sbi, start_nid);
 			nat_blk = page_address(page);
+
+			if (batched)
+				evict_nats_in_journal(sbi, nat_blk,
+							start_nid, end_nid);
 		}
 
 		BUG_ON(!nat_blk);
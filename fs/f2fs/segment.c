@@ -1243,6 +1243,7 @@ static struct page *get_next_sit_page(struct f2fs_sb_info *sbi,
 	f2fs_put_page(src_page, 1);
 
 	set_to_next_sit(sit_i, start);
+	sbi->cp_sit_blks++;
 
 	return dst_page;
 }
@@ -1270,6 +1271,41 @@ static bool flush_sits_in_journal(struct f2fs_sb_info *sbi)
 	return 0;
 }
 
+/*
+ * With batch_cp_flush, a SIT block that has to be written anyway absorbs
+ * the journal entries belonging to it. This frees journal slots for the
+ * next deltas without dumping the whole journal to the SIT area.
+ */
+static void evict_sits_in_journal(struct f2fs_sb_info *sbi,
+		struct f2fs_sit_block *raw_sit, unsigned int start,
+		unsigned int end)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct curseg_info *curseg = CURSEG_I(sbi, CURSEG_COLD_DATA);
+	struct f2fs_summary_block *sum = curseg->sum_blk;
+	int i, last;
+
+	for (i = sits_in_cursum(sum) - 1; i >= 0; i--) {
+		unsigned int segno = le32_to_cpu(segno_in_journal(sum, i));
+		int sit_offset = SIT_ENTRY_OFFSET(sit_i, segno);
+
+		if (segno < start || segno > end)
+			continue;
+
+		seg_info_to_raw_sit(get_seg_entry(sbi, segno),
+					&raw_sit->entries[sit_offset]);
+		if (__test_and_clear_bit(segno, sit_i->dirty_sentries_bitmap))
+			sit_i->dirty_sentries--;
+
+		/* entries after i are already checked, so fill the hole */
+		last = update_sits_in_cursum(sum, -1) - 1;
+		if (i != last) {
+			segno_in_journal(sum, i) = segno_in_journal(sum, last);
+			sit_in_journal(sum, i) = sit_in_journal(sum, last);
+		}
+	}
+}
+
 /*
  * CP calls this function, which flushes SIT entries including sit_journal,
  * and moves prefree segs to free segs.
@@ -1285,7 +1321,8 @@ void flush_sit_entries(struct f2fs_sb_info *sbi)
 	struct f2fs_sit_block *raw_sit = NULL;
 	unsigned int start = 0, end = 0;
 	unsigned int segno = -1;
-	bool flushed;
+	bool batched = test_opt(sbi, BATCH_CP_FLUSH);
+	bool flushed = false;
 
 	mutex_lock(&curseg->curseg_mutex);
 	mutex_lock(&sit_i->sentry_lock);
@@ -1294,7 +1331,8 @@ void flush_sit_entries(struct f2fs_sb_info *sbi)
 	 * "flushed" indicates whether sit entries in journal are flushed
 	 * to the SIT area or not.
 	 */
-	flushed = flush_sits_in_journal(sbi);
+	if (!batched)
+		flushed = flush_sits_in_journal(sbi);
 
 	while ((segno = find_next_bit(bitmap, nsegs, segno + 1)) < nsegs) {
 		struct seg_entry *se = get_seg_entry(sbi, segno);
@@ -1305,6 +1343,10 @@ void flush_sit_entries(struct f2fs_sb_info *sbi)
 		if (flushed)
 			goto to_sit_page;
 
+		/* the SIT block being written costs nothing more */
+		if (batched && page && start <= segno && segno <= end)
+			goto to_sit_page;
+
 		offset = lookup_journal_in_cursum(sum, SIT_JOURNAL, segno, 1);
 		if (offset >= 0) {
 			segno_in_journal(sum, offset) = cpu_to_le32(segno);
@@ -1324,6 +1366,9 @@ to_sit_page:
 			/* read sit block that will be updated */
 			page = get_next_sit_page(sbi, start);
 			raw_sit = page_address(page);
+
+			if (batched)
+				evict_sits_in_journal(sbi, raw_sit, start, end);
 		}
 
 		/* udpate entry in SIT block */
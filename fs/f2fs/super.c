@@ -38,6 +38,7 @@ enum {
 	Opt_noacl,
 	Opt_active_logs,
 	Opt_disable_ext_identify,
+	Opt_batch_cp_flush,
 	Opt_err,
 };
 
@@ -50,6 +51,7 @@ static match_table_t f2fs_tokens = {
 	{Opt_noacl, "noacl"},
 	{Opt_active_logs, "active_logs=%u"},
 	{Opt_disable_ext_identify, "disable_ext_identify"},
+	{Opt_batch_cp_flush, "batch_cp_flush"},
 	{Opt_err, NULL},
 };
 
@@ -185,6 +187,8 @@ static int f2fs_show_options(struct seq_file *seq, struct vfsmount *vfs)
 #endif
 	if (test_opt(sbi, DISABLE_EXT_IDENTIFY))
 		seq_puts(seq, ",disable_ext_indentify");
+	if (test_opt(sbi, BATCH_CP_FLUSH))
+		seq_puts(seq, ",batch_cp_flush");
 
 	seq_printf(seq, ",active_logs=%u", sbi->active_logs);
 
@@ -308,6 +312,9 @@ static int parse_options(struct f2fs_sb_info *sbi, char *options)
 		case Opt_disable_ext_identify:
 			set_opt(sbi, DISABLE_EXT_IDENTIFY);
 			break;
+		case Opt_batch_cp_flush:
+			set_opt(sbi, BATCH_CP_FLUSH);
+			break;
 		default:
 			pr_err("Unrecognized mount option \"%s\" or missing value\n",
 					p);
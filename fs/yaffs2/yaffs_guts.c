@@ -26,6 +26,7 @@
 #include "yaffs_yaffs2.h"
 #include "yaffs_bitmap.h"
 #include "yaffs_verify.h"
+#include "yaffs_summary.h"
 
 #include "yaffs_nand.h"
 #include "yaffs_packedtags2.h"
@@ -474,8 +475,12 @@ static int yaffs_alloc_chunk(struct yaffs_dev *dev, int use_reserver,
 
 		dev->n_free_chunks--;
 
-		/* If the block is full set the state to full */
-		if (dev->alloc_page >= dev->param.chunks_per_block) {
+		/* If the block is full set the state to full. A block that
+		 * collects a summary keeps its last chunks for it.
+		 */
+		if (dev->alloc_page >= dev->param.chunks_per_block ||
+		    (dev->alloc_page >= dev->chunks_per_summary &&
+		     dev->sum_block == dev->alloc_block)) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
 			dev->alloc_block = -1;
 		}
@@ -604,6 +609,8 @@ static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 		/* Copy the data into the robustification buffer */
 		yaffs_handle_chunk_wr_ok(dev, chunk, data, tags);
 
+		yaffs_summary_add(dev, tags, chunk);
+
 	} while (write_ok != YAFFS_OK &&
 		 (yaffs_wr_attempts <= 0 || attempts <= yaffs_wr_attempts));
 
@@ -761,6 +768,11 @@ void yaffs_load_tnode_0(struct yaffs_dev *dev, struct yaffs_tnode *tn,
 	pos &= YAFFS_TNODES_LEVEL0_MASK;
 	val >>= dev->chunk_grp_bits;
 
+	if (dev->tnode_width == 32) {
+		map[pos] = val;
+		return;
+	}
+
 	bit_in_map = pos * dev->tnode_width;
 	word_in_map = bit_in_map / 32;
 	bit_in_word = bit_in_map & (32 - 1);
@@ -770,7 +782,7 @@ void yaffs_load_tnode_0(struct yaffs_dev *dev, struct yaffs_tnode *tn,
 	map[word_in_map] &= ~mask;
 	map[word_in_map] |= (mask & (val << bit_in_word));
 
-	if (dev->tnode_width > (32 - bit_in_word)) {
+	if (!dev->tnode_aligned && dev->tnode_width > (32 - bit_in_word)) {
 		bit_in_word = (32 - bit_in_word);
 		word_in_map++;;
 		mask =
@@ -791,13 +803,16 @@ u32 yaffs_get_group_base(struct yaffs_dev *dev, struct yaffs_tnode *tn,
 
 	pos &= YAFFS_TNODES_LEVEL0_MASK;
 
+	if (dev->tnode_width == 32)
+		return map[pos] << dev->chunk_grp_bits;
+
 	bit_in_map = pos * dev->tnode_width;
 	word_in_map = bit_in_map / 32;
 	bit_in_word = bit_in_map & (32 - 1);
 
 	val = map[word_in_map] >> bit_in_word;
 
-	if (dev->tnode_width > (32 - bit_in_word)) {
+	if (!dev->tnode_aligned && dev->tnode_width > (32 - bit_in_word)) {
 		bit_in_word = (32 - bit_in_word);
 		word_in_map++;;
 		val |= (map[word_in_map] << bit_in_word);
@@ -1002,6 +1017,39 @@ static int yaffs_find_chunk_in_group(struct yaffs_dev *dev, int the_chunk,
 	return -1;
 }
 
+static void yaffs_invalidate_file_extent(struct yaffs_obj *in)
+{
+	in->variant.file_variant.ext_len = 0;
+}
+
+/*
+ * Cache the run of consecutive NAND chunks around inode_chunk in its level 0
+ * tnode. Only done when tnode entries are exact chunk numbers, otherwise the
+ * chunk group still has to be searched by reading tags.
+ */
+static void yaffs_load_file_extent(struct yaffs_obj *in,
+				   struct yaffs_tnode *tn,
+				   u32 inode_chunk, int nand_chunk)
+{
+	struct yaffs_dev *dev = in->my_dev;
+	struct yaffs_file_var *file_struct = &in->variant.file_variant;
+	u32 first = inode_chunk & YAFFS_TNODES_LEVEL0_MASK;
+	u32 last = first;
+	int base = nand_chunk - first;
+
+	while (first > 0 &&
+	       yaffs_get_group_base(dev, tn, first - 1) == base + first - 1)
+		first--;
+	while (last < YAFFS_NTNODES_LEVEL0 - 1 &&
+	       yaffs_get_group_base(dev, tn, last + 1) == base + last + 1)
+		last++;
+
+	file_struct->ext_start = (inode_chunk & ~YAFFS_TNODES_LEVEL0_MASK) +
+	    first;
+	file_struct->ext_len = last - first + 1;
+	file_struct->ext_nand = base + first;
+}
+
 static int yaffs_find_chunk_in_file(struct yaffs_obj *in, int inode_chunk,
 				    struct yaffs_ext_tags *tags)
 {
@@ -1010,6 +1058,7 @@ static int yaffs_find_chunk_in_file(struct yaffs_obj *in, int inode_chunk,
 	int the_chunk = -1;
 	struct yaffs_ext_tags local_tags;
 	int ret_val = -1;
+	struct yaffs_file_var *file_struct = &in->variant.file_variant;
 
 	struct yaffs_dev *dev = in->my_dev;
 
@@ -1018,7 +1067,17 @@ static int yaffs_find_chunk_in_file(struct yaffs_obj *in, int inode_chunk,
 		tags = &local_tags;
 	}
 
-	tn = yaffs_find_tnode_0(dev, &in->variant.file_variant, inode_chunk);
+	if (file_struct->ext_len &&
+	    (u32) inode_chunk - file_struct->ext_start < file_struct->ext_len) {
+		dev->n_extent_hits++;
+		the_chunk = file_struct->ext_nand +
+		    (inode_chunk - file_struct->ext_start);
+		return yaffs_find_chunk_in_group(dev, the_chunk, tags,
+						 in->obj_id, inode_chunk);
+	}
+
+	dev->n_tnode_lookups++;
+	tn = yaffs_find_tnode_0(dev, file_struct, inode_chunk);
 
 	if (tn) {
 		the_chunk = yaffs_get_group_base(dev, tn, inode_chunk);
@@ -1026,6 +1085,9 @@ static int yaffs_find_chunk_in_file(struct yaffs_obj *in, int inode_chunk,
 		ret_val =
 		    yaffs_find_chunk_in_group(dev, the_chunk, tags, in->obj_id,
 					      inode_chunk);
+
+		if (ret_val > 0 && dev->chunk_grp_size == 1)
+			yaffs_load_file_extent(in, tn, inode_chunk, ret_val);
 	}
 	return ret_val;
 }
@@ -1057,8 +1119,10 @@ static int yaffs_find_del_file_chunk(struct yaffs_obj *in, int inode_chunk,
 					      inode_chunk);
 
 		/* Delete the entry in the filestructure (if found) */
-		if (ret_val != -1)
+		if (ret_val != -1) {
 			yaffs_load_tnode_0(dev, tn, inode_chunk, 0);
+			yaffs_invalidate_file_extent(in);
+		}
 	}
 
 	return ret_val;
@@ -1184,6 +1248,7 @@ int yaffs_put_chunk_in_file(struct yaffs_obj *in, int inode_chunk,
 		in->n_data_chunks++;
 
 	yaffs_load_tnode_0(dev, tn, inode_chunk, nand_chunk);
+	yaffs_invalidate_file_extent(in);
 
 	return YAFFS_OK;
 }
@@ -1218,6 +1283,8 @@ static int yaffs_soft_del_worker(struct yaffs_obj *in, struct yaffs_tnode *tn,
 	int all_done = 1;
 	struct yaffs_dev *dev = in->my_dev;
 
+	yaffs_invalidate_file_extent(in);
+
 	if (tn) {
 		if (level > 0) {
 
@@ -1950,12 +2017,20 @@ struct yaffs_obj *yaffs_find_by_number(struct yaffs_dev *dev, u32 number)
 	struct list_head *i;
 	struct yaffs_obj *in;
 
+	dev->n_obj_lookups++;
+
 	list_for_each(i, &dev->obj_bucket[bucket].list) {
+		dev->n_obj_lookup_steps++;
 		/* Look if it is in the list */
 		if (i) {
 			in = list_entry(i, struct yaffs_obj, hash_link);
 			if (in->obj_id == number) {
 
+				/* Move to the front so hot objects are
+				 * found after the first step next time.
+				 */
+				list_move(i, &dev->obj_bucket[bucket].list);
+
 				/* Don't tell the VFS about this one if it is defered free */
 				if (in->defered_free)
 					return NULL;
@@ -2006,6 +2081,7 @@ struct yaffs_obj *yaffs_new_obj(struct yaffs_dev *dev, int number,
 			the_obj->variant.file_variant.shrink_size = ~0;	/* max */
 			the_obj->variant.file_variant.top_level = 0;
 			the_obj->variant.file_variant.top = tn;
+			yaffs_invalidate_file_extent(the_obj);
 			break;
 		case YAFFS_OBJECT_TYPE_DIRECTORY:
 			INIT_LIST_HEAD(&the_obj->variant.dir_variant.children);
@@ -2422,6 +2498,7 @@ void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
 		bi->pages_in_use = 0;
 		bi->soft_del_pages = 0;
 		bi->has_shrink_hdr = 0;
+		bi->has_summary = 0;
 		bi->skip_erased_check = 1;	/* Clean, so no need to check */
 		bi->gc_prioritise = 0;
 		yaffs_clear_chunk_bits(dev, block_no);
@@ -2473,6 +2550,9 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 
 	bi->has_shrink_hdr = 0;	/* clear the flag so that the block can erase */
 
+	/* The summary chunks only describe this block, drop them */
+	yaffs_summary_gc(dev, block);
+
 	dev->gc_disable = 1;
 
 	if (is_checkpt_block || !yaffs_still_some_chunks(dev, block)) {
@@ -4879,8 +4959,19 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	} else {
 		dev->tnode_width = 16;
         }
+	dev->tnode_width_packed = dev->tnode_width;
+
+	/* Word aligned entries trade memory for simpler access. Only
+	 * wide tnodes change: 16 bit ones are aligned already.
+	 */
+	if (dev->param.aligned_tnodes && dev->tnode_width > 16)
+		dev->tnode_width = 32;
+	dev->tnode_aligned = (32 % dev->tnode_width) == 0;
 
-	dev->tnode_mask = (1 << dev->tnode_width) - 1;
+	if (dev->tnode_width == 32)
+		dev->tnode_mask = 0xffffffff;
+	else
+		dev->tnode_mask = (1 << dev->tnode_width) - 1;
 
 	/* Level0 Tnodes are 16 bits or wider (if wide tnodes are enabled),
 	 * so if the bitwidth of the
@@ -4938,6 +5029,10 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	if (!yaffs_init_tmp_buffers(dev))
 		init_failed = 1;
 
+	dev->sum_tags = NULL;
+	if (!init_failed && !yaffs_summary_init(dev))
+		init_failed = 1;
+
 	dev->cache = NULL;
 	dev->gc_cleanup_list = NULL;
 
@@ -5090,6 +5185,8 @@ void yaffs_deinitialise(struct yaffs_dev *dev)
 
 		kfree(dev->gc_cleanup_list);
 
+		yaffs_summary_deinit(dev);
+
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
 			kfree(dev->temp_buffer[i].buffer);
 
@@ -80,6 +80,7 @@
 
 /* Pseudo object ids for checkpointing */
 #define YAFFS_OBJECTID_SB_HEADER	0x10
+#define YAFFS_OBJECTID_SUMMARY		0x11
 #define YAFFS_OBJECTID_CHECKPOINT_DATA	0x20
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
@@ -281,11 +282,19 @@ struct yaffs_block_info {
 
 #ifdef CONFIG_YAFFS_YAFFS2
 	u32 has_shrink_hdr:1;	/* This block has at least one shrink object header */
+	u32 has_summary:1;	/* The last chunks of this block hold a tags summary */
 	u32 seq_number;		/* block sequence number for yaffs2 */
 #endif
 
 };
 
+/* Tags for one chunk as stored in a block summary */
+struct yaffs_summary_tags {
+	unsigned obj_id;
+	unsigned chunk_id;
+	unsigned n_bytes;
+};
+
 /* -------------------------- Object structure -------------------------------*/
 /* This is the object structure as stored on NAND */
 
@@ -352,6 +361,14 @@ struct yaffs_file_var {
 	u32 shrink_size;
 	int top_level;
 	struct yaffs_tnode *top;
+
+	/* Extent cache: a run of inode chunks found in consecutive NAND
+	 * chunks, so that sequential reads don't walk the tnode tree for
+	 * every chunk. ext_len == 0 means nothing is cached.
+	 */
+	u32 ext_start;
+	u32 ext_len;
+	int ext_nand;
 };
 
 struct yaffs_dir_var {
@@ -565,7 +582,9 @@ struct yaffs_param {
 	/* Debug control flags. Don't use unless you know what you're doing */
 	int use_header_file_size;	/* Flag to determine if we should use file sizes from the header */
 	int disable_lazy_load;	/* Disable lazy loading on this device */
+	int disable_summary;	/* yaffs2 only: Don't write block summaries */
 	int wide_tnodes_disabled;	/* Set to disable wide tnodes */
+	int aligned_tnodes;	/* Round tnode entries up to 16 or 32 bits */
 	int disable_soft_del;	/* yaffs 1 only: Set to disable the use of softdeletion. */
 
 	int defered_dir_update;	/* Set to defer directory updates */
@@ -597,8 +616,10 @@ struct yaffs_dev {
 
 	/* Stuff to support wide tnodes */
 	u32 tnode_width;
+	u32 tnode_width_packed;	/* Width before aligned rounding */
 	u32 tnode_mask;
 	u32 tnode_size;
+	u32 tnode_aligned;	/* Level 0 entries never straddle a u32 */
 
 	/* Stuff for figuring out file offset to chunk conversions */
 	u32 chunk_shift;	/* Shift value */
@@ -713,6 +734,11 @@ struct yaffs_dev {
 	/* Dirty directory handling */
 	struct list_head dirty_dirs;	/* List of dirty directories */
 
+	/* Block summaries */
+	int chunks_per_summary;	/* Data chunks per block, the rest hold the summary */
+	int sum_block;		/* Block whose summary is being collected, or -1 */
+	struct yaffs_summary_tags *sum_tags;
+
 	/* Statistcs */
 	u32 n_page_writes;
 	u32 n_page_reads;
@@ -734,6 +760,12 @@ struct yaffs_dev {
 	u32 n_unmarked_deletions;
 	u32 refresh_count;
 	u32 cache_hits;
+	u32 n_sum_blocks_scanned;	/* Blocks scanned from their summary */
+	u32 n_sum_blocks_fallback;	/* Full blocks scanned chunk by chunk */
+	u32 n_obj_lookups;	/* yaffs_find_by_number() calls */
+	u32 n_obj_lookup_steps;	/* Hash bucket entries visited by them */
+	u32 n_extent_hits;	/* File chunk lookups served by the extent cache */
+	u32 n_tnode_lookups;	/* File chunk lookups that walked the tnode tree */
 
 };
 
@@ -33,6 +33,7 @@ struct yaffs_linux_context {
 
 	struct task_struct *readdir_process;
 	unsigned mount_id;
+	unsigned mount_msecs;	/* Time yaffs_guts_initialise() took */
 };
 
 #define yaffs_dev_to_lc(dev) ((struct yaffs_linux_context *)((dev)->os_context))
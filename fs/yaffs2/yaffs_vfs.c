@@ -1764,6 +1764,10 @@ struct yaffs_options {
 	int lazy_loading_overridden;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
+	int summary_enabled;
+	int summary_overridden;
+	int aligned_tnodes;
+	int aligned_tnodes_overridden;
 };
 
 #define MAX_OPT_LEN 30
@@ -1805,6 +1809,18 @@ static int yaffs_parse_options(struct yaffs_options *options,
 		} else if (!strcmp(cur_opt, "lazy-loading-on")) {
 			options->lazy_loading_enabled = 1;
 			options->lazy_loading_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-off")) {
+			options->summary_enabled = 0;
+			options->summary_overridden = 1;
+		} else if (!strcmp(cur_opt, "summary-on")) {
+			options->summary_enabled = 1;
+			options->summary_overridden = 1;
+		} else if (!strcmp(cur_opt, "aligned-tnodes-off")) {
+			options->aligned_tnodes = 0;
+			options->aligned_tnodes_overridden = 1;
+		} else if (!strcmp(cur_opt, "aligned-tnodes-on")) {
+			options->aligned_tnodes = 1;
+			options->aligned_tnodes_overridden = 1;
 		} else if (!strcmp(cur_opt, "empty-lost-and-found-off")) {
 			options->empty_lost_and_found = 0;
 			options->empty_lost_and_found_overridden = 1;
@@ -2026,6 +2042,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	struct yaffs_options options;
 
 	unsigned mount_id;
+	unsigned long mount_start;
 	int found;
 	struct yaffs_linux_context *context_iterator;
 	struct list_head *l;
@@ -2227,6 +2244,18 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	if (options.lazy_loading_overridden)
 		param->disable_lazy_load = !options.lazy_loading_enabled;
 
+#ifdef CONFIG_YAFFS_DISABLE_SUMMARY
+	param->disable_summary = 1;
+#endif
+	if (options.summary_overridden)
+		param->disable_summary = !options.summary_enabled;
+
+#ifdef CONFIG_YAFFS_ALIGNED_TNODES
+	param->aligned_tnodes = 1;
+#endif
+	if (options.aligned_tnodes_overridden)
+		param->aligned_tnodes = options.aligned_tnodes;
+
 #ifdef CONFIG_YAFFS_DISABLE_TAGS_ECC
 	param->no_tags_ecc = 1;
 #endif
@@ -2324,7 +2353,9 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 
 	yaffs_gross_lock(dev);
 
+	mount_start = jiffies;
 	err = yaffs_guts_initialise(dev);
+	context->mount_msecs = jiffies_to_msecs(jiffies - mount_start);
 
 	yaffs_trace(YAFFS_TRACE_OS,
 		"yaffs_read_super: guts initialised %s",
@@ -2435,6 +2466,10 @@ static char *yaffs_dump_dev_part0(char *buf, struct yaffs_dev *dev)
 			param->empty_lost_n_found);
 	buf += sprintf(buf, "disable_lazy_load..... %d\n",
 			param->disable_lazy_load);
+	buf += sprintf(buf, "disable_summary....... %d\n",
+			param->disable_summary);
+	buf += sprintf(buf, "aligned_tnodes........ %d\n",
+			param->aligned_tnodes);
 	buf += sprintf(buf, "refresh_period........ %d\n",
 			param->refresh_period);
 	buf += sprintf(buf, "n_caches.............. %d\n", param->n_caches);
@@ -2457,6 +2492,12 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_erased_blocks....... %d\n", dev->n_erased_blocks);
 	buf +=
 	    sprintf(buf, "blocks_in_checkpt..... %d\n", dev->blocks_in_checkpt);
+	buf +=
+	    sprintf(buf, "chunks_per_summary.... %d\n", dev->chunks_per_summary);
+	buf += sprintf(buf, "tnode_width........... %u\n", dev->tnode_width);
+	buf +=
+	    sprintf(buf, "mount_msecs........... %u\n",
+		    yaffs_dev_to_lc(dev)->mount_msecs);
 	buf += sprintf(buf, "\n");
 	buf += sprintf(buf, "n_tnodes.............. %d\n", dev->n_tnodes);
 	buf += sprintf(buf, "n_obj................. %d\n", dev->n_obj);
@@ -2486,6 +2527,19 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_tags_ecc_unfixed.... %u\n",
 		    dev->n_tags_ecc_unfixed);
 	buf += sprintf(buf, "cache_hits............ %u\n", dev->cache_hits);
+	buf +=
+	    sprintf(buf, "n_sum_blocks_scanned.. %u\n",
+		    dev->n_sum_blocks_scanned);
+	buf +=
+	    sprintf(buf, "n_sum_blocks_fallback. %u\n",
+		    dev->n_sum_blocks_fallback);
+	buf += sprintf(buf, "n_obj_lookups......... %u\n", dev->n_obj_lookups);
+	buf +=
+	    sprintf(buf, "n_obj_lookup_steps.... %u\n",
+		    dev->n_obj_lookup_steps);
+	buf += sprintf(buf, "n_extent_hits......... %u\n", dev->n_extent_hits);
+	buf +=
+	    sprintf(buf, "n_tnode_lookups....... %u\n", dev->n_tnode_lookups);
 	buf +=
 	    sprintf(buf, "n_deleted_files....... %u\n", dev->n_deleted_files);
 	buf +=
@@ -20,6 +20,7 @@
 #include "yaffs_getblockinfo.h"
 #include "yaffs_verify.h"
 #include "yaffs_attribs.h"
+#include "yaffs_summary.h"
 
 /*
  * Checkpoints are really no benefit on very small partitions.
@@ -250,6 +251,18 @@ int yaffs_calc_checkpt_blocks_required(struct yaffs_dev *dev)
 
 /*--------------------- Checkpointing --------------------*/
 
+/*
+ * Tnodes are checkpointed as raw memory, so a checkpoint must only be restored
+ * by a mount using the same tnode width. Only aligned tnodes change the width a
+ * device would otherwise get, so packed ones keep the plain version.
+ */
+static u32 yaffs2_checkpt_version(struct yaffs_dev *dev)
+{
+	if (dev->tnode_width != dev->tnode_width_packed)
+		return YAFFS_CHECKPOINT_VERSION | (dev->tnode_width << 16);
+	return YAFFS_CHECKPOINT_VERSION;
+}
+
 static int yaffs2_wr_checkpt_validity_marker(struct yaffs_dev *dev, int head)
 {
 	struct yaffs_checkpt_validity cp;
@@ -258,7 +271,7 @@ static int yaffs2_wr_checkpt_validity_marker(struct yaffs_dev *dev, int head)
 
 	cp.struct_type = sizeof(cp);
 	cp.magic = YAFFS_MAGIC;
-	cp.version = YAFFS_CHECKPOINT_VERSION;
+	cp.version = yaffs2_checkpt_version(dev);
 	cp.head = (head) ? 1 : 0;
 
 	return (yaffs2_checkpt_wr(dev, &cp, sizeof(cp)) == sizeof(cp)) ? 1 : 0;
@@ -274,7 +287,7 @@ static int yaffs2_rd_checkpt_validity_marker(struct yaffs_dev *dev, int head)
 	if (ok)
 		ok = (cp.struct_type == sizeof(cp)) &&
 		    (cp.magic == YAFFS_MAGIC) &&
-		    (cp.version == YAFFS_CHECKPOINT_VERSION) &&
+		    (cp.version == yaffs2_checkpt_version(dev)) &&
 		    (cp.head == ((head) ? 1 : 0));
 	return ok ? 1 : 0;
 }
@@ -981,6 +994,7 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 	int file_size;
 	int is_shrink;
 	int found_chunks;
+	int summary_available;
 	int equiv_id;
 	int alloc_failed = 0;
 
@@ -1020,6 +1034,7 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 		yaffs_clear_chunk_bits(dev, blk);
 		bi->pages_in_use = 0;
 		bi->soft_del_pages = 0;
+		bi->has_summary = 0;
 
 		yaffs_query_init_block_state(dev, blk, &state, &seq_number);
 
@@ -1102,9 +1117,25 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 		deleted = 0;
 
+		/* A valid summary saves reading the tags of every chunk */
+		summary_available = 0;
+		if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+		    yaffs_summary_read(dev, dev->sum_tags, blk) == YAFFS_OK) {
+			summary_available = 1;
+			dev->n_sum_blocks_scanned++;
+		} else if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+			   dev->sum_tags) {
+			dev->n_sum_blocks_fallback++;
+		}
+
 		/* For each chunk in each block that needs scanning.... */
 		found_chunks = 0;
-		for (c = dev->param.chunks_per_block - 1;
+		if (summary_available)
+			c = dev->chunks_per_summary - 1;
+		else
+			c = dev->param.chunks_per_block - 1;
+
+		for (/* c is already initialised */;
 		     !alloc_failed && c >= 0 &&
 		     (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING ||
 		      state == YAFFS_BLOCK_STATE_ALLOCATING); c--) {
@@ -1114,8 +1145,13 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 			chunk = blk * dev->param.chunks_per_block + c;
 
-			result = yaffs_rd_chunk_tags_nand(dev, chunk, NULL,
-							  &tags);
+			if (summary_available) {
+				yaffs_summary_fetch(dev, &tags, blk, c);
+				found_chunks = 1;
+			} else {
+				result = yaffs_rd_chunk_tags_nand(dev, chunk,
+								  NULL, &tags);
+			}
 
 			/* Let's have a good look at this chunk... */
 
@@ -1188,6 +1224,15 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 				dev->n_free_chunks++;
 
+			} else if (tags.obj_id == YAFFS_OBJECTID_SUMMARY) {
+				/* Summary written behind the data. Keep it
+				 * until the block is collected.
+				 */
+				found_chunks = 1;
+				yaffs_set_chunk_bit(dev, blk, c);
+				bi->pages_in_use++;
+				bi->has_summary = 1;
+
 			} else if (tags.chunk_id > 0) {
 				/* chunk_id > 0 so it is a data chunk... */
 				unsigned int endpos;
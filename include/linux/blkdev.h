@@ -30,6 +30,9 @@ struct request_pm_state;
 struct blk_trace;
 struct request;
 struct sg_io_hdr;
+struct blk_mq_ops;
+struct blk_mq_ctx;
+struct blk_mq_hw_ctx;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_MAX_RQ	128	/* Default maximum */
@@ -81,6 +84,9 @@ struct request {
 	struct call_single_data csd;
 
 	struct request_queue *q;
+#ifdef CONFIG_BLK_MQ
+	struct blk_mq_ctx *mq_ctx;
+#endif
 
 	unsigned int cmd_flags;
 	enum rq_cmd_type_bits cmd_type;
@@ -260,6 +266,17 @@ struct queue_limits {
 	unsigned char		discard_zeroes_data;
 };
 
+/*
+ * Hybrid polling counters, see block/blk-poll.c.  Kept per cpu and
+ * summed when read.
+ */
+struct blk_poll_stats {
+	unsigned long		polls;		/* waits that polled */
+	unsigned long		hits;		/* ... and saw the completion */
+	unsigned long		sleeps;		/* ... after a timed sleep */
+	u64			spin_ns;	/* time spent spinning */
+};
+
 struct request_queue
 {
 	/*
@@ -303,6 +320,17 @@ struct request_queue
 	 */
 	void			*queuedata;
 
+#ifdef CONFIG_BLK_MQ
+	/*
+	 * per-CPU software queues and hardware contexts, see blk-mq.c
+	 */
+	struct blk_mq_ops	*mq_ops;
+	struct blk_mq_ctx __percpu *queue_ctx;
+	struct blk_mq_hw_ctx	**queue_hw_ctx;
+	unsigned int		nr_hw_queues;
+	unsigned int		*mq_map;
+#endif
+
 	/*
 	 * queue needs bounce pages for pages above this limit
 	 */
@@ -349,6 +377,9 @@ struct request_queue
 	struct timer_list	timeout;
 	struct list_head	timeout_list;
 
+	atomic64_t		poll_mean_ns;	/* average completion latency */
+	struct blk_poll_stats __percpu *poll_stats;
+
 	struct queue_limits	limits;
 
 	/*
@@ -404,6 +435,7 @@ struct request_queue
 #define QUEUE_FLAG_ADD_RANDOM  16	/* Contributes to random pool */
 #define QUEUE_FLAG_SECDISCARD  17	/* supports SECDISCARD */
 #define QUEUE_FLAG_SAME_FORCE  18	/* force complete on same CPU */
+#define QUEUE_FLAG_POLL        19	/* poll for sync direct I/O completions */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_STACKABLE)	|	\
@@ -483,6 +515,7 @@ static inline void queue_flag_clear(unsigned int flag, struct request_queue *q)
 #define blk_queue_nonrot(q)	test_bit(QUEUE_FLAG_NONROT, &(q)->queue_flags)
 #define blk_queue_io_stat(q)	test_bit(QUEUE_FLAG_IO_STAT, &(q)->queue_flags)
 #define blk_queue_add_random(q)	test_bit(QUEUE_FLAG_ADD_RANDOM, &(q)->queue_flags)
+#define blk_queue_poll(q)	test_bit(QUEUE_FLAG_POLL, &(q)->queue_flags)
 #define blk_queue_stackable(q)	\
 	test_bit(QUEUE_FLAG_STACKABLE, &(q)->queue_flags)
 #define blk_queue_discard(q)	test_bit(QUEUE_FLAG_DISCARD, &(q)->queue_flags)
@@ -792,6 +825,9 @@ extern bool __blk_end_request_cur(struct request *rq, int error);
 extern bool __blk_end_request_err(struct request *rq, int error);
 
 extern void blk_complete_request(struct request *);
+extern void blk_poll_account(struct request_queue *q, u64 submit_ns);
+extern bool blk_poll_wait(struct request_queue *q, u64 submit_ns,
+			  bool (*done)(void *), void *data);
 extern void __blk_complete_request(struct request *);
 extern void blk_abort_request(struct request *);
 extern void blk_abort_queue(struct request_queue *);
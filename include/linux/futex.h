@@ -176,7 +176,10 @@ union futex_key {
 #ifdef CONFIG_FUTEX
 extern void exit_robust_list(struct task_struct *curr);
 extern void exit_pi_state_list(struct task_struct *curr);
+extern void futex_mm_hash_alloc(struct mm_struct *mm);
+extern void futex_mm_hash_free(struct mm_struct *mm);
 extern int futex_cmpxchg_enabled;
+extern int sysctl_futex_private_hash;
 #else
 static inline void exit_robust_list(struct task_struct *curr)
 {
@@ -184,6 +187,12 @@ static inline void exit_robust_list(struct task_struct *curr)
 static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
+static inline void futex_mm_hash_alloc(struct mm_struct *mm)
+{
+}
+static inline void futex_mm_hash_free(struct mm_struct *mm)
+{
+}
 #endif
 #endif /* __KERNEL__ */
 
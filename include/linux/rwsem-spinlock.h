@@ -27,6 +27,10 @@ struct rw_semaphore {
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map dep_map;
 #endif
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	/* the writer holding the lock, for optimistic spinning */
+	struct task_struct	*owner;
+#endif
 };
 
 #define RWSEM_UNLOCKED_VALUE		0x00000000
@@ -39,6 +39,7 @@
 #define SCHED_BATCH		3
 /* SCHED_ISO: reserved but not implemented yet */
 #define SCHED_IDLE		5
+#define SCHED_DEADLINE		6
 /* Can be ORed in to make sure the process is reverted back to SCHED_NORMAL on fork */
 #define SCHED_RESET_ON_FORK     0x40000000
 
@@ -94,6 +95,36 @@ struct sched_param {
 
 #include <asm/processor.h>
 
+/*
+ * Extended scheduling parameters, for sched_setattr(2) and
+ * sched_getattr(2).  SCHED_DEADLINE tasks are given sched_runtime ns
+ * of cpu time every sched_period ns, to be used within sched_deadline
+ * ns of the start of each period.  A zero sched_period means it
+ * equals sched_deadline.
+ */
+struct sched_attr {
+	u32 size;
+
+	u32 sched_policy;
+	u64 sched_flags;
+
+	/* SCHED_NORMAL, SCHED_BATCH */
+	s32 sched_nice;
+
+	/* SCHED_FIFO, SCHED_RR */
+	u32 sched_priority;
+
+	/* SCHED_DEADLINE */
+	u64 sched_runtime;
+	u64 sched_deadline;
+	u64 sched_period;
+};
+
+#define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
+
+/* sched_attr::sched_flags */
+#define SCHED_FLAG_RESET_ON_FORK	0x01
+
 struct exec_domain;
 struct futex_pi_state;
 struct robust_list_head;
@@ -142,6 +173,8 @@ extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
+extern unsigned long sched_cpu_load_avg(int cpu);
+extern unsigned long sched_cpu_runnable_avg(int cpu);
 
 
 extern void calc_global_load(unsigned long ticks);
@@ -279,6 +312,10 @@ extern int get_nohz_timer_target(void);
 static inline void select_nohz_load_balancer(int stop_tick) { }
 #endif
 
+#ifdef CONFIG_NO_HZ_FULL
+extern bool sched_can_stop_tick(void);
+#endif
+
 /*
  * Only dump TASK_* tasks. (0 for all tasks)
  */
@@ -361,6 +398,8 @@ extern signed long schedule_timeout_killable(signed long timeout);
 extern signed long schedule_timeout_uninterruptible(signed long timeout);
 asmlinkage void schedule(void);
 extern int mutex_spin_on_owner(struct mutex *lock, struct task_struct *owner);
+extern int rwsem_spin_on_owner(struct rw_semaphore *sem,
+			       struct task_struct *owner);
 
 struct nsproxy;
 struct user_namespace;
@@ -716,7 +755,7 @@ struct user_struct {
 	uid_t uid;
 	struct user_namespace *user_ns;
 
-#ifdef CONFIG_PERF_EVENTS
+#if defined(CONFIG_PERF_EVENTS) || defined(CONFIG_NET)
 	atomic_long_t locked_vm;
 #endif
 };
@@ -1037,6 +1076,13 @@ static inline int test_sd_parent(struct sched_domain *sd, int flag)
 unsigned long default_scale_freq_power(struct sched_domain *sd, int cpu);
 unsigned long default_scale_smt_power(struct sched_domain *sd, int cpu);
 
+/*
+ * Relative capacity of each cpu, SCHED_POWER_SCALE for the fastest ones.
+ * The arch calls sched_update_cpu_capacity() whenever its table changes.
+ */
+unsigned long arch_scale_cpu_capacity(int cpu);
+extern void sched_update_cpu_capacity(void);
+
 #else /* CONFIG_SMP */
 
 struct sched_domain_attr;
@@ -1046,6 +1092,10 @@ partition_sched_domains(int ndoms_new, cpumask_var_t doms_new[],
 			struct sched_domain_attr *dattr_new)
 {
 }
+
+static inline void sched_update_cpu_capacity(void)
+{
+}
 #endif	/* !CONFIG_SMP */
 
 
@@ -1080,6 +1130,7 @@ struct sched_domain;
 #else
 #define ENQUEUE_WAKING		0
 #endif
+#define ENQUEUE_REPLENISH	8	/* SCHED_DEADLINE runtime refill */
 
 #define DEQUEUE_SLEEP		1
 
@@ -1123,6 +1174,8 @@ struct sched_class {
 	unsigned int (*get_rr_interval) (struct rq *rq,
 					 struct task_struct *task);
 
+	void (*task_dead) (struct task_struct *p);
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	void (*task_move_group) (struct task_struct *p, int on_rq);
 #endif
@@ -1168,6 +1221,20 @@ struct sched_statistics {
 };
 #endif
 
+/*
+ * Geometrically decayed history of how runnable an entity has been: each
+ * ~1ms period counts y times as much as the one after it, y^32 = 1/2.
+ */
+struct sched_avg {
+	/*
+	 * These sums represent an infinite geometric series and so are bound
+	 * above by 1024/(1-y).  Thus we only need a u32 to store them.
+	 */
+	u32			runnable_avg_sum, runnable_avg_period;
+	u64			last_runnable_update;	/* 0: not yet on this cpu */
+	unsigned long		load_avg_contrib;	/* share of cfs_rq load */
+};
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
@@ -1181,6 +1248,8 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+	struct sched_avg	avg;
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1210,6 +1279,38 @@ struct sched_rt_entity {
 #endif
 };
 
+struct sched_dl_entity {
+	struct rb_node	rb_node;
+
+	/*
+	 * Parameters of the reservation, from sched_setattr(), in ns, and
+	 * dl_bw = dl_runtime / dl_period in 20 bit fixed point.
+	 */
+	u64 dl_runtime;
+	u64 dl_deadline;
+	u64 dl_period;
+	u64 dl_bw;
+
+	/*
+	 * State of the current instance: remaining runtime and absolute
+	 * deadline, on the rq->clock time base.
+	 */
+	s64 runtime;
+	u64 deadline;
+
+	/*
+	 * @dl_throttled: runtime exhausted, off the runqueue until
+	 * dl_timer replenishes it at the next period.
+	 * @dl_new: parameters just set, start a new instance when queued.
+	 */
+	int dl_throttled, dl_new;
+
+	struct hrtimer dl_timer;
+#ifdef CONFIG_SMP
+	struct rb_node	pushable_node;
+#endif
+};
+
 struct rcu_node;
 
 enum perf_event_task_context {
@@ -1237,6 +1338,7 @@ struct task_struct {
 	const struct sched_class *sched_class;
 	struct sched_entity se;
 	struct sched_rt_entity rt;
+	struct sched_dl_entity dl;
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
 #endif
@@ -1606,6 +1708,24 @@ struct task_struct {
 #define MAX_PRIO		(MAX_RT_PRIO + 40)
 #define DEFAULT_PRIO		(MAX_RT_PRIO + 20)
 
+/*
+ * SCHED_DEADLINE tasks all have priority MAX_DL_PRIO-1 and run ahead of
+ * every RT task; among themselves they are ordered by deadline.
+ */
+#define MAX_DL_PRIO		0
+
+static inline int dl_prio(int prio)
+{
+	if (unlikely(prio < MAX_DL_PRIO))
+		return 1;
+	return 0;
+}
+
+static inline int dl_task(struct task_struct *p)
+{
+	return dl_prio(p->prio);
+}
+
 static inline int rt_prio(int prio)
 {
 	if (unlikely(prio < MAX_RT_PRIO))
@@ -2024,6 +2144,11 @@ static inline unsigned int get_sysctl_timer_migration(void)
 extern unsigned int sysctl_sched_rt_period;
 extern int sysctl_sched_rt_runtime;
 
+#ifdef CONFIG_SMP
+extern unsigned int sysctl_sched_hmp_up_threshold;
+extern unsigned int sysctl_sched_hmp_down_threshold;
+#endif
+
 int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos);
@@ -2069,6 +2194,8 @@ extern int sched_setscheduler(struct task_struct *, int,
 			      const struct sched_param *);
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
 				      const struct sched_param *);
+extern int sched_setattr(struct task_struct *,
+			 const struct sched_attr *);
 extern struct task_struct *idle_task(int cpu);
 extern struct task_struct *curr_task(int cpu);
 extern void set_curr_task(int cpu, struct task_struct *p);
@@ -94,6 +94,7 @@
 struct net_device;
 struct scatterlist;
 struct pipe_inode_info;
+struct user_struct;
 
 #if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
 struct nf_conntrack {
@@ -187,6 +188,35 @@ enum {
 
 	/* ensure the originating sk reference is available on driver level */
 	SKBTX_DRV_NEEDS_SK_REF = 1 << 3,
+
+	/* frags point to user pages, destructor_arg is a struct ubuf_info */
+	SKBTX_DEV_ZEROCOPY = 1 << 4,
+};
+
+/*
+ * Pages pinned for a zerocopy send, charged to the user's locked_vm
+ * until the completion is reported.
+ */
+struct mmpin {
+	struct user_struct *user;
+	unsigned int num_pg;
+};
+
+/*
+ * The callback notifies userspace to release buffers when skb DMA is done
+ * in lower device: every skb whose frags point into the buffers holds a
+ * reference, and the callback runs when the last one is dropped.
+ * @zerocopy is false if the data had to be copied on the way.  A
+ * MSG_ZEROCOPY send lives in the cb of the skb that carries its
+ * completion to the socket error queue.
+ */
+struct ubuf_info {
+	void (*callback)(struct ubuf_info *, bool zerocopy);
+	u32 id;
+	u16 len;
+	u16 zerocopy:1;
+	atomic_t refcnt;
+	struct mmpin mmp;
 };
 
 /* This data is invariant across clones and lives at
@@ -1895,6 +1925,69 @@ extern int	       skb_shift(struct sk_buff *tgt, struct sk_buff *skb,
 
 extern struct sk_buff *skb_segment(struct sk_buff *skb, u32 features);
 
+extern struct ubuf_info *sock_zerocopy_alloc(struct sock *sk);
+extern void sock_zerocopy_callback(struct ubuf_info *uarg, bool zerocopy);
+extern void sock_zerocopy_put_abort(struct ubuf_info *uarg);
+extern int skb_zerocopy_from_user(struct sock *sk, struct sk_buff *skb,
+				  const void __user *from, int len,
+				  struct ubuf_info *uarg);
+extern int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask);
+
+static inline struct ubuf_info *skb_zcopy(struct sk_buff *skb)
+{
+	bool is_zcopy = skb && skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY;
+
+	return is_zcopy ? skb_shinfo(skb)->destructor_arg : NULL;
+}
+
+static inline void sock_zerocopy_get(struct ubuf_info *uarg)
+{
+	atomic_inc(&uarg->refcnt);
+}
+
+static inline void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg && atomic_dec_and_test(&uarg->refcnt))
+		uarg->callback(uarg, uarg->zerocopy);
+}
+
+/* An skb's frags can only point into the buffers of one @uarg */
+static inline void skb_zcopy_set(struct sk_buff *skb, struct ubuf_info *uarg)
+{
+	if (uarg && !skb_zcopy(skb)) {
+		sock_zerocopy_get(uarg);
+		skb_shinfo(skb)->destructor_arg = uarg;
+		skb_shinfo(skb)->tx_flags |= SKBTX_DEV_ZEROCOPY;
+	}
+}
+
+static inline void skb_zcopy_clear(struct sk_buff *skb, bool zerocopy)
+{
+	struct ubuf_info *uarg = skb_zcopy(skb);
+
+	if (uarg) {
+		uarg->zerocopy = uarg->zerocopy && zerocopy;
+		skb_shinfo(skb)->tx_flags &= ~SKBTX_DEV_ZEROCOPY;
+		sock_zerocopy_put(uarg);
+	}
+}
+
+/**
+ *	skb_orphan_frags - make a copy of the user pages an skb points to
+ *	@skb: buffer to orphan the frags of
+ *	@gfp_mask: allocation priority
+ *
+ *	Must be called before an skb that may come from a zerocopy send is
+ *	queued where it can stay for an unbounded time, such as a receive
+ *	queue or a packet tap, so that the sender gets its completion.
+ */
+static inline int skb_orphan_frags(struct sk_buff *skb, gfp_t gfp_mask)
+{
+	if (likely(!skb_zcopy(skb)))
+		return 0;
+	return skb_copy_ubufs(skb, gfp_mask);
+}
+
 static inline void *skb_header_pointer(const struct sk_buff *skb, int offset,
 				       int len, void *buffer)
 {
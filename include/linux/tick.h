@@ -45,6 +45,11 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @full_jiffies:	jiffies up to which a tickless busy CPU was accounted
+ * @full_user:		Tick stopped while busy in user mode, for accounting
+ * @full_stops:		Number of times the tick was stopped while busy
+ * @full_residual:	Number of ticks taken with the busy tick stopped
+ * @full_restarts:	Number of times the stopped busy tick was restarted
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -67,6 +72,13 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+#ifdef CONFIG_NO_HZ_FULL
+	unsigned long			full_jiffies;
+	int				full_user;
+	unsigned long			full_stops;
+	unsigned long			full_residual;
+	unsigned long			full_restarts;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -139,4 +151,38 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+#ifdef CONFIG_NO_HZ_FULL
+extern bool tick_nohz_full_running;
+extern cpumask_var_t tick_nohz_full_mask;
+
+/* Does @cpu stop its tick while running a single task? */
+static inline bool tick_nohz_full_cpu(int cpu)
+{
+	if (!tick_nohz_full_running)
+		return false;
+	return cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+extern void __tick_nohz_full_check(void);
+extern void tick_nohz_full_account(void);
+extern void tick_nohz_full_kick_cpu(int cpu);
+extern void tick_nohz_full_kick_all(void);
+
+/*
+ * Called from irq_exit() on a busy CPU: stop the tick if the CPU may
+ * run without it, restart it if it was stopped and is needed again.
+ */
+static inline void tick_nohz_full_check(void)
+{
+	if (tick_nohz_full_cpu(smp_processor_id()))
+		__tick_nohz_full_check();
+}
+#else
+static inline bool tick_nohz_full_cpu(int cpu) { return false; }
+static inline void tick_nohz_full_check(void) { }
+static inline void tick_nohz_full_account(void) { }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_all(void) { }
+#endif /* !NO_HZ_FULL */
+
 #endif
@@ -177,6 +177,40 @@ TRACE_EVENT(sched_migrate_task,
 		  __entry->orig_cpu, __entry->dest_cpu)
 );
 
+/*
+ * Tracepoint for a task moved between cpus of different capacity,
+ * at wakeup or forced off a slow cpu while running:
+ */
+TRACE_EVENT(sched_hmp_migrate,
+
+	TP_PROTO(struct task_struct *p, int orig_cpu, int dest_cpu, int force),
+
+	TP_ARGS(p, orig_cpu, dest_cpu, force),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	unsigned int,	ratio		)
+		__field(	int,	orig_cpu		)
+		__field(	int,	dest_cpu		)
+		__field(	int,	force			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->ratio		= p->se.avg.runnable_avg_sum * 1024 /
+					  (p->se.avg.runnable_avg_period + 1);
+		__entry->orig_cpu	= orig_cpu;
+		__entry->dest_cpu	= dest_cpu;
+		__entry->force		= force;
+	),
+
+	TP_printk("comm=%s pid=%d ratio=%u orig_cpu=%d dest_cpu=%d force=%d",
+		  __entry->comm, __entry->pid, __entry->ratio,
+		  __entry->orig_cpu, __entry->dest_cpu, __entry->force)
+);
+
 DECLARE_EVENT_CLASS(sched_process_template,
 
 	TP_PROTO(struct task_struct *p),
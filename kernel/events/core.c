@@ -2421,6 +2421,15 @@ void perf_event_task_tick(void)
 	}
 }
 
+/*
+ * Contexts on the rotation list need the tick to multiplex their events
+ * or to adjust the sampling period of frequency based ones.
+ */
+bool perf_event_can_stop_tick(void)
+{
+	return list_empty(&__get_cpu_var(rotation_list));
+}
+
 static int event_enable_on_exec(struct perf_event *event,
 				struct perf_event_context *ctx)
 {
@@ -49,6 +49,7 @@
 #include <linux/fs.h>
 #include <linux/file.h>
 #include <linux/jhash.h>
+#include <linux/bootmem.h>
 #include <linux/init.h>
 #include <linux/futex.h>
 #include <linux/mount.h>
@@ -67,7 +68,14 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/*
+ * Give each process that goes multi-threaded its own hash table for
+ * private futexes, see futex_mm_hash_alloc().
+ */
+int sysctl_futex_private_hash __read_mostly = 1;
+
+/* Upper bound on the per-mm table, in buckets */
+#define FUTEX_PRIVATE_HASH_MAX	1024
 
 /*
  * Futex flags used to encode options to functions and preserve them across
@@ -148,17 +156,85 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The global table is sized at boot, 256 buckets per possible cpu, so
+ * that unrelated futexes rarely share a bucket lock.
+ */
+static struct futex_hash_bucket *futex_queues __read_mostly;
+static unsigned long futex_hashsize __read_mostly;
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
+ *
+ * Private futexes (FUTEX_PRIVATE_FLAG) hash into the table of their
+ * mm when it has one, so that the futexes of one process neither
+ * contend with nor lengthen the chains of any other.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct mm_struct *mm = key->private.mm;
+
+		if (mm->futex_hash)
+			return &mm->futex_hash[hash & mm->futex_hash_mask];
+	}
+
+	return &futex_queues[hash & (futex_hashsize - 1)];
+}
+
+static void futex_hash_init(struct futex_hash_bucket *hb, unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		plist_head_init(&hb[i].chain);
+		spin_lock_init(&hb[i].lock);
+	}
+}
+
+/**
+ * futex_mm_hash_alloc - give @mm its own table for private futexes
+ * @mm:		the mm of the current task, about to be shared
+ *
+ * Called by clone() with CLONE_VM.  The table can only be set up while
+ * current is the sole user of @mm: from then on the hash of a private
+ * futex of @mm never changes, and no waiter can be queued in the
+ * global table before.  If the allocation fails, or the mm is already
+ * shared, its private futexes simply stay in the global table.
+ */
+void futex_mm_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_hash_bucket *hb;
+	unsigned long size;
+
+	if (!sysctl_futex_private_hash || mm->futex_hash ||
+	    !current_is_single_threaded())
+		return;
+
+	size = roundup_pow_of_two(max(16U, 4 * num_possible_cpus()));
+	size = min_t(unsigned long, size, FUTEX_PRIVATE_HASH_MAX);
+
+	hb = kmalloc(size * sizeof(*hb), GFP_KERNEL | __GFP_NOWARN);
+	if (!hb)
+		return;
+
+	futex_hash_init(hb, size);
+	mm->futex_hash_mask = size - 1;
+	mm->futex_hash = hb;
+}
+
+/**
+ * futex_mm_hash_free - release the private futex table of @mm
+ * @mm:		the mm being freed
+ */
+void futex_mm_hash_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+	mm->futex_hash = NULL;
 }
 
 /*
@@ -2741,8 +2817,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2757,10 +2833,19 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0, 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+
+	futex_hash_init(futex_queues, futex_hashsize);
 
 	return 0;
 }
@@ -71,7 +71,13 @@
 #include <linux/uaccess.h>
 #include <linux/compiler.h>
 #include <linux/irqflags.h>
+#include <linux/hardirq.h>
 #include <linux/rcupdate.h>
+#include <linux/cpu.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/completion.h>
 
 #include <asm/system.h>
 
@@ -134,6 +140,8 @@ static u8 rcu_which ____cacheline_aligned_in_smp;
 struct rcu_data {
        u8 wait;                /* goes false when this cpu consents to
                                 * the retirement of the current batch */
+       u8 exp_wait;            /* goes false when this cpu passes through
+                                * a quiescent state for an expedited sync */
        struct rcu_list cblist[2]; /* current & previous callback lists */
        s64 nqueued;            /* #callbacks queued (stats-n-debug) */
 } ____cacheline_aligned_in_smp;
@@ -150,6 +158,14 @@ static struct rcu_stats {
        atomic_t nsyncs;        /* #rcu syncs processed */
        s64 ninvoked;           /* #invoked (ie, finished) callbacks */
        unsigned nforced;       /* #forced eobs (should be zero) */
+       unsigned ncontinued;    /* #invocations cut short by rcu_batch_limit */
+       u64 batch_ns;           /* total time between end-of-batches */
+       u64 batch_max_ns;       /* longest time between end-of-batches */
+       atomic64_t sync_ns;     /* total time spent in synchronize_sched */
+       u64 sync_max_ns;        /* longest synchronize_sched (racy) */
+       unsigned nexpedited;    /* #expedited syncs */
+       u64 exp_ns;             /* total time spent in expedited syncs */
+       u64 exp_max_ns;         /* longest expedited sync */
 } rcu_stats;
 
 #define RCU_HZ                 (20)
@@ -167,6 +183,29 @@ int rcu_nmi_seen __read_mostly;
 static int rcu_wdog_ctr;       /* time since last end-of-batch, in usecs */
 static int rcu_wdog_lim = 10 * USEC_PER_SEC;   /* rcu watchdog interval */
 
+/*
+ * Callbacks of ended batches, oldest first, and the most of them that a
+ * single pass invokes.  What is left over is invoked by the next pass,
+ * which the driver runs right away rather than a period later.
+ */
+static struct rcu_list rcu_pending;
+static int rcu_batch_limit = 1000;
+
+/*
+ * Bit 0 is set while a pass runs.  Passes normally come from a single
+ * context, but the timer and the daemon may overlap while handing over
+ * to each other; a later callback must never run before an earlier one
+ * has finished, which rcu_barrier relies on.
+ */
+static unsigned long rcu_pass_busy;
+
+static ktime_t rcu_last_eob;   /* time of the last end-of-batch */
+
+/* Expedited grace periods */
+static DEFINE_MUTEX(rcu_exp_mutex);
+static atomic_t rcu_exp_count;         /* #cpus yet to pass a q.s. */
+static struct completion rcu_exp_done;
+
 /*
  * Return our CPU id or zero if we are too early in the boot process to
  * know what that is.  For RCU to work correctly, a cpu named '0' must
@@ -193,6 +232,17 @@ static inline int rcu_cpu(void)
 }
 #endif /* HAVE_THREAD_INFO_CPU */
 
+/*
+ * This CPU passed through a quiescent state while an expedited sync was
+ * waiting for it.  The xchg makes sure we are counted only once, even
+ * if the expedite IPI comes in while we are here.
+ */
+static void rcu_exp_report(struct rcu_data *rd)
+{
+       if (xchg(&rd->exp_wait, 0) && atomic_dec_and_test(&rcu_exp_count))
+               complete(&rcu_exp_done);
+}
+
 /*
  * Invoke whenever the calling CPU consents to end-of-batch.  All CPUs
  * must so consent before the batch is truly ended.
@@ -206,6 +256,8 @@ static inline void rcu_eob(int cpu)
                smp_mb();
 #endif
        }
+       if (unlikely(rd->exp_wait))
+               rcu_exp_report(rd);
 }
 
 void jrcu_read_unlock(void)
@@ -235,18 +287,94 @@ EXPORT_SYMBOL(rcu_note_might_resched);
 void synchronize_sched(void)
 {
        struct rcu_synchronize rcu;
+       ktime_t start;
+       u64 ns;
 
        if (!rcu_scheduler_active)
                return;
 
+       start = ktime_get();
        init_completion(&rcu.completion);
        call_rcu(&rcu.head, wakeme_after_rcu);
        wait_for_completion(&rcu.completion);
        atomic_inc(&rcu_stats.nsyncs);
 
+       ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+       atomic64_add(ns, &rcu_stats.sync_ns);
+       if (ns > rcu_stats.sync_max_ns)
+               rcu_stats.sync_max_ns = ns;
 }
 EXPORT_SYMBOL_GPL(synchronize_sched);
 
+/*
+ * Runs on every other online CPU on behalf of synchronize_sched_expedited.
+ * If the interrupted context was not inside a read-side critical section
+ * (the idle loop runs with a preempt count of one), that is our quiescent
+ * state.  Otherwise ask for a reschedule; the end of the critical section
+ * or the context switch then reports it through rcu_eob.
+ */
+static void rcu_exp_ipi(void *unused)
+{
+       int cpu = smp_processor_id();
+
+       if (preempt_count() - HARDIRQ_OFFSET <= idle_cpu(cpu))
+               rcu_eob(cpu);
+       else
+               set_need_resched();
+}
+
+/*
+ * Wait for all read-side critical sections in progress to finish, without
+ * waiting for batch boundaries.  Every other online CPU is IPIed and
+ * reports back as soon as it is outside of a critical section, so this
+ * normally takes microseconds instead of one or two RCU_HZ periods.
+ * Callbacks are not affected, they still wait for the end of their batch.
+ */
+void synchronize_sched_expedited(void)
+{
+       struct rcu_data *rd;
+       ktime_t start;
+       int cpu, this_cpu;
+       u64 ns;
+
+       if (!rcu_scheduler_active)
+               return;
+
+       might_sleep();
+       mutex_lock(&rcu_exp_mutex);
+       get_online_cpus();
+       start = ktime_get();
+
+       /* The caller may sleep, so this CPU has no readers left. */
+       this_cpu = get_cpu();
+       init_completion(&rcu_exp_done);
+       atomic_set(&rcu_exp_count, 1);
+       for_each_online_cpu(cpu) {
+               if (cpu == this_cpu)
+                       continue;
+               rd = &rcu_data[cpu];
+               atomic_inc(&rcu_exp_count);
+               rd->exp_wait = 1;
+       }
+       smp_mb(); /* exp_wait must be seen before anything the caller did next */
+       smp_call_function(rcu_exp_ipi, NULL, 1);
+       put_cpu();
+
+       if (!atomic_dec_and_test(&rcu_exp_count))
+               wait_for_completion(&rcu_exp_done);
+       smp_mb(); /* caller's later accesses come after all the q.s. */
+
+       ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+       rcu_stats.nexpedited++;
+       rcu_stats.exp_ns += ns;
+       if (ns > rcu_stats.exp_max_ns)
+               rcu_stats.exp_max_ns = ns;
+
+       put_online_cpus();
+       mutex_unlock(&rcu_exp_mutex);
+}
+EXPORT_SYMBOL_GPL(synchronize_sched_expedited);
+
 void rcu_barrier(void)
 {
        synchronize_sched();
@@ -292,13 +420,16 @@ void call_rcu_sched(struct rcu_head *cb, void (*func)(struct rcu_head *rcu))
 EXPORT_SYMBOL_GPL(call_rcu_sched);
 
 /*
- * Invoke all callbacks on the passed-in list.
+ * Invoke up to rcu_batch_limit callbacks from the pending list, oldest
+ * first.  Returns true if callbacks are left for another pass.  Must be
+ * called with rcu_pass_busy held.
  */
-static void rcu_invoke_callbacks(struct rcu_list *pending)
+static bool __rcu_invoke_callbacks(void)
 {
        struct rcu_head *curr, *next;
+       int count = 0;
 
-       for (curr = pending->head; curr;) {
+       for (curr = rcu_pending.head; curr && count < rcu_batch_limit;) {
                unsigned long offset = (unsigned long)curr->func;
                next = curr->next;
                if (__is_kfree_rcu_offset(offset))
@@ -306,8 +437,33 @@ static void rcu_invoke_callbacks(struct rcu_list *pending)
                else
                        curr->func(curr);
                curr = next;
-               rcu_stats.ninvoked++;
+               count++;
        }
+       rcu_stats.ninvoked += count;
+
+       rcu_pending.head = curr;
+       rcu_pending.count -= count;
+       if (!curr)
+               rcu_list_init(&rcu_pending);
+       else
+               rcu_stats.ncontinued++;
+
+       return curr != NULL;
+}
+
+/*
+ * Continue invoking the callbacks left over by the previous pass.  If
+ * the other context is in a pass, it takes care of them.
+ */
+static bool rcu_invoke_callbacks(void)
+{
+       bool more;
+
+       if (test_and_set_bit_lock(0, &rcu_pass_busy))
+               return false;
+       more = __rcu_invoke_callbacks();
+       clear_bit_unlock(0, &rcu_pass_busy);
+       return more;
 }
 
 /*
@@ -418,11 +574,37 @@ static void __rcu_delimit_batches(struct rcu_list *pending)
        rcu_wdog_ctr = 0;
 }
 
-static void rcu_delimit_batches(void)
+/* Account the time since the previous end-of-batch */
+static void rcu_account_batch(void)
+{
+       ktime_t now = ktime_get();
+       u64 ns = ktime_to_ns(ktime_sub(now, rcu_last_eob));
+
+       if (rcu_last_eob.tv64) {
+               rcu_stats.batch_ns += ns;
+               if (ns > rcu_stats.batch_max_ns)
+                       rcu_stats.batch_max_ns = ns;
+       }
+       rcu_last_eob = now;
+}
+
+/*
+ * Do one pass: end the current batch if we can, then invoke a bounded
+ * number of callbacks.  Returns true if callbacks are left over, in which
+ * case the caller should invoke more of them soon with
+ * rcu_invoke_callbacks.
+ */
+static bool rcu_delimit_batches(void)
 {
        unsigned long flags;
        struct rcu_list pending;
+       unsigned nbatches;
+       bool more;
 
+       if (test_and_set_bit_lock(0, &rcu_pass_busy))
+               return false;
+
+       nbatches = rcu_stats.nbatches;
        rcu_list_init(&pending);
        rcu_stats.npasses++;
 
@@ -432,8 +614,14 @@ static void rcu_delimit_batches(void)
        smp_mb();
        raw_local_irq_restore(flags);
 
-       if (pending.head)
-               rcu_invoke_callbacks(&pending);
+       if (rcu_stats.nbatches != nbatches)
+               rcu_account_batch();
+
+       rcu_list_join(&rcu_pending, &pending);
+       more = rcu_pending.head && __rcu_invoke_callbacks();
+
+       clear_bit_unlock(0, &rcu_pass_busy);
+       return more;
 }
 
 /* ------------------ interrupt driver section ------------------ */
@@ -452,16 +640,30 @@ static void rcu_delimit_batches(void)
 #define rcu_hz_delta_ns                (rcu_hz_delta_us * NSEC_PER_USEC)
 
 static struct hrtimer rcu_timer;
+static int rcu_timer_pass;     /* the timer asked for a full pass */
 
+/*
+ * The timer raises the softirq once per period for a full pass.  The
+ * softirq re-raises itself while callbacks are left over, so those are
+ * invoked a chunk at a time without waiting for the next period.
+ */
 static void rcu_softirq_func(struct softirq_action *h)
 {
-       rcu_delimit_batches();
+       bool more;
+
+       if (xchg(&rcu_timer_pass, 0))
+               more = rcu_delimit_batches();
+       else
+               more = rcu_invoke_callbacks();
+       if (more)
+               raise_softirq(RCU_SOFTIRQ);
 }
 
 static enum hrtimer_restart rcu_timer_func(struct hrtimer *t)
 {
        ktime_t next;
 
+       rcu_timer_pass = 1;
        raise_softirq(RCU_SOFTIRQ);
 
        next = ktime_add_ns(ktime_get(), rcu_hz_period_ns);
@@ -498,7 +700,7 @@ void __init rcu_scheduler_starting(void)
 
 #ifndef CONFIG_JRCU_DAEMON
 
-void __init int rcu_start_callback_processing(void)
+static __init int rcu_start_callback_processing(void)
 {
        rcu_timer_start();
        rcu_scheduler_active = 1;
@@ -557,7 +759,11 @@ static int jrcud_func(void *arg)
                        usleep_range(rcu_hz_period_us,
                                rcu_hz_period_us + rcu_hz_delta_us);
                }
-               rcu_delimit_batches();
+               if (!rcu_delimit_batches())
+                       continue;
+               do {
+                       cond_resched();
+               } while (rcu_invoke_callbacks());
        }
 
        pr_info("JRCU: replaced callback daemon with a timer.\n");
@@ -596,10 +802,17 @@ subsys_initcall_sync(rcu_start_callback_processing);
 
 static int rcu_hz = RCU_HZ;
 
+/* Average of @total_ns over @n events, in usecs */
+static u64 rcu_avg_us(u64 total_ns, unsigned n)
+{
+       return n ? div_u64(div_u64(total_ns, n), NSEC_PER_USEC) : 0;
+}
+
 static int rcu_debugfs_show(struct seq_file *m, void *unused)
 {
        int cpu, q;
        s64 nqueued;
+       unsigned nsyncs;
 
        nqueued = 0;
        for_each_present_cpu(cpu)
@@ -609,6 +822,8 @@ static int rcu_debugfs_show(struct seq_file *m, void *unused)
                rcu_hz,
                rcu_hz_precise ? "precise" : "sloppy");
 
+       seq_printf(m, "%14d: callbacks invoked per pass, at most\n",
+               rcu_batch_limit);
        seq_printf(m, "%14u: watchdog (secs)\n", rcu_wdog_lim / (int)USEC_PER_SEC);
        seq_printf(m, "%14d: #secs left on watchdog\n",
                (rcu_wdog_lim - rcu_wdog_ctr) / (int)USEC_PER_SEC);
@@ -643,6 +858,26 @@ static int rcu_debugfs_show(struct seq_file *m, void *unused)
                rcu_stats.ninvoked);
        seq_printf(m, "%14d: #callbacks left to invoke\n",
                (int)(nqueued - rcu_stats.ninvoked));
+       seq_printf(m, "%14u: #passes with callbacks left over\n",
+               rcu_stats.ncontinued);
+
+       seq_printf(m, "\n");
+       nsyncs = atomic_read(&rcu_stats.nsyncs);
+       seq_printf(m, "%14llu: avg usecs between end-of-batches\n",
+               rcu_avg_us(rcu_stats.batch_ns,
+                       rcu_stats.nbatches > 1 ? rcu_stats.nbatches - 1 : 0));
+       seq_printf(m, "%14llu: max usecs between end-of-batches\n",
+               div_u64(rcu_stats.batch_max_ns, NSEC_PER_USEC));
+       seq_printf(m, "%14llu: avg usecs per sync\n",
+               rcu_avg_us(atomic64_read(&rcu_stats.sync_ns), nsyncs));
+       seq_printf(m, "%14llu: max usecs per sync\n",
+               div_u64(rcu_stats.sync_max_ns, NSEC_PER_USEC));
+       seq_printf(m, "%14u: #expedited syncs\n",
+               rcu_stats.nexpedited);
+       seq_printf(m, "%14llu: avg usecs per expedited sync\n",
+               rcu_avg_us(rcu_stats.exp_ns, rcu_stats.nexpedited));
+       seq_printf(m, "%14llu: max usecs per expedited sync\n",
+               div_u64(rcu_stats.exp_max_ns, NSEC_PER_USEC));
        seq_printf(m, "\n");
 
        for_each_online_cpu(cpu)
@@ -721,6 +956,12 @@ next:
                rcu_hz_period_us = USEC_PER_SEC / rcu_hz;
        } else if (!strncmp(token, "precise=", 8)) {
                sscanf(&token[8], "%d", &rcu_hz_precise);
+       } else if (!strncmp(token, "limit=", 6)) {
+               int limit = -1;
+               sscanf(&token[6], "%d", &limit);
+               if (limit < 1)
+                       return -EINVAL;
+               rcu_batch_limit = limit;
        } else if (!strncmp(token, "wdog=", 5)) {
                int wdog = -1;
                sscanf(&token[5], "%d", &wdog);
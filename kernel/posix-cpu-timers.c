@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <trace/events/timer.h>
 
 /*
@@ -599,6 +600,8 @@ static void arm_timer(struct k_itimer *timer)
 				cputime_expires->sched_exp = exp->sched;
 			break;
 		}
+		/* Full dynticks CPUs running the task need their tick back */
+		tick_nohz_full_kick_all();
 	}
 }
 
@@ -1302,6 +1305,26 @@ static inline int fastpath_timer_check(struct task_struct *tsk)
 	return 0;
 }
 
+/**
+ * posix_cpu_timers_can_stop_tick - may a full dynticks CPU run @tsk tickless?
+ *
+ * @tsk:	The task running on the CPU.
+ *
+ * The CPU time of tasks and thread groups is sampled from the tick, so
+ * armed timers of the task or its thread group need it.
+ */
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return false;
+
+	/* Checked without the lock, a new timer kicks the CPU anyway */
+	if (tsk->signal->cputimer.running)
+		return false;
+
+	return true;
+}
+
 /*
  * This is called from the timer interrupt handler.  The irq handler has
  * already updated our counts.  We need to check if any timers fire now.
@@ -1417,6 +1440,8 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 		break;
 	}
+
+	tick_nohz_full_kick_all();
 }
 
 static int do_cpu_nanosleep(const clockid_t which_clock, int flags,
@@ -50,6 +50,7 @@
 #include <linux/wait.h>
 #include <linux/kthread.h>
 #include <linux/prefetch.h>
+#include <linux/tick.h>
 
 #include "rcutree.h"
 
@@ -283,8 +284,9 @@ cpu_has_callbacks_ready_to_invoke(struct rcu_data *rdp)
 static int
 cpu_needs_another_gp(struct rcu_state *rsp, struct rcu_data *rdp)
 {
-	return *rdp->nxttail[RCU_DONE_TAIL +
-			     ACCESS_ONCE(rsp->completed) != rdp->completed] &&
+	return (*rdp->nxttail[RCU_DONE_TAIL +
+			      ACCESS_ONCE(rsp->completed) != rdp->completed] ||
+		rcu_nocb_needs_gp(rsp)) &&
 	       !rcu_gp_in_progress(rsp);
 }
 
@@ -320,8 +322,12 @@ static int rcu_implicit_offline_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
-	/* If preemptible RCU, no point in sending reschedule IPI. */
-	if (rdp->preemptible)
+	/*
+	 * If preemptible RCU, no point in sending reschedule IPI, unless
+	 * the CPU runs with its tick stopped: the IPI restarts the tick,
+	 * which then notes the quiescent state.
+	 */
+	if (rdp->preemptible && !tick_nohz_full_cpu(rdp->cpu))
 		return 0;
 
 	/* The CPU is online, so send it a reschedule IPI. */
@@ -937,6 +943,7 @@ static void rcu_report_qs_rsp(struct rcu_state *rsp, unsigned long flags)
 		rsp->gp_max = gp_duration;
 	rsp->completed = rsp->gpnum;
 	rsp->signaled = RCU_GP_IDLE;
+	rcu_nocb_gp_cleanup(rsp);
 	rcu_start_gp(rsp, flags);  /* releases root node's rnp->lock. */
 }
 
@@ -1454,6 +1461,7 @@ __rcu_process_callbacks(struct rcu_state *rsp, struct rcu_data *rdp)
 	 * period that some other CPU ended.
 	 */
 	rcu_process_gp_end(rsp, rdp);
+	rcu_nocb_gp_wake(rsp);
 
 	/* Update RCU state based on any recent quiescent states. */
 	rcu_check_quiescent_state(rsp, rdp);
@@ -1527,6 +1535,12 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	/* No-CBs CPUs hand their callbacks to a kthread instead. */
+	if (__call_rcu_nocb(rdp, head)) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	/* Add the callback to our list. */
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
@@ -1703,7 +1717,8 @@ static int __rcu_pending(struct rcu_state *rsp, struct rcu_data *rdp)
 	}
 
 	/* Has another RCU grace period completed?  */
-	if (ACCESS_ONCE(rnp->completed) != rdp->completed) { /* outside lock */
+	if (ACCESS_ONCE(rnp->completed) != rdp->completed || /* outside lock */
+	    rcu_nocb_gp_wake_pending(rsp)) {
 		rdp->n_rp_gp_completed++;
 		return 1;
 	}
@@ -1748,9 +1763,39 @@ static int rcu_needs_cpu_quick_check(int cpu)
 	/* RCU callbacks either ready or pending? */
 	return per_cpu(rcu_sched_data, cpu).nxtlist ||
 	       per_cpu(rcu_bh_data, cpu).nxtlist ||
-	       rcu_preempt_needs_cpu(cpu);
+	       rcu_preempt_needs_cpu(cpu) ||
+	       rcu_nocb_needs_cpu();
+}
+
+#ifdef CONFIG_NO_HZ_FULL
+
+/*
+ * A CPU running a task notes its quiescent states from the tick, so
+ * RCU needs the tick while the current grace period waits on the CPU,
+ * including a grace period the CPU did not notice yet.
+ */
+static int __rcu_needs_tick(struct rcu_data *rdp)
+{
+	return rdp->qs_pending ||
+	       ACCESS_ONCE(rdp->mynode->gpnum) != rdp->gpnum;
 }
 
+/*
+ * Does RCU need the tick of the specified busy full dynticks CPU?
+ * Without it, the CPU neither reports quiescent states nor processes
+ * its callbacks.  This function is part of the RCU implementation; it
+ * is -not- an exported member of the RCU API.
+ */
+int rcu_needs_tick(int cpu)
+{
+	return rcu_needs_cpu_quick_check(cpu) ||
+	       __rcu_needs_tick(&per_cpu(rcu_sched_data, cpu)) ||
+	       __rcu_needs_tick(&per_cpu(rcu_bh_data, cpu)) ||
+	       rcu_preempt_needs_tick(cpu);
+}
+
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
 static atomic_t rcu_barrier_cpu_count;
 static DEFINE_MUTEX(rcu_barrier_mutex);
@@ -1798,10 +1843,15 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	 * did their increment, causing this function to return too
 	 * early.  Note that on_each_cpu() disables irqs, which prevents
 	 * any CPUs from coming online or going offline until each online
-	 * CPU has queued its RCU-barrier callback.
+	 * CPU has queued its RCU-barrier callback.  Offline no-CBs CPUs
+	 * may still have callbacks in their kthreads, so CPU hotplug is
+	 * held off until those have been given one as well.
 	 */
 	atomic_set(&rcu_barrier_cpu_count, 1);
+	get_online_cpus();
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_nocb_barrier_offline(rsp);
+	put_online_cpus();
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
 	wait_for_completion(&rcu_barrier_completion);
@@ -1848,6 +1898,8 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -2058,6 +2110,7 @@ static void __init rcu_init_one(struct rcu_state *rsp,
 	}
 
 	rsp->rda = rda;
+	rcu_init_nocb_rsp(rsp);
 	rnp = rsp->level[NUM_RCU_LVLS - 1];
 	for_each_possible_cpu(i) {
 		while (i > rnp->grphi)
@@ -2072,6 +2125,7 @@ void __init rcu_init(void)
 	int cpu;
 
 	rcu_bootup_announce();
+	rcu_init_nocb();
 	rcu_init_one(&rcu_sched_state, &rcu_sched_data);
 	rcu_init_one(&rcu_bh_state, &rcu_bh_data);
 	__rcu_init_preempt();
@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS and CONFIG_RCU_FANOUT.
@@ -298,7 +299,18 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading. */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread */
+	long nocb_p_count;		/* # CBs being invoked by kthread */
+	wait_queue_head_t nocb_wq;	/* For nocb kthreads to sleep on. */
+	struct task_struct *nocb_kthread;
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
+	struct rcu_state *rsp;		/* Flavor this rcu_data belongs to. */
 };
 
 /* Values for signaled field in struct rcu_state. */
@@ -393,6 +405,14 @@ struct rcu_state {
 						/*  for CPU stalls. */
 	unsigned long gp_max;			/* Maximum GP duration in */
 						/*  jiffies. */
+#ifdef CONFIG_RCU_NOCB_CPU
+	unsigned long nocb_gp_request;		/* GP number no-CBs kthreads */
+						/*  wait for, guarded by the */
+						/*  root rcu_node's lock. */
+	int nocb_gp_wake;			/* GP ended, wake nocb_gp_wq. */
+	wait_queue_head_t nocb_gp_wq;		/* No-CBs kthreads waiting */
+						/*  for a grace period. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 	char *name;				/* Name of structure. */
 };
 
@@ -447,6 +467,9 @@ static void rcu_report_exp_rnp(struct rcu_state *rsp, struct rcu_node *rnp);
 #endif /* #if defined(CONFIG_HOTPLUG_CPU) || defined(CONFIG_TREE_PREEMPT_RCU) */
 static int rcu_preempt_pending(int cpu);
 static int rcu_preempt_needs_cpu(int cpu);
+#ifdef CONFIG_NO_HZ_FULL
+static int rcu_preempt_needs_tick(int cpu);
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
 static void __cpuinit rcu_preempt_init_percpu_data(int cpu);
 static void rcu_preempt_send_cbs_to_online(void);
 static void __init __rcu_init_preempt(void);
@@ -466,5 +489,15 @@ static void rcu_yield(void (*f)(unsigned long), unsigned long arg);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 static void rcu_cpu_kthread_setrt(int cpu, int to_rt);
 static void __cpuinit rcu_prepare_kthreads(int cpu);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp);
+static bool rcu_nocb_needs_gp(struct rcu_state *rsp);
+static bool rcu_nocb_gp_wake_pending(struct rcu_state *rsp);
+static void rcu_nocb_gp_cleanup(struct rcu_state *rsp);
+static void rcu_nocb_gp_wake(struct rcu_state *rsp);
+static int rcu_nocb_needs_cpu(void);
+static void rcu_nocb_barrier_offline(struct rcu_state *rsp);
+static void __init rcu_init_nocb_rsp(struct rcu_state *rsp);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
+static void __init rcu_init_nocb(void);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
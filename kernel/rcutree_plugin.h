@@ -848,6 +848,18 @@ static int rcu_preempt_needs_cpu(int cpu)
 	return !!per_cpu(rcu_preempt_data, cpu).nxtlist;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+
+/*
+ * Does preemptible RCU need the tick of a busy full dynticks CPU?
+ */
+static int rcu_preempt_needs_tick(int cpu)
+{
+	return __rcu_needs_tick(&per_cpu(rcu_preempt_data, cpu));
+}
+
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
 /**
  * rcu_barrier - Wait until all in-flight call_rcu() callbacks complete.
  */
@@ -1071,6 +1083,18 @@ static int rcu_preempt_needs_cpu(int cpu)
 	return 0;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+
+/*
+ * Because preemptible RCU does not exist, it never needs the tick.
+ */
+static int rcu_preempt_needs_tick(int cpu)
+{
+	return 0;
+}
+
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
 /*
  * Because preemptible RCU does not exist, rcu_barrier() is just
  * another name for rcu_barrier_sched().
@@ -1985,6 +2009,9 @@ int rcu_needs_cpu(int cpu)
 		c = c || per_cpu(rcu_bh_data, cpu).nxtlist;
 	}
 
+	/* So do grace periods that no-CBs kthreads wait for. */
+	c = c || rcu_nocb_needs_cpu();
+
 	/* If RCU callbacks are still pending, RCU still needs this CPU. */
 	if (c)
 		invoke_rcu_core();
@@ -2008,3 +2035,373 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the CPUs given by the rcu_nocbs=
+ * boot parameter ("no-CBs CPUs").  call_rcu() on such a CPU just
+ * appends the callback to a lockless per-CPU list, and a per-CPU,
+ * per-flavor "rcuo" kthread waits for a grace period and invokes the
+ * callbacks.  The kthreads are not bound to any CPU, so they can be
+ * moved away and niced like any other task, leaving the no-CBs CPUs
+ * with no RCU_SOFTIRQ callback batches.  Grace-period detection still
+ * needs the quiescent states of all CPUs, no-CBs ones included.
+ */
+
+static cpumask_var_t rcu_nocb_mask;	/* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;		/* Was rcu_nocb_mask allocated? */
+static int rcu_nocb_poll;		/* Offload kthreads are to poll. */
+
+/* The flavors of RCU, each has its own set of kthreads. */
+static struct rcu_state *const rcu_nocb_flavors[] = {
+	&rcu_sched_state,
+	&rcu_bh_state,
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	&rcu_preempt_state,
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+};
+
+/* Parse the boot-time rcu_nocbs= CPU list from the kernel parameters. */
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static int __init parse_rcu_nocb_poll(char *arg)
+{
+	rcu_nocb_poll = 1;
+	return 0;
+}
+early_param("rcu_nocb_poll", parse_rcu_nocb_poll);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Enqueue the specified callback onto the specified no-CBs CPU's list
+ * and wake its kthread if the list was empty.  Returns false if the
+ * CPU is not a no-CBs CPU, in which case the caller queues it the
+ * usual way.  Any number of CPUs may enqueue concurrently, the xchg()
+ * on ->nocb_tail orders them, and the kthread copes with a ->next
+ * pointer that has not been filled in yet.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp)
+{
+	struct rcu_head **old_rhpp;
+	struct task_struct *t;
+
+	if (!is_nocb_cpu(rdp->cpu))
+		return false;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	/* If we are not being polled and there is a kthread, awaken it. */
+	t = ACCESS_ONCE(rdp->nocb_kthread);
+	if (rcu_nocb_poll || !t)
+		return true;
+	if (old_rhpp == &rdp->nocb_head)
+		wake_up(&rdp->nocb_wq); /* ... only if queue was empty ... */
+	return true;
+}
+
+/*
+ * Does a no-CBs kthread wait for a grace period that has not been
+ * started yet?
+ */
+static bool rcu_nocb_needs_gp(struct rcu_state *rsp)
+{
+	return ULONG_CMP_LT(ACCESS_ONCE(rsp->completed),
+			    ACCESS_ONCE(rsp->nocb_gp_request));
+}
+
+/*
+ * A grace period ended.  The caller holds the root rcu_node's ->lock,
+ * possibly from within the scheduler, so just flag the end here and
+ * let the next RCU core invocation do the wakeup.
+ */
+static void rcu_nocb_gp_cleanup(struct rcu_state *rsp)
+{
+	if (have_rcu_nocb_mask)
+		rsp->nocb_gp_wake = 1;
+}
+
+static bool rcu_nocb_gp_wake_pending(struct rcu_state *rsp)
+{
+	return ACCESS_ONCE(rsp->nocb_gp_wake);
+}
+
+/* Wake up the kthreads waiting for the grace period that just ended. */
+static void rcu_nocb_gp_wake(struct rcu_state *rsp)
+{
+	if (ACCESS_ONCE(rsp->nocb_gp_wake) && xchg(&rsp->nocb_gp_wake, 0))
+		wake_up_all(&rsp->nocb_gp_wq);
+}
+
+/*
+ * Keep the tick while a no-CBs kthread waits for a grace period it
+ * requested, and until the kthreads have been woken up at its end.
+ * Such a grace period may have no CPU with callbacks behind it, and
+ * only the tick drives it to completion through force_quiescent_state().
+ */
+static int rcu_nocb_needs_cpu(void)
+{
+	struct rcu_state *rsp;
+	int i;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	for (i = 0; i < ARRAY_SIZE(rcu_nocb_flavors); i++) {
+		rsp = rcu_nocb_flavors[i];
+		if (rcu_nocb_needs_gp(rsp) || rcu_nocb_gp_wake_pending(rsp))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Queue rcu_barrier()'s callback on the offline no-CBs CPUs, whose
+ * kthreads may still be working on callbacks queued before the CPU
+ * went down.  The caller has excluded CPU hotplug.
+ */
+static void rcu_nocb_barrier_offline(struct rcu_state *rsp)
+{
+	struct rcu_head *head;
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (cpu_online(cpu))
+			continue;
+		head = &per_cpu(rcu_barrier_head, cpu);
+		debug_rcu_head_queue(head);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		__call_rcu_nocb(per_cpu_ptr(rsp->rda, cpu), head);
+	}
+}
+
+/*
+ * Wait for a full grace period to elapse, starting one if RCU is idle.
+ * Any grace period in progress started before our callbacks were
+ * picked up, so it is the one after it that we need.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_state *rsp = rdp->rsp;
+	struct rcu_node *rnp = rcu_get_root(rsp);
+	unsigned long flags;
+	unsigned long c;
+	bool d;
+
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	c = rsp->gpnum + 1;
+	if (ULONG_CMP_LT(rsp->nocb_gp_request, c))
+		rsp->nocb_gp_request = c;
+	rcu_start_gp(rsp, flags);  /* releases above lock */
+
+	/*
+	 * Wait for the grace period.  Do so interruptibly to avoid messing
+	 * up the load average.
+	 */
+	for (;;) {
+		wait_event_interruptible(rsp->nocb_gp_wq,
+			(d = ULONG_CMP_GE(ACCESS_ONCE(rsp->completed), c)));
+		if (likely(d))
+			break;
+		flush_signals(current);
+	}
+	smp_mb(); /* Ensure that CB invocation happens after GP end. */
+}
+
+/*
+ * Per-rcu_data kthread, but only for no-CBs CPUs.  Each kthread invokes
+ * callbacks queued by the corresponding no-CBs CPU.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	int c;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	struct rcu_data *rdp = arg;
+
+	/* Each pass through this loop invokes one batch of callbacks */
+	for (;;) {
+		/* If not polling, wait for next batch of callbacks. */
+		if (!rcu_nocb_poll)
+			wait_event_interruptible(rdp->nocb_wq,
+						 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list) {
+			schedule_timeout_interruptible(1);
+			flush_signals(current);
+			continue;
+		}
+
+		/*
+		 * Extract queued callbacks, update counts, and wait
+		 * for a grace period to elapse.
+		 */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+		rcu_nocb_wait_gp(rdp);
+
+		/* Each pass through the following loop invokes a callback. */
+		c = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for enqueuing to complete, if needed. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(list);
+			local_bh_enable();
+			c++;
+			list = next;
+		}
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		rdp->n_cbs_invoked += c;
+		cond_resched();
+	}
+	return 0;
+}
+
+/* Initialize the grace-period wait state of one flavor of RCU. */
+static void __init rcu_init_nocb_rsp(struct rcu_state *rsp)
+{
+	rsp->nocb_gp_request = rsp->completed;
+	init_waitqueue_head(&rsp->nocb_gp_wq);
+}
+
+/* Initialize per-rcu_data variables for no-CBs CPUs. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/* Check the boot-time no-CBs CPU list and announce it. */
+static void __init rcu_init_nocb(void)
+{
+	char nocb_buf[NR_CPUS * 5];
+
+#ifdef CONFIG_NO_HZ_FULL
+	/* Full dynticks CPUs offload their callbacks too. */
+	if (tick_nohz_full_running) {
+		if (!have_rcu_nocb_mask) {
+			zalloc_cpumask_var(&rcu_nocb_mask, GFP_KERNEL);
+			have_rcu_nocb_mask = true;
+		}
+		cpumask_or(rcu_nocb_mask, rcu_nocb_mask, tick_nohz_full_mask);
+	}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
+	if (!have_rcu_nocb_mask)
+		return;
+
+	/*
+	 * Only the boot CPU is up before the kthreads are spawned, and a
+	 * synchronize_rcu() there would wait forever for its kthread.
+	 */
+	if (cpumask_test_cpu(0, rcu_nocb_mask)) {
+		printk(KERN_INFO "\tCPU 0: illegal no-CBs CPU (cleared).\n");
+		cpumask_clear_cpu(0, rcu_nocb_mask);
+	}
+	cpulist_scnprintf(nocb_buf, sizeof(nocb_buf), rcu_nocb_mask);
+	printk(KERN_INFO "\tExperimental no-CBs CPUs: %s.\n", nocb_buf);
+	if (rcu_nocb_poll)
+		printk(KERN_INFO "\tExperimental polled no-CBs CPUs.\n");
+}
+
+/* Create a kthread for each RCU flavor for each no-CBs CPU. */
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	struct rcu_state *rsp;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+	int cpu;
+	int i;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	for (i = 0; i < ARRAY_SIZE(rcu_nocb_flavors); i++) {
+		rsp = rcu_nocb_flavors[i];
+		for_each_cpu(cpu, rcu_nocb_mask) {
+			rdp = per_cpu_ptr(rsp->rda, cpu);
+			/* rcuos, rcuob and rcuop, from "rcu_sched_state" &c */
+			t = kthread_run(rcu_nocb_kthread, rdp, "rcuo%c/%d",
+					rsp->name[4], cpu);
+			BUG_ON(IS_ERR(t));
+			ACCESS_ONCE(rdp->nocb_kthread) = t;
+		}
+	}
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp)
+{
+	return false;
+}
+
+static bool rcu_nocb_needs_gp(struct rcu_state *rsp)
+{
+	return false;
+}
+
+static void rcu_nocb_gp_cleanup(struct rcu_state *rsp)
+{
+}
+
+static bool rcu_nocb_gp_wake_pending(struct rcu_state *rsp)
+{
+	return false;
+}
+
+static void rcu_nocb_gp_wake(struct rcu_state *rsp)
+{
+}
+
+static int rcu_nocb_needs_cpu(void)
+{
+	return 0;
+}
+
+static void rcu_nocb_barrier_offline(struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_init_nocb_rsp(struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static void __init rcu_init_nocb(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
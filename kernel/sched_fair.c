@@ -864,6 +864,267 @@ static inline void update_entity_shares_tick(struct cfs_rq *cfs_rq)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+/*
+ * Per-entity load tracking.
+ *
+ * The time an entity is runnable is accounted in ~1ms (1024us) periods,
+ * and a period's contribution decays by y for every period after it,
+ * with y^32 = 1/2: what happened 32ms ago counts half as much as the
+ * present.  Each entity's share of its weight, load_avg_contrib, is
+ * summed into its cfs_rq's runnable_load_avg.  A group entity passes up
+ * the runnable load of the cfs_rq it owns, scaled to its own weight.
+ */
+#define LOAD_AVG_PERIOD	32
+#define LOAD_AVG_MAX	47742	/* maximum possible load avg */
+#define LOAD_AVG_MAX_N	345	/* periods needed to reach LOAD_AVG_MAX */
+
+/* Precomputed fixed inverse multiplies for multiplication by y^n */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b, 0xeac0c6e7, 0xe5b906e7,
+	0xe0ccdeec, 0xdbfbb797, 0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47, 0xb504f333, 0xb123f581,
+	0xad583eea, 0xa9a15ab4, 0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/*
+ * Precomputed \Sum 1024*y^k { 1<=k<=n }, rounded down at each step so
+ * that recombining them never over-estimates.
+ */
+static const u32 runnable_avg_yN_sum[] = {
+	    0,  1002,  1982,  2941,  3880,  4798,  5697,  6576,  7437,  8279,
+	 9103,  9909, 10698, 11470, 12226, 12966, 13690, 14398, 15091, 15769,
+	16433, 17082, 17718, 18340, 18949, 19545, 20128, 20698, 21256, 21802,
+	22336, 22859, 23371,
+};
+
+/*
+ * Approximate val * y^n, where y^32 ~= 0.5 (~1 scheduling period).
+ */
+static __always_inline u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	/* after bounds checking we can collapse to 32-bit */
+	local_n = n;
+
+	/*
+	 * As y^PERIOD = 1/2, we can combine
+	 *    y^n = 1/2^(n/PERIOD) * y^(n%PERIOD)
+	 * with a look-up table which covers y^n (n<PERIOD)
+	 */
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	return val >> 32;
+}
+
+/*
+ * For updates fully spanning n periods, the contribution to runnable
+ * average will be: \Sum 1024*y^n
+ */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	/* Compute \Sum k^n combining precomputed values for k^i, \Sum k^j */
+	do {
+		contrib /= 2; /* y^LOAD_AVG_PERIOD = 1/2 */
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Fold the time since the last update into @sa, as runnable or not.
+ * Returns 1 when a period boundary was crossed and the sums decayed.
+ */
+static __always_inline int __update_entity_runnable_avg(u64 now,
+							struct sched_avg *sa,
+							int runnable)
+{
+	u64 delta, periods;
+	u32 runnable_contrib;
+	int delta_w, decayed = 0;
+
+	delta = now - sa->last_runnable_update;
+	/* clocks can go backwards across a migration, just restart */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	/* use 1024ns as the unit of measurement since it's a reasonable
+	 * approximation of 1us and fast to compute */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update += delta << 10;
+
+	/* delta_w is the amount already accumulated against our next period */
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		/* complete the current period, then decay it along with the
+		 * whole history by the periods that follow */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_avg_sum += delta_w;
+		sa->runnable_avg_period += delta_w;
+
+		delta -= delta_w;
+
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		/* efficiently calculate \sum (1..n_period) 1024*y^i */
+		runnable_contrib = __compute_runnable_contrib(periods);
+		if (runnable)
+			sa->runnable_avg_sum += runnable_contrib;
+		sa->runnable_avg_period += runnable_contrib;
+	}
+
+	/* remainder of delta accrued against u_0` */
+	if (runnable)
+		sa->runnable_avg_sum += delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+/* Recompute @se's share of its cfs_rq's load, returns the change */
+static long __update_entity_load_avg_contrib(struct sched_entity *se)
+{
+	long old_contrib = se->avg.load_avg_contrib;
+	u64 contrib;
+
+	if (entity_is_task(se)) {
+		contrib = (u64)se->avg.runnable_avg_sum * se->load.weight;
+		contrib = div_u64(contrib, se->avg.runnable_avg_period + 1);
+	} else {
+		struct cfs_rq *cfs_rq = group_cfs_rq(se);
+
+		contrib = (u64)cfs_rq->runnable_load_avg * se->load.weight;
+		contrib = div_u64(contrib, cfs_rq->load.weight + 1);
+	}
+	se->avg.load_avg_contrib = contrib;
+
+	return se->avg.load_avg_contrib - old_contrib;
+}
+
+static void update_entity_load_avg(struct sched_entity *se)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+	long contrib_delta;
+
+	/* a group's contribution follows its children, not just time */
+	if (!__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task,
+					  &se->avg, se->on_rq) &&
+	    entity_is_task(se))
+		return;
+
+	contrib_delta = __update_entity_load_avg_contrib(se);
+	if (se->on_rq)
+		cfs_rq->runnable_load_avg += contrib_delta;
+}
+
+static void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+				    struct sched_entity *se)
+{
+	u64 now = rq_of(cfs_rq)->clock_task;
+
+	/* new, or just moved here from another cpu's clock */
+	if (!se->avg.last_runnable_update)
+		se->avg.last_runnable_update = now;
+
+	/* the time since the last update was spent off the runqueue */
+	__update_entity_runnable_avg(now, &se->avg, 0);
+	__update_entity_load_avg_contrib(se);
+	cfs_rq->runnable_load_avg += se->avg.load_avg_contrib;
+}
+
+static void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+				    struct sched_entity *se)
+{
+	update_entity_load_avg(se);
+	cfs_rq->runnable_load_avg -= se->avg.load_avg_contrib;
+}
+
+static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
+{
+	__update_entity_runnable_avg(rq->clock_task, &rq->avg, runnable);
+}
+
+/* The load a task adds to its cfs_rq, in weighted_cpuload() units */
+static inline unsigned long task_cpu_load(struct task_struct *p)
+{
+	if (sched_feat(LOAD_AVG))
+		return p->se.avg.load_avg_contrib;
+	return p->se.load.weight;
+}
+
+/**
+ * sched_cpu_load_avg - decayed runnable load of the fair tasks on a cpu
+ * @cpu: the cpu to look at
+ *
+ * One nice-0 task that is always runnable counts as SCHED_LOAD_SCALE.
+ * Unlike the instantaneous weight, this includes the recent history of
+ * tasks that were just woken on or moved to @cpu.
+ */
+unsigned long sched_cpu_load_avg(int cpu)
+{
+	return ACCESS_ONCE(cpu_rq(cpu)->cfs.runnable_load_avg);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_load_avg);
+
+/**
+ * sched_cpu_runnable_avg - how busy a cpu has recently been
+ * @cpu: the cpu to look at
+ *
+ * Returns the decayed fraction of time @cpu had fair tasks runnable,
+ * from 0 to SCHED_LOAD_SCALE.
+ */
+unsigned long sched_cpu_runnable_avg(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	u32 sum, period;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_rq_runnable_avg(rq, rq->cfs.nr_running);
+	sum = rq->avg.runnable_avg_sum;
+	period = rq->avg.runnable_avg_period;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return (unsigned long)sum * SCHED_LOAD_SCALE / (period + 1);
+}
+EXPORT_SYMBOL_GPL(sched_cpu_runnable_avg);
+
 static void enqueue_sleeper(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 #ifdef CONFIG_SCHEDSTATS
@@ -985,6 +1246,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	enqueue_entity_load_avg(cfs_rq, se);
 	update_cfs_load(cfs_rq, 0);
 	account_entity_enqueue(cfs_rq, se);
 	update_cfs_shares(cfs_rq);
@@ -1056,6 +1318,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	dequeue_entity_load_avg(cfs_rq, se);
 
 	update_stats_dequeue(cfs_rq, se);
 	if (flags & DEQUEUE_SLEEP) {
@@ -1217,6 +1480,7 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
+		update_entity_load_avg(prev);
 		update_stats_wait_start(cfs_rq, prev);
 		/* Put 'current' back into the tree. */
 		__enqueue_entity(cfs_rq, prev);
@@ -1231,6 +1495,7 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	update_entity_load_avg(curr);
 
 	/*
 	 * Update share accounting for long-running entities.
@@ -1329,6 +1594,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	update_rq_runnable_avg(rq, rq->cfs.nr_running);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -1340,6 +1607,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		struct cfs_rq *cfs_rq = cfs_rq_of(se);
 
+		update_entity_load_avg(se);
 		update_cfs_load(cfs_rq, 0);
 		update_cfs_shares(cfs_rq);
 	}
@@ -1360,6 +1628,8 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct sched_entity *se = &p->se;
 	int task_sleep = flags & DEQUEUE_SLEEP;
 
+	update_rq_runnable_avg(rq, 1);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -1380,6 +1650,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		struct cfs_rq *cfs_rq = cfs_rq_of(se);
 
+		update_entity_load_avg(se);
 		update_cfs_load(cfs_rq, 0);
 		update_cfs_shares(cfs_rq);
 	}
@@ -1408,6 +1679,14 @@ static void task_waking_fair(struct task_struct *p)
 #endif
 
 	se->vruntime -= min_vruntime;
+
+	/*
+	 * Decay the load average over the sleep on the clock of the cpu
+	 * it slept on, the task may be woken on another one.
+	 */
+	if (se->avg.last_runnable_update)
+		__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task,
+					     &se->avg, 0);
 }
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -1486,14 +1765,14 @@ static int wake_affine(struct sched_domain *sd, struct task_struct *p, int sync)
 	rcu_read_lock();
 	if (sync) {
 		tg = task_group(current);
-		weight = current->se.load.weight;
+		weight = task_cpu_load(current);
 
 		this_load += effective_load(tg, this_cpu, -weight, -weight);
 		load += effective_load(tg, prev_cpu, 0, -weight);
 	}
 
 	tg = task_group(p);
-	weight = p->se.load.weight;
+	weight = task_cpu_load(p);
 
 	/*
 	 * In low-load situations, where prev_cpu is idle and this_cpu is idle
@@ -1677,6 +1956,204 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+/*
+ * Heterogeneous multi-processing.
+ *
+ * When the arch reports cpus of unequal capacity, tasks are classified
+ * by their runnable average: those busy more than sched_hmp_up_threshold
+ * (out of SCHED_POWER_SCALE) of the time belong on the fastest cpus,
+ * those below sched_hmp_down_threshold on the slower ones, and the rest
+ * are left to the usual balancing.  Wakeup and fork place a task by its
+ * class, the load balancer does not pull a big task onto a slow cpu, and
+ * a big task running on a slow cpu is pushed to an idle fast one from
+ * the tick.
+ */
+unsigned int sysctl_sched_hmp_up_threshold = 700;
+unsigned int sysctl_sched_hmp_down_threshold = 256;
+
+static struct cpumask hmp_fast_cpus;
+static struct cpumask hmp_slow_cpus;
+static int hmp_active;
+static DEFINE_SPINLOCK(hmp_lock);
+
+unsigned long __weak arch_scale_cpu_capacity(int cpu)
+{
+	return SCHED_POWER_SCALE;
+}
+
+/*
+ * Sort the possible cpus into fast (the highest capacity) and slow.
+ * Readers are lockless and may briefly see a mix of old and new masks,
+ * which only costs one misplaced task.
+ */
+void sched_update_cpu_capacity(void)
+{
+	unsigned long capacity, max_capacity = 0;
+	unsigned long flags;
+	int cpu;
+
+	spin_lock_irqsave(&hmp_lock, flags);
+	for_each_possible_cpu(cpu)
+		max_capacity = max(max_capacity, arch_scale_cpu_capacity(cpu));
+
+	for_each_possible_cpu(cpu) {
+		capacity = arch_scale_cpu_capacity(cpu);
+		if (capacity == max_capacity) {
+			cpumask_set_cpu(cpu, &hmp_fast_cpus);
+			cpumask_clear_cpu(cpu, &hmp_slow_cpus);
+		} else {
+			cpumask_set_cpu(cpu, &hmp_slow_cpus);
+			cpumask_clear_cpu(cpu, &hmp_fast_cpus);
+		}
+	}
+	hmp_active = !cpumask_empty(&hmp_slow_cpus);
+	spin_unlock_irqrestore(&hmp_lock, flags);
+}
+
+static inline int hmp_enabled(void)
+{
+	return hmp_active && sched_feat(HMP);
+}
+
+/* Fraction of the recent past @p was runnable, out of SCHED_POWER_SCALE */
+static inline unsigned long task_runnable_ratio(struct task_struct *p)
+{
+	struct sched_avg *sa = &p->se.avg;
+
+	return sa->runnable_avg_sum * SCHED_POWER_SCALE /
+		(sa->runnable_avg_period + 1);
+}
+
+static inline int hmp_task_is_big(struct task_struct *p)
+{
+	return task_runnable_ratio(p) >= sysctl_sched_hmp_up_threshold;
+}
+
+/*
+ * Pick the cpu a waking or forking task belongs on by its class, or -1
+ * to leave the choice to the domain balancing in select_task_rq_fair.
+ * Among the allowed cpus of the class, prefer prev_cpu if it is idle,
+ * then any idle cpu, then the least loaded one.
+ */
+static int hmp_select_task_rq(struct task_struct *p, int prev_cpu)
+{
+	unsigned long load, min_load = ULONG_MAX;
+	const struct cpumask *class;
+	int cpu, best = -1;
+
+	if (!hmp_enabled())
+		return -1;
+
+	if (hmp_task_is_big(p))
+		class = &hmp_fast_cpus;
+	else if (task_runnable_ratio(p) < sysctl_sched_hmp_down_threshold)
+		class = &hmp_slow_cpus;
+	else
+		return -1;
+
+	if (cpumask_test_cpu(prev_cpu, class) && idle_cpu(prev_cpu))
+		return prev_cpu;
+
+	for_each_cpu_and(cpu, class, tsk_cpus_allowed(p)) {
+		if (!cpu_active(cpu))
+			continue;
+		if (idle_cpu(cpu)) {
+			best = cpu;
+			break;
+		}
+		load = weighted_cpuload(cpu);
+		if (load < min_load) {
+			min_load = load;
+			best = cpu;
+		}
+	}
+
+	if (best >= 0 && !cpumask_test_cpu(prev_cpu, class))
+		trace_sched_hmp_migrate(p, prev_cpu, best, 0);
+
+	return best;
+}
+
+/* Keep the load balancer from pulling a big task onto a slow cpu */
+static inline int hmp_can_migrate_task(struct task_struct *p, int src_cpu,
+				       int dst_cpu)
+{
+	if (!hmp_enabled())
+		return 1;
+
+	return !(cpumask_test_cpu(dst_cpu, &hmp_slow_cpus) &&
+		 cpumask_test_cpu(src_cpu, &hmp_fast_cpus) &&
+		 hmp_task_is_big(p));
+}
+
+static int __migrate_task(struct task_struct *p, int src_cpu, int dest_cpu);
+
+/*
+ * Stopper callback: move rq->migrate_task, which was running when the
+ * push was requested, to rq->push_cpu.
+ */
+static int hmp_force_up_cpu_stop(void *data)
+{
+	struct rq *rq = data;
+	struct task_struct *p = rq->migrate_task;
+	int cpu = cpu_of(rq), target = rq->push_cpu;
+
+	local_irq_disable();
+	if (likely(cpu == smp_processor_id()) &&
+	    __migrate_task(p, cpu, target) && task_cpu(p) == target)
+		trace_sched_hmp_migrate(p, cpu, target, 1);
+
+	raw_spin_lock(&rq->lock);
+	rq->migrate_task = NULL;
+	rq->active_balance = 0;
+	raw_spin_unlock_irq(&rq->lock);
+
+	put_task_struct(p);
+	return 0;
+}
+
+/*
+ * Called from the tick without rq->lock: push a big task that is
+ * running on a slow cpu to an idle fast cpu, rather than waiting for
+ * it to sleep and be placed at wakeup.
+ */
+static void hmp_force_up_migration(struct rq *rq)
+{
+	struct task_struct *p;
+	unsigned long flags;
+	int cpu = cpu_of(rq), target = -1, i;
+
+	if (!hmp_enabled() || !cpumask_test_cpu(cpu, &hmp_slow_cpus))
+		return;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	p = rq->curr;
+	if (p->sched_class != &fair_sched_class || rq->active_balance ||
+	    !hmp_task_is_big(p))
+		goto unlock;
+
+	for_each_cpu_and(i, &hmp_fast_cpus, tsk_cpus_allowed(p)) {
+		if (cpu_active(i) && idle_cpu(i)) {
+			target = i;
+			break;
+		}
+	}
+	if (target < 0)
+		goto unlock;
+
+	/* ->active_balance also guards ->active_balance_work here */
+	get_task_struct(p);
+	rq->active_balance = 1;
+	rq->push_cpu = target;
+	rq->migrate_task = p;
+unlock:
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	if (target >= 0)
+		stop_one_cpu_nowait(cpu, hmp_force_up_cpu_stop, rq,
+				    &rq->active_balance_work);
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1699,6 +2176,11 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	int want_sd = 1;
 	int sync = wake_flags & WF_SYNC;
 
+	new_cpu = hmp_select_task_rq(p, prev_cpu);
+	if (new_cpu >= 0)
+		return new_cpu;
+	new_cpu = cpu;
+
 	if (sd_flag & SD_BALANCE_WAKE) {
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
 			want_affine = 1;
@@ -2080,6 +2562,9 @@ int can_migrate_task(struct task_struct *p, struct rq *rq, int this_cpu,
 		return 0;
 	}
 
+	if (!hmp_can_migrate_task(p, cpu_of(rq), this_cpu))
+		return 0;
+
 	/*
 	 * Aggressive migration if:
 	 * 1) task is cache cold, or
@@ -2158,14 +2643,14 @@ balance_tasks(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (loops++ > sysctl_sched_nr_migrate)
 			break;
 
-		if ((p->se.load.weight >> 1) > rem_load_move ||
+		if ((task_cpu_load(p) >> 1) > rem_load_move ||
 		    !can_migrate_task(p, busiest, this_cpu, sd, idle,
 				      all_pinned))
 			continue;
 
 		pull_task(busiest, p, this_rq, this_cpu);
 		pulled++;
-		rem_load_move -= p->se.load.weight;
+		rem_load_move -= task_cpu_load(p);
 
 #ifdef CONFIG_PREEMPT
 		/*
@@ -2254,7 +2739,9 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 	list_for_each_entry_rcu(tg, &task_groups, list) {
 		struct cfs_rq *busiest_cfs_rq = tg->cfs_rq[busiest_cpu];
 		unsigned long busiest_h_load = busiest_cfs_rq->h_load;
-		unsigned long busiest_weight = busiest_cfs_rq->load.weight;
+		unsigned long busiest_weight = sched_feat(LOAD_AVG) ?
+			busiest_cfs_rq->runnable_load_avg :
+			busiest_cfs_rq->load.weight;
 		u64 rem_load, moved_load;
 
 		/*
@@ -4085,6 +4572,8 @@ static inline int on_null_domain(int cpu)
  */
 static inline void trigger_load_balance(struct rq *rq, int cpu)
 {
+	hmp_force_up_migration(rq);
+
 	/* Don't need to rebalance while attached to NULL domain */
 	if (time_after_eq(jiffies, rq->next_balance) &&
 	    likely(!on_null_domain(cpu)))
@@ -4128,6 +4617,8 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	update_rq_runnable_avg(rq, 1);
 }
 
 /*
@@ -72,3 +72,16 @@ SCHED_FEAT(NONIRQ_POWER, 1)
 SCHED_FEAT(TTWU_QUEUE, 1)
 
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
+
+/*
+ * Balance on the decayed runnable load of the queued entities rather
+ * than on their instantaneous weight.
+ */
+SCHED_FEAT(LOAD_AVG, 1)
+
+/*
+ * On cpus of unequal capacity, place tasks whose runnable average is
+ * above sched_hmp_up_threshold on the fastest cpus, and those below
+ * sched_hmp_down_threshold on the slower ones.
+ */
+SCHED_FEAT(HMP, 1)
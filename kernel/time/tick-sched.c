@@ -11,12 +11,15 @@
  *
  *  Distribute under GPLv2.
  */
+#include <linux/bootmem.h>
 #include <linux/cpu.h>
 #include <linux/err.h>
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
@@ -40,6 +43,14 @@ struct tick_sched *tick_get_tick_sched(int cpu)
 	return &per_cpu(tick_cpu_sched, cpu);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+static void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now);
+static void tick_nohz_full_residual_tick(struct tick_sched *ts);
+#else
+static inline void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now) { }
+static inline void tick_nohz_full_residual_tick(struct tick_sched *ts) { }
+#endif
+
 /*
  * Must be called with interrupts disabled !
  */
@@ -123,6 +134,33 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * CPUs given by the nohz_full= boot parameter stop their tick while
+ * they run a single task.  The boot CPU keeps the jiffies and
+ * timekeeping duty for them, so it can not be one of them.
+ */
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+	if (cpumask_test_cpu(0, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: CPU 0 keeps the timekeeping duty, "
+		       "clearing it from nohz_full\n");
+		cpumask_clear_cpu(0, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+#endif /* NO_HZ_FULL */
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -303,6 +341,14 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (!inidle && !ts->inidle)
 		goto end;
 
+	/*
+	 * A full dynticks CPU may come here with the tick it stopped
+	 * while busy.  Restart it, the idle bookkeeping below starts
+	 * from a running tick.
+	 */
+	if (unlikely(!ts->inidle && ts->tick_stopped))
+		tick_nohz_full_restart(ts, ktime_get());
+
 	/*
 	 * Set ts->inidle unconditionally. Even if the system did not
 	 * switch to NOHZ mode the cpu frequency governers rely on the
@@ -330,6 +376,18 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (need_resched())
 		goto end;
 
+#ifdef CONFIG_NO_HZ_FULL
+	/*
+	 * Nobody else updates jiffies for the full dynticks CPUs, so the
+	 * timekeeping CPU keeps its tick, and nobody stops the tick until
+	 * the duty has been taken.
+	 */
+	if (tick_nohz_full_running &&
+	    (cpu == tick_do_timer_cpu ||
+	     tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+		goto end;
+#endif
+
 	if (unlikely(local_softirq_pending() && cpu_online(cpu))) {
 		static int ratelimit;
 
@@ -576,6 +634,219 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * A busy CPU with its tick stopped still takes a residual tick at least
+ * this often.  The load average, the scheduler's cpu_load and the RCU
+ * stall checks are only updated from the tick.
+ */
+#define TICK_NOHZ_FULL_MAX_DEFER	HZ
+
+/*
+ * Charge @ticks jiffies, which went by without a tick, to the current
+ * task as user or system time, depending on where the tick was stopped.
+ */
+static void tick_nohz_full_account_ticks(struct tick_sched *ts,
+					 unsigned long ticks, int hardirq_offset)
+{
+	cputime_t delta;
+
+	if (!ticks || ticks >= LONG_MAX || idle_cpu(smp_processor_id()))
+		return;
+
+	delta = jiffies_to_cputime(ticks);
+	if (ts->full_user)
+		account_user_time(current, delta, cputime_to_scaled(delta));
+	else
+		account_system_time(current, hardirq_offset, delta,
+				    cputime_to_scaled(delta));
+}
+
+/*
+ * The tick came in while stopped on a busy CPU, as the residual tick or
+ * for a timer.  update_process_times() accounts this tick, we account
+ * the ones that were skipped since the last.
+ */
+static void tick_nohz_full_residual_tick(struct tick_sched *ts)
+{
+	unsigned long ticks = jiffies - ts->full_jiffies;
+
+	ts->full_jiffies = jiffies;
+	ts->full_residual++;
+	tick_nohz_full_account_ticks(ts, ticks - 1, HARDIRQ_OFFSET);
+}
+
+/**
+ * tick_nohz_full_account - account a tickless busy period on schedule
+ *
+ * Called by schedule() when the current task leaves an empty runqueue
+ * behind, so the jiffies it ran without the tick are charged to it and
+ * not lost when the idle task restarts the tick.
+ */
+void tick_nohz_full_account(void)
+{
+	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
+
+	if (!ts->tick_stopped || ts->inidle)
+		return;
+
+	tick_nohz_full_account_ticks(ts, jiffies - ts->full_jiffies, 0);
+	ts->full_jiffies = jiffies;
+}
+
+/*
+ * Can this busy CPU run without the tick?  Only if a single task is
+ * runnable and nothing else depends on the tick: POSIX CPU timers, perf
+ * event rotation, RCU, or an unstable sched_clock.  The timekeeping
+ * CPU keeps its tick.
+ */
+static bool can_stop_full_tick(int cpu, struct tick_sched *ts)
+{
+	if (!tick_nohz_enabled || ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return false;
+
+	if (unlikely(!cpu_online(cpu)) || cpu == tick_do_timer_cpu)
+		return false;
+
+	if (!sched_can_stop_tick())
+		return false;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	if (!perf_event_can_stop_tick())
+		return false;
+
+	if (rcu_needs_tick(cpu) || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu))
+		return false;
+
+#ifdef CONFIG_HAVE_UNSTABLE_SCHED_CLOCK
+	/* sched_clock_cpu() is only kept sane by sched_clock_tick() */
+	if (!sched_clock_stable)
+		return false;
+#endif
+
+	return true;
+}
+
+/*
+ * Stop the tick of a busy CPU, or move the stopped tick, up to the next
+ * timer wheel timer but at most TICK_NOHZ_FULL_MAX_DEFER away.  The
+ * hrtimers run from their own events in high resolution mode.
+ */
+static void tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	struct pt_regs *regs = get_irq_regs();
+	unsigned long seq, last_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	delta_jiffies = get_next_timer_interrupt(last_jiffies) - last_jiffies;
+	if ((long)delta_jiffies <= 1) {
+		if (ts->tick_stopped)
+			tick_nohz_full_restart(ts, ktime_get());
+		return;
+	}
+	if (delta_jiffies > TICK_NOHZ_FULL_MAX_DEFER)
+		delta_jiffies = TICK_NOHZ_FULL_MAX_DEFER;
+
+	expires = ktime_add_ns(last_update, tick_period.tv64 * delta_jiffies);
+
+	ts->full_user = regs && user_mode(regs);
+
+	/* Skip reprogram of event if its not changed */
+	if (ts->tick_stopped &&
+	    ktime_equal(expires, hrtimer_get_expires(&ts->sched_timer)))
+		return;
+
+	if (!ts->tick_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->tick_stopped = 1;
+		ts->full_jiffies = last_jiffies;
+		ts->full_stops++;
+	}
+
+	hrtimer_start(&ts->sched_timer, expires, HRTIMER_MODE_ABS_PINNED);
+	/* Check, if the timer was already in the past */
+	if (!hrtimer_active(&ts->sched_timer))
+		tick_nohz_full_restart(ts, ktime_get());
+}
+
+/*
+ * Restart the tick of a busy CPU: a second task became runnable, or
+ * something else needs the tick again.
+ */
+static void tick_nohz_full_restart(struct tick_sched *ts, ktime_t now)
+{
+	tick_nohz_full_account_ticks(ts, jiffies - ts->full_jiffies, 0);
+	ts->tick_stopped = 0;
+	ts->full_restarts++;
+
+	tick_nohz_restart(ts, now);
+}
+
+void __tick_nohz_full_check(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+	unsigned long flags;
+
+	local_irq_save(flags);
+	/* The idle loop handles the tick of an idle CPU */
+	if (!ts->inidle && !idle_cpu(cpu)) {
+		if (can_stop_full_tick(cpu, ts))
+			tick_nohz_full_stop_tick(ts);
+		else if (ts->tick_stopped)
+			tick_nohz_full_restart(ts, ktime_get());
+	}
+	local_irq_restore(flags);
+}
+
+/**
+ * tick_nohz_full_kick_cpu - make a full dynticks CPU reevaluate its tick
+ * @cpu: CPU that got more work, a timer or a task to run
+ *
+ * The reschedule IPI goes through irq_exit() on full dynticks CPUs,
+ * which restarts the tick if needed.  Called with interrupts disabled,
+ * so the tick of the local CPU can't be stopped behind our back.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	if (cpu == smp_processor_id() &&
+	    !__get_cpu_var(tick_cpu_sched).tick_stopped)
+		return;
+
+	smp_send_reschedule(cpu);
+}
+
+/**
+ * tick_nohz_full_kick_all - make all full dynticks CPUs reevaluate
+ *
+ * For process wide state that needs the tick, like POSIX CPU timers.
+ */
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		smp_send_reschedule(cpu);
+	preempt_enable();
+}
+#endif /* NO_HZ_FULL */
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -775,8 +1046,13 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		 * when we go busy again does not account too much ticks.
 		 */
 		if (ts->tick_stopped) {
-			touch_softlockup_watchdog();
-			ts->idle_jiffies++;
+			if (ts->inidle) {
+				touch_softlockup_watchdog();
+				ts->idle_jiffies++;
+			} else {
+				/* Busy CPU, irq_exit() stops the tick again */
+				tick_nohz_full_residual_tick(ts);
+			}
 		}
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
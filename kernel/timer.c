@@ -715,6 +715,13 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 		base->next_timer = timer->expires;
 	internal_add_timer(base, timer);
 
+	/*
+	 * A full dynticks CPU programmed its stopped tick for the timers
+	 * it had, make it look at the timer wheel again.
+	 */
+	if (base == new_base && !tbase_get_deferrable(timer->base))
+		tick_nohz_full_kick_cpu(cpu);
+
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
 
@@ -881,6 +888,8 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * the timer wheel.
 	 */
 	wake_up_idle_cpu(cpu);
+	if (!tbase_get_deferrable(timer->base))
+		tick_nohz_full_kick_cpu(cpu);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
@@ -46,6 +46,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->activity = 0;
 	spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	sem->owner = NULL;
+#endif
 }
 EXPORT_SYMBOL(__init_rwsem);
 
@@ -57,6 +60,9 @@ EXPORT_SYMBOL(__init_rwsem);
  * - the spinlock must be held by the caller
  * - woken process blocks are discarded from the list after having task zeroed
  * - writers are only woken if wakewrite is non-zero
+ *
+ * A woken writer is not granted the lock, it takes it when it runs; a
+ * writer already running may steal it in the meantime.
  */
 static inline struct rw_semaphore *
 __rwsem_do_wake(struct rw_semaphore *sem, int wakewrite)
@@ -73,20 +79,11 @@ __rwsem_do_wake(struct rw_semaphore *sem, int wakewrite)
 		goto dont_wake_writers;
 	}
 
-	/* if we are allowed to wake writers try to grant a single write lock
-	 * if there's a writer at the front of the queue
-	 * - we leave the 'waiting count' incremented to signify potential
-	 *   contention
+	/* if we are allowed to wake writers, wake the writer at the front
+	 * of the queue; it stays queued until it gets the lock
 	 */
 	if (waiter->flags & RWSEM_WAITING_FOR_WRITE) {
-		sem->activity = -1;
-		list_del(&waiter->list);
-		tsk = waiter->task;
-		/* Don't touch waiter after ->task has been NULLed */
-		smp_mb();
-		waiter->task = NULL;
-		wake_up_process(tsk);
-		put_task_struct(tsk);
+		wake_up_process(waiter->task);
 		goto out;
 	}
 
@@ -121,18 +118,10 @@ static inline struct rw_semaphore *
 __rwsem_wake_one_writer(struct rw_semaphore *sem)
 {
 	struct rwsem_waiter *waiter;
-	struct task_struct *tsk;
-
-	sem->activity = -1;
 
 	waiter = list_entry(sem->wait_list.next, struct rwsem_waiter, list);
-	list_del(&waiter->list);
+	wake_up_process(waiter->task);
 
-	tsk = waiter->task;
-	smp_mb();
-	waiter->task = NULL;
-	wake_up_process(tsk);
-	put_task_struct(tsk);
 	return sem;
 }
 
@@ -202,9 +191,61 @@ int __down_read_trylock(struct rw_semaphore *sem)
 	return ret;
 }
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Optimistic spinning, as for mutexes: while the writer owning the
+ * lock is running, it is likely to release it soon, and spinning is
+ * cheaper than the two context switches of sleeping.  Gives up when
+ * the owner sleeps, the owner changes, or we have to reschedule.
+ */
+static int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	struct task_struct *owner;
+	int taken = 0;
+
+	preempt_disable();
+
+	/* No owner: read owned, or the writer has not set it yet */
+	if (!ACCESS_ONCE(sem->owner))
+		goto done;
+
+	for (;;) {
+		owner = ACCESS_ONCE(sem->owner);
+		if (owner && !rwsem_spin_on_owner(sem, owner))
+			break;
+
+		/* only take the wait_lock when the lock looks free */
+		if (ACCESS_ONCE(sem->activity) == 0 &&
+		    __down_write_trylock(sem)) {
+			taken = 1;
+			break;
+		}
+
+		/*
+		 * When there's no owner, we might have preempted between the
+		 * owner acquiring the lock and setting the owner field. If
+		 * we're an RT task that will live-lock because we won't let
+		 * the owner complete.
+		 */
+		if (!owner && (need_resched() || rt_task(current)))
+			break;
+
+		arch_mutex_cpu_relax();
+	}
+
+done:
+	preempt_enable();
+	return taken;
+}
+#else
+static inline int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	return 0;
+}
+#endif
+
 /*
  * get a write lock on the semaphore
- * - we increment the waiting count anyway to indicate an exclusive lock
  */
 void __sched __down_write_nested(struct rw_semaphore *sem, int subclass)
 {
@@ -214,37 +255,46 @@ void __sched __down_write_nested(struct rw_semaphore *sem, int subclass)
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
-	if (sem->activity == 0 && list_empty(&sem->wait_list)) {
+	if (sem->activity == 0) {
 		/* granted */
 		sem->activity = -1;
 		spin_unlock_irqrestore(&sem->wait_lock, flags);
-		goto out;
+		return;
 	}
 
-	tsk = current;
-	set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+	spin_unlock_irqrestore(&sem->wait_lock, flags);
+
+	/* spin on a running owner and steal the lock if possible */
+	if (rwsem_optimistic_spin(sem))
+		return;
+
+	spin_lock_irqsave(&sem->wait_lock, flags);
 
 	/* set up my own style of waitqueue */
+	tsk = current;
 	waiter.task = tsk;
 	waiter.flags = RWSEM_WAITING_FOR_WRITE;
-	get_task_struct(tsk);
-
 	list_add_tail(&waiter.list, &sem->wait_list);
 
-	/* we don't need to touch the semaphore struct anymore */
-	spin_unlock_irqrestore(&sem->wait_lock, flags);
-
-	/* wait to be given the lock */
+	/*
+	 * Wait for the lock to be free, and take it ourselves: a writer
+	 * still running when the lock is released gets it ahead of the
+	 * ones that have to be woken up.
+	 */
 	for (;;) {
-		if (!waiter.task)
+		if (sem->activity == 0)
 			break;
-		schedule();
 		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+		spin_unlock_irqrestore(&sem->wait_lock, flags);
+		schedule();
+		spin_lock_irqsave(&sem->wait_lock, flags);
 	}
 
-	tsk->state = TASK_RUNNING;
- out:
-	;
+	/* got the lock */
+	sem->activity = -1;
+	list_del(&waiter.list);
+
+	spin_unlock_irqrestore(&sem->wait_lock, flags);
 }
 
 void __sched __down_write(struct rw_semaphore *sem)
@@ -262,8 +312,8 @@ int __down_write_trylock(struct rw_semaphore *sem)
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
-	if (sem->activity == 0 && list_empty(&sem->wait_list)) {
-		/* granted */
+	if (sem->activity == 0) {
+		/* granted, possibly ahead of queued writers */
 		sem->activity = -1;
 		ret = 1;
 	}
@@ -31,8 +31,11 @@
 #include <linux/mm.h>          /* PAGE_ALIGN() */
 #include <linux/module.h>      /* EXPORT_SYMBOL_GPL() */
 #include <linux/mutex.h>       /* mutex */
+#include <linux/proc_fs.h>     /* proc_create() */
+#include <linux/seq_file.h>    /* seq_printf() */
 #include <linux/slab.h>        /* kmalloc() */
 #include <linux/string.h>      /* str*() */
+#include <linux/hrtimer.h>     /* ktime_get() */
 
 #include <linux/cma.h>
 #include <linux/vmalloc.h>
@@ -1015,6 +1018,64 @@ static void __cma_chunk_free(struct cma_chunk *chunk)
 }
 
 
+/************************* Allocation latency *************************/
+
+/*
+ * Latency of allocations as seen by the caller, waiting for cma_mutex
+ * included, in power of two buckets of milliseconds: <1ms, <2ms, ...,
+ * <1024ms and everything slower.
+ */
+#define CMA_LATENCY_BUCKETS	12
+
+static atomic_t cma_latency[CMA_LATENCY_BUCKETS];
+static atomic_t cma_alloc_failed;
+
+static void __cma_account_latency(ktime_t start, dma_addr_t addr)
+{
+	s64 ms = ktime_to_ms(ktime_sub(ktime_get(), start));
+	int b = 0;
+
+	while (b < CMA_LATENCY_BUCKETS - 1 && ms >= (1LL << b))
+		b++;
+	atomic_inc(&cma_latency[b]);
+	if (IS_ERR_VALUE(addr))
+		atomic_inc(&cma_alloc_failed);
+}
+
+static int cma_latency_show(struct seq_file *m, void *v)
+{
+	int b;
+
+	for (b = 0; b < CMA_LATENCY_BUCKETS - 1; b++)
+		seq_printf(m, "<%u ms\t%u\n", 1U << b,
+			   atomic_read(&cma_latency[b]));
+	seq_printf(m, ">=%u ms\t%u\n", 1U << (b - 1),
+		   atomic_read(&cma_latency[b]));
+	seq_printf(m, "failed\t%u\n", atomic_read(&cma_alloc_failed));
+	return 0;
+}
+
+static int cma_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_latency_show, NULL);
+}
+
+static const struct file_operations cma_latency_fops = {
+	.open		= cma_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cma_latency_init(void)
+{
+	proc_create("cma_alloc_latency", S_IRUGO, NULL, &cma_latency_fops);
+	return 0;
+}
+device_initcall(cma_latency_init);
+
+
+
 /************************* The Device API *************************/
 
 static const char *__must_check
@@ -1065,6 +1126,7 @@ dma_addr_t __must_check
 cma_alloc_from_region(struct cma_region *reg,
 		      size_t size, dma_addr_t alignment)
 {
+	ktime_t start = ktime_get();
 	dma_addr_t addr;
 
 	pr_debug("allocate %p/%p from %s\n",
@@ -1083,6 +1145,7 @@ cma_alloc_from_region(struct cma_region *reg,
 
 	mutex_unlock(&cma_mutex);
 
+	__cma_account_latency(start, addr);
 	return addr;
 }
 EXPORT_SYMBOL_GPL(cma_alloc_from_region);
@@ -1091,6 +1154,7 @@ dma_addr_t __must_check
 __cma_alloc(const struct device *dev, const char *type,
 	    dma_addr_t size, dma_addr_t alignment)
 {
+	ktime_t start = ktime_get();
 	struct cma_region *reg;
 	const char *from;
 	dma_addr_t addr;
@@ -1133,6 +1197,7 @@ __cma_alloc(const struct device *dev, const char *type,
 done:
 	mutex_unlock(&cma_mutex);
 
+	__cma_account_latency(start, addr);
 	return addr;
 }
 EXPORT_SYMBOL_GPL(__cma_alloc);
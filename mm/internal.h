@@ -91,6 +91,11 @@ extern unsigned long highest_memmap_pfn;
 extern int isolate_lru_page(struct page *page);
 extern void putback_lru_page(struct page *page);
 
+/*
+ * in mm/swap.c:
+ */
+extern void free_page_list(struct list_head *list, int cold);
+
 /*
  * in mm/page_alloc.c
  */
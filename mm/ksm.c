@@ -23,7 +23,6 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -78,6 +77,13 @@
  *    take 10 attempts to find a page in the unstable tree, once it is found,
  *    it is secured in the stable tree.  (When we scan a new page, we first
  *    compare it against the stable tree, and then against the unstable tree.)
+ *
+ * Scanning may be spread over several ksmd threads.  Each thread takes whole
+ * mm_slots off the list in turn, and both trees are split into buckets by
+ * page checksum, each bucket under its own mutex: identical pages always
+ * checksum alike, so they still meet in the same bucket.  A full scan is
+ * complete only when the last thread has finished with its mm_slot, and
+ * only then are the unstable trees flushed.
  */
 
 /**
@@ -86,28 +92,53 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @busy: set while a ksmd thread is scanning this mm_slot
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	int busy;
 };
 
 /**
  * struct ksm_scan - cursor for scanning
- * @mm_slot: the current mm_slot we are scanning
- * @address: the next address inside that to be scanned
- * @rmap_list: link to the next rmap to be scanned in the rmap_list
+ * @mm_slot: the next mm_slot to be handed out to a ksmd thread
+ * @nr_active: number of ksmd threads holding an mm_slot
  * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @start: jiffies when the current full scan started
+ * @start_scanned: pages scanned by then
+ * @start_merged: pages merged by then
  *
- * There is only the one ksm_scan instance of this cursor structure.
+ * There is only the one ksm_scan instance of this cursor structure,
+ * protected by ksm_mmlist_lock.
  */
 struct ksm_scan {
+	struct mm_slot *mm_slot;
+	unsigned int nr_active;
+	unsigned long seqnr;
+	unsigned long start;
+	unsigned long start_scanned;
+	unsigned long start_merged;
+};
+
+/**
+ * struct ksm_worker - per-thread part of the scanning cursor
+ * @task: the ksmd thread, NULL when not running
+ * @mm_slot: the mm_slot this thread is scanning, NULL if none
+ * @address: the next address inside that to be scanned
+ * @rmap_list: link to the next rmap to be scanned in the rmap_list
+ * @pages_scanned: pages scanned by this thread
+ * @pages_merged: pages merged into ksm pages by this thread
+ */
+struct ksm_worker {
+	struct task_struct *task;
 	struct mm_slot *mm_slot;
 	unsigned long address;
 	struct rmap_item **rmap_list;
-	unsigned long seqnr;
+	unsigned long pages_scanned;
+	unsigned long pages_merged;
 };
 
 /**
@@ -152,9 +183,20 @@ struct rmap_item {
 #define UNSTABLE_FLAG	0x100	/* is a node of the unstable tree */
 #define STABLE_FLAG	0x200	/* is listed from the stable tree */
 
-/* The stable and unstable tree heads */
-static struct rb_root root_stable_tree = RB_ROOT;
-static struct rb_root root_unstable_tree = RB_ROOT;
+/*
+ * The stable and unstable trees, split into buckets by page checksum.
+ * The lock covers both trees of the bucket, and the rmap_item lists of
+ * its stable_nodes.
+ */
+#define KSM_TREE_SHIFT		6
+#define KSM_TREE_BUCKETS	(1 << KSM_TREE_SHIFT)
+
+struct ksm_tree {
+	struct mutex lock;
+	struct rb_root stable;
+	struct rb_root unstable;
+};
+static struct ksm_tree ksm_trees[KSM_TREE_BUCKETS];
 
 #define MM_SLOTS_HASH_SHIFT 10
 #define MM_SLOTS_HASH_HEADS (1 << MM_SLOTS_HASH_SHIFT)
@@ -172,16 +214,16 @@ static struct kmem_cache *stable_node_cache;
 static struct kmem_cache *mm_slot_cache;
 
 /* The number of nodes in the stable tree */
-static unsigned long ksm_pages_shared;
+static atomic_long_t ksm_pages_shared = ATOMIC_LONG_INIT(0);
 
 /* The number of page slots additionally sharing those nodes */
-static unsigned long ksm_pages_sharing;
+static atomic_long_t ksm_pages_sharing = ATOMIC_LONG_INIT(0);
 
 /* The number of nodes in the unstable tree */
-static unsigned long ksm_pages_unshared;
+static atomic_long_t ksm_pages_unshared = ATOMIC_LONG_INIT(0);
 
 /* The number of rmap_items in use: to calculate pages_volatile */
-static unsigned long ksm_rmap_items;
+static atomic_long_t ksm_rmap_items = ATOMIC_LONG_INIT(0);
 
 /* Number of pages ksmd should scan in one batch */
 static unsigned int ksm_thread_pages_to_scan = 128;
@@ -189,13 +231,23 @@ static unsigned int ksm_thread_pages_to_scan = 128;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 4000;
 
+/* Number of ksmd threads scanning in parallel */
+#define KSM_MAX_THREADS	16
+static unsigned int ksm_nr_threads;
+static struct ksm_worker ksm_workers[KSM_MAX_THREADS];
+
+/* Pages scanned and merged per second over the last full scan */
+static unsigned long ksm_scan_rate;
+static unsigned long ksm_merge_rate;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_MERGE;
 
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
-static DEFINE_MUTEX(ksm_thread_mutex);
+static DEFINE_MUTEX(ksm_thread_mutex);		/* starting and stopping ksmd */
+static DECLARE_RWSEM(ksm_scan_sem);		/* ksmd batches vs. control */
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create("ksm_"#__struct,\
@@ -240,13 +292,13 @@ static inline struct rmap_item *alloc_rmap_item(void)
 
 	rmap_item = kmem_cache_zalloc(rmap_item_cache, GFP_KERNEL);
 	if (rmap_item)
-		ksm_rmap_items++;
+		atomic_long_inc(&ksm_rmap_items);
 	return rmap_item;
 }
 
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
-	ksm_rmap_items--;
+	atomic_long_dec(&ksm_rmap_items);
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -302,6 +354,11 @@ static inline int in_stable_tree(struct rmap_item *rmap_item)
 	return rmap_item->address & STABLE_FLAG;
 }
 
+static inline struct ksm_tree *tree_bucket(u32 checksum)
+{
+	return &ksm_trees[hash_32(checksum, KSM_TREE_SHIFT)];
+}
+
 /*
  * ksmd, and unmerge_and_remove_all_rmap_items(), must not touch an mm's
  * page tables after it has passed through ksm_exit() - which, if necessary,
@@ -443,22 +500,23 @@ out:		page = NULL;
 	return page;
 }
 
-static void remove_node_from_stable_tree(struct stable_node *stable_node)
+static void remove_node_from_stable_tree(struct stable_node *stable_node,
+					 struct ksm_tree *tree)
 {
 	struct rmap_item *rmap_item;
 	struct hlist_node *hlist;
 
 	hlist_for_each_entry(rmap_item, hlist, &stable_node->hlist, hlist) {
 		if (rmap_item->hlist.next)
-			ksm_pages_sharing--;
+			atomic_long_dec(&ksm_pages_sharing);
 		else
-			ksm_pages_shared--;
+			atomic_long_dec(&ksm_pages_shared);
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
 	}
 
-	rb_erase(&stable_node->node, &root_stable_tree);
+	rb_erase(&stable_node->node, &tree->stable);
 	free_stable_node(stable_node);
 }
 
@@ -480,7 +538,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
  * a page to put something that might look like our key in page->mapping.
  *
  * include/linux/pagemap.h page_cache_get_speculative() is a good reference,
- * but this is different - made simpler by ksm_thread_mutex being held, but
+ * but this is different - made simpler by the tree lock being held, but
  * interesting for assuming that no other use of the struct page could ever
  * put our expected_mapping into page->mapping (or a field of the union which
  * coincides with page->mapping).  The RCU calls are not for KSM at all, but
@@ -491,7 +549,8 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
  * page_unfreeze_refs(): this shouldn't be a problem anywhere, the page
  * is on its way to being freed; but it is an anomaly to bear in mind.
  */
-static struct page *get_ksm_page(struct stable_node *stable_node)
+static struct page *get_ksm_page(struct stable_node *stable_node,
+				 struct ksm_tree *tree)
 {
 	struct page *page;
 	void *expected_mapping;
@@ -512,24 +571,26 @@ static struct page *get_ksm_page(struct stable_node *stable_node)
 	return page;
 stale:
 	rcu_read_unlock();
-	remove_node_from_stable_tree(stable_node);
+	remove_node_from_stable_tree(stable_node, tree);
 	return NULL;
 }
 
 /*
  * Removing rmap_item from stable or unstable tree.
  * This function will clean the information from the stable/unstable tree.
+ * Called with the lock held on the tree bucket of the rmap_item.
  */
-static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
+static void __remove_rmap_item_from_tree(struct rmap_item *rmap_item,
+					 struct ksm_tree *tree)
 {
 	if (rmap_item->address & STABLE_FLAG) {
 		struct stable_node *stable_node;
 		struct page *page;
 
 		stable_node = rmap_item->head;
-		page = get_ksm_page(stable_node);
+		page = get_ksm_page(stable_node, tree);
 		if (!page)
-			goto out;
+			return;
 
 		lock_page(page);
 		hlist_del(&rmap_item->hlist);
@@ -537,9 +598,9 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		put_page(page);
 
 		if (stable_node->hlist.first)
-			ksm_pages_sharing--;
+			atomic_long_dec(&ksm_pages_sharing);
 		else
-			ksm_pages_shared--;
+			atomic_long_dec(&ksm_pages_shared);
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -548,7 +609,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		unsigned char age;
 		/*
 		 * Usually ksmd can and must skip the rb_erase, because
-		 * root_unstable_tree was already reset to RB_ROOT.
+		 * the unstable tree was already reset to RB_ROOT.
 		 * But be careful when an mm is exiting: do the rb_erase
 		 * if this rmap_item was inserted by this scan, rather
 		 * than left over from before.
@@ -556,23 +617,52 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
 		BUG_ON(age > 1);
 		if (!age)
-			rb_erase(&rmap_item->node, &root_unstable_tree);
+			rb_erase(&rmap_item->node, &tree->unstable);
 
-		ksm_pages_unshared--;
+		atomic_long_dec(&ksm_pages_unshared);
 		rmap_item->address &= PAGE_MASK;
 	}
-out:
+}
+
+static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
+{
+	struct ksm_tree *tree;
+
+	/*
+	 * Only the thread scanning its mm_slot puts an rmap_item into a
+	 * tree, and oldchecksum stays fixed while it is in one.  But another
+	 * thread may be moving it from the unstable to the stable tree, with
+	 * neither flag set in between: so the flags can only be trusted
+	 * under the lock of its bucket.
+	 */
+	tree = tree_bucket(rmap_item->oldchecksum);
+	mutex_lock(&tree->lock);
+	__remove_rmap_item_from_tree(rmap_item, tree);
+	mutex_unlock(&tree->lock);
 	cond_resched();		/* we're called from many long loops */
 }
 
-static void remove_trailing_rmap_items(struct mm_slot *mm_slot,
-				       struct rmap_item **rmap_list)
+/*
+ * The tree locks nest outside mmap_sem, so rmap_items are unlinked from
+ * their mm_slot under mmap_sem, but taken out of the trees and freed by
+ * free_rmap_items() after it has been dropped.
+ */
+static struct rmap_item *cut_trailing_rmap_items(struct rmap_item **rmap_list)
 {
-	while (*rmap_list) {
-		struct rmap_item *rmap_item = *rmap_list;
-		*rmap_list = rmap_item->rmap_list;
+	struct rmap_item *rmap_item = *rmap_list;
+
+	*rmap_list = NULL;
+	return rmap_item;
+}
+
+static void free_rmap_items(struct rmap_item *rmap_item)
+{
+	while (rmap_item) {
+		struct rmap_item *next = rmap_item->rmap_list;
+
 		remove_rmap_item_from_tree(rmap_item);
 		free_rmap_item(rmap_item);
+		rmap_item = next;
 	}
 }
 
@@ -615,9 +705,22 @@ static int unmerge_and_remove_all_rmap_items(void)
 	struct mm_slot *mm_slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
+	struct rmap_item *rmap_items;
 	int err = 0;
+	int i;
 
 	spin_lock(&ksm_mmlist_lock);
+	/*
+	 * ksmd threads are held off by ksm_scan_sem, but may still own an
+	 * mm_slot between batches: take those back, it is all rescanned.
+	 */
+	for (i = 0; i < KSM_MAX_THREADS; i++) {
+		if (ksm_workers[i].mm_slot) {
+			ksm_workers[i].mm_slot->busy = 0;
+			ksm_workers[i].mm_slot = NULL;
+		}
+	}
+	ksm_scan.nr_active = 0;
 	ksm_scan.mm_slot = list_entry(ksm_mm_head.mm_list.next,
 						struct mm_slot, mm_list);
 	spin_unlock(&ksm_mmlist_lock);
@@ -637,7 +740,7 @@ static int unmerge_and_remove_all_rmap_items(void)
 				goto error;
 		}
 
-		remove_trailing_rmap_items(mm_slot, &mm_slot->rmap_list);
+		rmap_items = cut_trailing_rmap_items(&mm_slot->rmap_list);
 
 		spin_lock(&ksm_mmlist_lock);
 		ksm_scan.mm_slot = list_entry(mm_slot->mm_list.next,
@@ -647,13 +750,15 @@ static int unmerge_and_remove_all_rmap_items(void)
 			list_del(&mm_slot->mm_list);
 			spin_unlock(&ksm_mmlist_lock);
 
-			free_mm_slot(mm_slot);
 			clear_bit(MMF_VM_MERGEABLE, &mm->flags);
 			up_read(&mm->mmap_sem);
+			free_rmap_items(rmap_items);
+			free_mm_slot(mm_slot);
 			mmdrop(mm);
 		} else {
 			spin_unlock(&ksm_mmlist_lock);
 			up_read(&mm->mmap_sem);
+			free_rmap_items(rmap_items);
 		}
 	}
 
@@ -669,13 +774,33 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+static inline unsigned long checksum_mix(unsigned long hash,
+					 unsigned long word)
+{
+	hash = (hash ^ word) * GOLDEN_RATIO_PRIME;
+	return (hash << (BITS_PER_LONG / 2)) | (hash >> (BITS_PER_LONG / 2));
+}
+
+/*
+ * The checksum only has to notice pages that change between scans, and
+ * spread pages over the tree buckets; it is taken of every page scanned.
+ * So rather than jhash2, mix in a word at a time on four independent
+ * lanes, letting the multiplies of one lane overlap with the others.
+ */
 static u32 calc_checksum(struct page *page)
 {
-	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	unsigned long *addr = kmap_atomic(page, KM_USER0);
+	unsigned long a = 0, b = 0, c = 0, d = 0;
+	int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(long); i += 4) {
+		a = checksum_mix(a, addr[i]);
+		b = checksum_mix(b, addr[i + 1]);
+		c = checksum_mix(c, addr[i + 2]);
+		d = checksum_mix(d, addr[i + 3]);
+	}
 	kunmap_atomic(addr, KM_USER0);
-	return checksum;
+	return hash_long(checksum_mix(checksum_mix(a, b), c ^ d), 32);
 }
 
 static int memcmp_pages(struct page *page1, struct page *page2)
@@ -983,9 +1108,10 @@ static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
  * This function returns the stable tree node of identical content if found,
  * NULL otherwise.
  */
-static struct page *stable_tree_search(struct page *page)
+static struct page *stable_tree_search(struct page *page,
+				       struct ksm_tree *tree)
 {
-	struct rb_node *node = root_stable_tree.rb_node;
+	struct rb_node *node = tree->stable.rb_node;
 	struct stable_node *stable_node;
 
 	stable_node = page_stable_node(page);
@@ -1000,7 +1126,7 @@ static struct page *stable_tree_search(struct page *page)
 
 		cond_resched();
 		stable_node = rb_entry(node, struct stable_node, node);
-		tree_page = get_ksm_page(stable_node);
+		tree_page = get_ksm_page(stable_node, tree);
 		if (!tree_page)
 			return NULL;
 
@@ -1026,19 +1152,28 @@ static struct page *stable_tree_search(struct page *page)
  * This function returns the stable tree node just allocated on success,
  * NULL otherwise.
  */
-static struct stable_node *stable_tree_insert(struct page *kpage)
+static struct stable_node *stable_tree_insert(struct page *kpage,
+					      struct ksm_tree *tree)
 {
-	struct rb_node **new = &root_stable_tree.rb_node;
+	struct rb_node **new = &tree->stable.rb_node;
 	struct rb_node *parent = NULL;
 	struct stable_node *stable_node;
 
+	/*
+	 * Only now that kpage is write-protected is its content fixed: if it
+	 * changed since it was checksummed, it belongs in another bucket,
+	 * where identical pages would look for it.
+	 */
+	if (tree_bucket(calc_checksum(kpage)) != tree)
+		return NULL;
+
 	while (*new) {
 		struct page *tree_page;
 		int ret;
 
 		cond_resched();
 		stable_node = rb_entry(*new, struct stable_node, node);
-		tree_page = get_ksm_page(stable_node);
+		tree_page = get_ksm_page(stable_node, tree);
 		if (!tree_page)
 			return NULL;
 
@@ -1065,7 +1200,7 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 		return NULL;
 
 	rb_link_node(&stable_node->node, parent, new);
-	rb_insert_color(&stable_node->node, &root_stable_tree);
+	rb_insert_color(&stable_node->node, &tree->stable);
 
 	INIT_HLIST_HEAD(&stable_node->hlist);
 
@@ -1092,10 +1227,11 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 static
 struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 					      struct page *page,
-					      struct page **tree_pagep)
+					      struct page **tree_pagep,
+					      struct ksm_tree *tree)
 
 {
-	struct rb_node **new = &root_unstable_tree.rb_node;
+	struct rb_node **new = &tree->unstable.rb_node;
 	struct rb_node *parent = NULL;
 
 	while (*new) {
@@ -1135,9 +1271,9 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 	rmap_item->address |= UNSTABLE_FLAG;
 	rmap_item->address |= (ksm_scan.seqnr & SEQNR_MASK);
 	rb_link_node(&rmap_item->node, parent, new);
-	rb_insert_color(&rmap_item->node, &root_unstable_tree);
+	rb_insert_color(&rmap_item->node, &tree->unstable);
 
-	ksm_pages_unshared++;
+	atomic_long_inc(&ksm_pages_unshared);
 	return NULL;
 }
 
@@ -1154,9 +1290,9 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
 
 	if (rmap_item->hlist.next)
-		ksm_pages_sharing++;
+		atomic_long_inc(&ksm_pages_sharing);
 	else
-		ksm_pages_shared++;
+		atomic_long_inc(&ksm_pages_shared);
 }
 
 /*
@@ -1165,22 +1301,40 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  * be inserted into the unstable tree, or merged with a page already there and
  * both transferred to the stable tree.
  *
+ * @worker: the ksmd thread doing the scan
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
  */
-static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+static void cmp_and_merge_page(struct ksm_worker *worker, struct page *page,
+			       struct rmap_item *rmap_item)
 {
 	struct rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
 	struct stable_node *stable_node;
+	struct ksm_tree *tree;
 	struct page *kpage;
 	unsigned int checksum;
+	int changed;
 	int err;
 
 	remove_rmap_item_from_tree(rmap_item);
 
+	/*
+	 * The checksum picks the tree bucket, so it is needed before even
+	 * the stable tree can be searched.  If it has changed from the last
+	 * time we calculated it, this page is changing frequently: therefore
+	 * we don't want to insert it in the unstable tree, and we don't want
+	 * to waste our time searching for something identical to it there.
+	 */
+	checksum = calc_checksum(page);
+	changed = rmap_item->oldchecksum != checksum;
+	rmap_item->oldchecksum = checksum;
+
+	tree = tree_bucket(checksum);
+	mutex_lock(&tree->lock);
+
 	/* We first start with searching the page inside the stable tree */
-	kpage = stable_tree_search(page);
+	kpage = stable_tree_search(page, tree);
 	if (kpage) {
 		err = try_to_merge_with_ksm_page(rmap_item, page, kpage);
 		if (!err) {
@@ -1191,25 +1345,17 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			worker->pages_merged++;
 		}
 		put_page(kpage);
-		return;
+		goto out;
 	}
 
-	/*
-	 * If the hash value of the page has changed from the last time
-	 * we calculated it, this page is changing frequently: therefore we
-	 * don't want to insert it in the unstable tree, and we don't want
-	 * to waste our time searching for something identical to it there.
-	 */
-	checksum = calc_checksum(page);
-	if (rmap_item->oldchecksum != checksum) {
-		rmap_item->oldchecksum = checksum;
-		return;
-	}
+	if (changed)
+		goto out;
 
 	tree_rmap_item =
-		unstable_tree_search_insert(rmap_item, page, &tree_page);
+		unstable_tree_search_insert(rmap_item, page, &tree_page, tree);
 	if (tree_rmap_item) {
 		kpage = try_to_merge_two_pages(rmap_item, page,
 						tree_rmap_item, tree_page);
@@ -1220,13 +1366,14 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 		 * tree, and insert it instead as new node in the stable tree.
 		 */
 		if (kpage) {
-			remove_rmap_item_from_tree(tree_rmap_item);
+			__remove_rmap_item_from_tree(tree_rmap_item, tree);
 
 			lock_page(kpage);
-			stable_node = stable_tree_insert(kpage);
+			stable_node = stable_tree_insert(kpage, tree);
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				worker->pages_merged += 2;
 			}
 			unlock_page(kpage);
 
@@ -1242,11 +1389,14 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			}
 		}
 	}
+out:
+	mutex_unlock(&tree->lock);
 }
 
 static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 					    struct rmap_item **rmap_list,
-					    unsigned long addr)
+					    unsigned long addr,
+					    struct rmap_item **stale)
 {
 	struct rmap_item *rmap_item;
 
@@ -1257,8 +1407,8 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 		if (rmap_item->address > addr)
 			break;
 		*rmap_list = rmap_item->rmap_list;
-		remove_rmap_item_from_tree(rmap_item);
-		free_rmap_item(rmap_item);
+		rmap_item->rmap_list = *stale;
+		*stale = rmap_item;
 	}
 
 	rmap_item = alloc_rmap_item();
@@ -1272,18 +1422,75 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * Called with ksm_mmlist_lock held, when the last ksmd thread has finished
+ * with its mm_slot and no more are left to hand out in this full scan.
+ */
+static void ksm_scan_done(void)
 {
-	struct mm_struct *mm;
-	struct mm_slot *slot;
-	struct vm_area_struct *vma;
-	struct rmap_item *rmap_item;
+	unsigned long elapsed = jiffies - ksm_scan.start;
+	unsigned long scanned = 0, merged = 0;
+	int i;
 
-	if (list_empty(&ksm_mm_head.mm_list))
-		return NULL;
+	/*
+	 * No ksmd thread holds an mm_slot, so none can be in the trees:
+	 * they are flushed without taking the bucket locks.
+	 */
+	for (i = 0; i < KSM_TREE_BUCKETS; i++)
+		ksm_trees[i].unstable = RB_ROOT;
+	ksm_scan.seqnr++;
+
+	for (i = 0; i < KSM_MAX_THREADS; i++) {
+		scanned += ksm_workers[i].pages_scanned;
+		merged += ksm_workers[i].pages_merged;
+	}
+	if (elapsed) {
+		ksm_scan_rate = div_u64((u64)(scanned - ksm_scan.start_scanned) *
+					HZ, elapsed);
+		ksm_merge_rate = div_u64((u64)(merged - ksm_scan.start_merged) *
+					 HZ, elapsed);
+	}
+	ksm_scan.start_scanned = scanned;
+	ksm_scan.start_merged = merged;
+}
+
+/*
+ * Hand out the next mm_slot of this full scan to a ksmd thread, starting
+ * the next full scan if the last one is done.  Returns NULL if there is
+ * nothing to scan, or if other threads are still finishing the last full
+ * scan: the unstable trees cannot be flushed until they are done.
+ */
+static struct mm_slot *ksm_get_mm_slot(struct ksm_worker *worker)
+{
+	struct mm_slot *slot;
+	int new_scan = 0;
 
+	spin_lock(&ksm_mmlist_lock);
 	slot = ksm_scan.mm_slot;
 	if (slot == &ksm_mm_head) {
+		if (ksm_scan.nr_active) {
+			spin_unlock(&ksm_mmlist_lock);
+			return NULL;
+		}
+		/*
+		 * Although we tested list_empty() before, a racing __ksm_exit
+		 * of the last mm on the list may have removed it since then.
+		 */
+		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
+		if (slot == &ksm_mm_head) {
+			spin_unlock(&ksm_mmlist_lock);
+			return NULL;
+		}
+		ksm_scan.start = jiffies;
+		new_scan = 1;
+	}
+	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
+						struct mm_slot, mm_list);
+	ksm_scan.nr_active++;
+	slot->busy = 1;
+	spin_unlock(&ksm_mmlist_lock);
+
+	if (new_scan) {
 		/*
 		 * A number of pages can hang around indefinitely on per-cpu
 		 * pagevecs, raised page count preventing write_protect_page
@@ -1295,22 +1502,42 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		 * so we don't IPI too often when pages_to_scan is set low).
 		 */
 		lru_add_drain_all();
+	}
 
-		root_unstable_tree = RB_ROOT;
+	worker->mm_slot = slot;
+	worker->address = 0;
+	worker->rmap_list = &slot->rmap_list;
+	return slot;
+}
 
-		spin_lock(&ksm_mmlist_lock);
-		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
-		ksm_scan.mm_slot = slot;
-		spin_unlock(&ksm_mmlist_lock);
-		/*
-		 * Although we tested list_empty() above, a racing __ksm_exit
-		 * of the last mm on the list may have removed it since then.
-		 */
-		if (slot == &ksm_mm_head)
-			return NULL;
+static void ksm_put_mm_slot(struct ksm_worker *worker)
+{
+	spin_lock(&ksm_mmlist_lock);
+	worker->mm_slot->busy = 0;
+	worker->mm_slot = NULL;
+	if (!--ksm_scan.nr_active && ksm_scan.mm_slot == &ksm_mm_head)
+		ksm_scan_done();
+	spin_unlock(&ksm_mmlist_lock);
+}
+
+static struct rmap_item *scan_get_next_rmap_item(struct ksm_worker *worker,
+						 struct page **page)
+{
+	struct mm_struct *mm;
+	struct mm_slot *slot;
+	struct vm_area_struct *vma;
+	struct rmap_item *rmap_item;
+	struct rmap_item *stale = NULL;
+
+	if (list_empty(&ksm_mm_head.mm_list))
+		return NULL;
+
+	slot = worker->mm_slot;
+	if (!slot) {
 next_mm:
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		slot = ksm_get_mm_slot(worker);
+		if (!slot)
+			return NULL;
 	}
 
 	mm = slot->mm;
@@ -1318,60 +1545,59 @@ next_mm:
 	if (ksm_test_exit(mm))
 		vma = NULL;
 	else
-		vma = find_vma(mm, ksm_scan.address);
+		vma = find_vma(mm, worker->address);
 
 	for (; vma; vma = vma->vm_next) {
 		if (!(vma->vm_flags & VM_MERGEABLE))
 			continue;
-		if (ksm_scan.address < vma->vm_start)
-			ksm_scan.address = vma->vm_start;
+		if (worker->address < vma->vm_start)
+			worker->address = vma->vm_start;
 		if (!vma->anon_vma)
-			ksm_scan.address = vma->vm_end;
+			worker->address = vma->vm_end;
 
-		while (ksm_scan.address < vma->vm_end) {
+		while (worker->address < vma->vm_end) {
 			if (ksm_test_exit(mm))
 				break;
-			*page = follow_page(vma, ksm_scan.address, FOLL_GET);
+			*page = follow_page(vma, worker->address, FOLL_GET);
 			if (IS_ERR_OR_NULL(*page)) {
-				ksm_scan.address += PAGE_SIZE;
+				worker->address += PAGE_SIZE;
 				cond_resched();
 				continue;
 			}
 			if (PageAnon(*page) ||
 			    page_trans_compound_anon(*page)) {
-				flush_anon_page(vma, *page, ksm_scan.address);
+				flush_anon_page(vma, *page, worker->address);
 				flush_dcache_page(*page);
 				rmap_item = get_next_rmap_item(slot,
-					ksm_scan.rmap_list, ksm_scan.address);
+					worker->rmap_list, worker->address,
+					&stale);
 				if (rmap_item) {
-					ksm_scan.rmap_list =
+					worker->rmap_list =
 							&rmap_item->rmap_list;
-					ksm_scan.address += PAGE_SIZE;
+					worker->address += PAGE_SIZE;
 				} else
 					put_page(*page);
 				up_read(&mm->mmap_sem);
+				free_rmap_items(stale);
 				return rmap_item;
 			}
 			put_page(*page);
-			ksm_scan.address += PAGE_SIZE;
+			worker->address += PAGE_SIZE;
 			cond_resched();
 		}
 	}
 
 	if (ksm_test_exit(mm)) {
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		worker->address = 0;
+		worker->rmap_list = &slot->rmap_list;
 	}
 	/*
 	 * Nuke all the rmap_items that are above this current rmap:
 	 * because there were no VM_MERGEABLE vmas with such addresses.
 	 */
-	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
+	rmap_item = cut_trailing_rmap_items(worker->rmap_list);
 
-	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
-						struct mm_slot, mm_list);
-	if (ksm_scan.address == 0) {
+	if (worker->address == 0) {
 		/*
 		 * We've completed a full scan of all vmas, holding mmap_sem
 		 * throughout, and found no VM_MERGEABLE: so do the same as
@@ -1381,63 +1607,81 @@ next_mm:
 		 * or when all VM_MERGEABLE areas have been unmapped (and
 		 * mmap_sem then protects against race with MADV_MERGEABLE).
 		 */
+		spin_lock(&ksm_mmlist_lock);
 		hlist_del(&slot->link);
 		list_del(&slot->mm_list);
 		spin_unlock(&ksm_mmlist_lock);
 
-		free_mm_slot(slot);
 		clear_bit(MMF_VM_MERGEABLE, &mm->flags);
 		up_read(&mm->mmap_sem);
+		free_rmap_items(stale);
+		free_rmap_items(rmap_item);
+		ksm_put_mm_slot(worker);
+		free_mm_slot(slot);
 		mmdrop(mm);
 	} else {
-		spin_unlock(&ksm_mmlist_lock);
 		up_read(&mm->mmap_sem);
+		free_rmap_items(stale);
+		free_rmap_items(rmap_item);
+		ksm_put_mm_slot(worker);
 	}
 
 	/* Repeat until we've completed scanning the whole list */
-	slot = ksm_scan.mm_slot;
-	if (slot != &ksm_mm_head)
-		goto next_mm;
-
-	ksm_scan.seqnr++;
-	return NULL;
+	goto next_mm;
 }
 
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
+ * @worker - the ksmd thread doing the scan.
  * @scan_npages - number of pages we want to scan before we return.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static void ksm_do_scan(struct ksm_worker *worker, unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
+		rmap_item = scan_get_next_rmap_item(worker, &page);
 		if (!rmap_item)
 			return;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
-			cmp_and_merge_page(page, rmap_item);
+			cmp_and_merge_page(worker, page, rmap_item);
 		put_page(page);
+		worker->pages_scanned++;
 	}
 }
 
+/*
+ * A ksmd thread being stopped gives back its mm_slot.  The rmap_items
+ * it has not reached yet are dropped rather than left for the next full
+ * scan, which would find them two scans old.
+ */
+static void ksm_stop_scan(struct ksm_worker *worker)
+{
+	if (!worker->mm_slot)
+		return;
+	free_rmap_items(cut_trailing_rmap_items(worker->rmap_list));
+	ksm_put_mm_slot(worker);
+}
+
 static int ksmd_should_run(void)
 {
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
-static int ksm_scan_thread(void *nothing)
+static int ksm_scan_thread(void *data)
 {
+	struct ksm_worker *worker = data;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
-		mutex_lock(&ksm_thread_mutex);
+		down_read(&ksm_scan_sem);
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
-		mutex_unlock(&ksm_thread_mutex);
+			ksm_do_scan(worker, ksm_thread_pages_to_scan);
+		up_read(&ksm_scan_sem);
 
 		try_to_freeze();
 
@@ -1449,9 +1693,46 @@ static int ksm_scan_thread(void *nothing)
 				ksmd_should_run() || kthread_should_stop());
 		}
 	}
+
+	down_read(&ksm_scan_sem);
+	ksm_stop_scan(worker);
+	up_read(&ksm_scan_sem);
 	return 0;
 }
 
+/*
+ * Start or stop ksmd threads until nr are running.  Called with
+ * ksm_thread_mutex held.
+ */
+static int ksm_set_nr_threads(unsigned int nr)
+{
+	struct ksm_worker *worker;
+	int err = 0;
+
+	while (ksm_nr_threads < nr) {
+		worker = &ksm_workers[ksm_nr_threads];
+		if (ksm_nr_threads)
+			worker->task = kthread_run(ksm_scan_thread, worker,
+						   "ksmd/%u", ksm_nr_threads);
+		else
+			worker->task = kthread_run(ksm_scan_thread, worker,
+						   "ksmd");
+		if (IS_ERR(worker->task)) {
+			err = PTR_ERR(worker->task);
+			worker->task = NULL;
+			break;
+		}
+		ksm_nr_threads++;
+	}
+
+	while (ksm_nr_threads > nr) {
+		worker = &ksm_workers[--ksm_nr_threads];
+		kthread_stop(worker->task);
+		worker->task = NULL;
+	}
+	return err;
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1534,7 +1815,8 @@ void __ksm_exit(struct mm_struct *mm)
 	/*
 	 * This process is exiting: if it's straightforward (as is the
 	 * case when ksmd was never running), free mm_slot immediately.
-	 * But if it's at the cursor or has rmap_items linked to it, use
+	 * But if it's at the cursor, being scanned, or has rmap_items
+	 * linked to it, use
 	 * mmap_sem to synchronize with any break_cows before pagetables
 	 * are freed, and leave the mm_slot on the list for ksmd to free.
 	 * Beware: ksm may already have noticed it exiting and freed the slot.
@@ -1542,7 +1824,7 @@ void __ksm_exit(struct mm_struct *mm)
 
 	spin_lock(&ksm_mmlist_lock);
 	mm_slot = get_mm_slot(mm);
-	if (mm_slot && ksm_scan.mm_slot != mm_slot) {
+	if (mm_slot && ksm_scan.mm_slot != mm_slot && !mm_slot->busy) {
 		if (!mm_slot->rmap_list) {
 			hlist_del(&mm_slot->link);
 			list_del(&mm_slot->mm_list);
@@ -1760,12 +2042,13 @@ void ksm_migrate_page(struct page *newpage, struct page *oldpage)
 #endif /* CONFIG_MIGRATION */
 
 #ifdef CONFIG_MEMORY_HOTREMOVE
-static struct stable_node *ksm_check_stable_tree(unsigned long start_pfn,
+static struct stable_node *ksm_check_stable_tree(struct ksm_tree *tree,
+						 unsigned long start_pfn,
 						 unsigned long end_pfn)
 {
 	struct rb_node *node;
 
-	for (node = rb_first(&root_stable_tree); node; node = rb_next(node)) {
+	for (node = rb_first(&tree->stable); node; node = rb_next(node)) {
 		struct stable_node *stable_node;
 
 		stable_node = rb_entry(node, struct stable_node, node);
@@ -1781,19 +2064,20 @@ static int ksm_memory_callback(struct notifier_block *self,
 {
 	struct memory_notify *mn = arg;
 	struct stable_node *stable_node;
+	struct ksm_tree *tree;
 
 	switch (action) {
 	case MEM_GOING_OFFLINE:
 		/*
 		 * Keep it very simple for now: just lock out ksmd and
 		 * MADV_UNMERGEABLE while any memory is going offline.
-		 * mutex_lock_nested() is necessary because lockdep was alarmed
-		 * that here we take ksm_thread_mutex inside notifier chain
+		 * down_write_nested() is necessary because lockdep was alarmed
+		 * that here we take ksm_scan_sem inside notifier chain
 		 * mutex, and later take notifier chain mutex inside
-		 * ksm_thread_mutex to unlock it.   But that's safe because both
+		 * ksm_scan_sem to unlock it.   But that's safe because both
 		 * are inside mem_hotplug_mutex.
 		 */
-		mutex_lock_nested(&ksm_thread_mutex, SINGLE_DEPTH_NESTING);
+		down_write_nested(&ksm_scan_sem, SINGLE_DEPTH_NESTING);
 		break;
 
 	case MEM_OFFLINE:
@@ -1802,13 +2086,19 @@ static int ksm_memory_callback(struct notifier_block *self,
 		 * be a few stable_nodes left over, still pointing to struct
 		 * pages which have been offlined: prune those from the tree.
 		 */
-		while ((stable_node = ksm_check_stable_tree(mn->start_pfn,
+		for (tree = ksm_trees; tree < ksm_trees + KSM_TREE_BUCKETS;
+		     tree++) {
+			mutex_lock(&tree->lock);
+			while ((stable_node = ksm_check_stable_tree(tree,
+					mn->start_pfn,
 					mn->start_pfn + mn->nr_pages)) != NULL)
-			remove_node_from_stable_tree(stable_node);
+				remove_node_from_stable_tree(stable_node, tree);
+			mutex_unlock(&tree->lock);
+		}
 		/* fallthrough */
 
 	case MEM_CANCEL_OFFLINE:
-		mutex_unlock(&ksm_thread_mutex);
+		up_write(&ksm_scan_sem);
 		break;
 	}
 	return NOTIFY_OK;
@@ -1897,7 +2187,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 	 * on the list for when ksmd may be set running again).
 	 */
 
-	mutex_lock(&ksm_thread_mutex);
+	down_write(&ksm_scan_sem);
 	if (ksm_run != flags) {
 		ksm_run = flags;
 		if (flags & KSM_RUN_UNMERGE) {
@@ -1912,7 +2202,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 			}
 		}
 	}
-	mutex_unlock(&ksm_thread_mutex);
+	up_write(&ksm_scan_sem);
 
 	if (flags & KSM_RUN_MERGE)
 		wake_up_interruptible(&ksm_thread_wait);
@@ -1921,24 +2211,49 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 KSM_ATTR(run);
 
+static ssize_t nr_threads_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_nr_threads);
+}
+
+static ssize_t nr_threads_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long nr;
+	int err;
+
+	err = strict_strtoul(buf, 10, &nr);
+	if (err || nr < 1 || nr > KSM_MAX_THREADS)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	err = ksm_set_nr_threads(nr);
+	mutex_unlock(&ksm_thread_mutex);
+
+	return err ? err : count;
+}
+KSM_ATTR(nr_threads);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_pages_shared);
+	return sprintf(buf, "%ld\n", atomic_long_read(&ksm_pages_shared));
 }
 KSM_ATTR_RO(pages_shared);
 
 static ssize_t pages_sharing_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_pages_sharing);
+	return sprintf(buf, "%ld\n", atomic_long_read(&ksm_pages_sharing));
 }
 KSM_ATTR_RO(pages_sharing);
 
 static ssize_t pages_unshared_show(struct kobject *kobj,
 				   struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_pages_unshared);
+	return sprintf(buf, "%ld\n", atomic_long_read(&ksm_pages_unshared));
 }
 KSM_ATTR_RO(pages_unshared);
 
@@ -1947,8 +2262,10 @@ static ssize_t pages_volatile_show(struct kobject *kobj,
 {
 	long ksm_pages_volatile;
 
-	ksm_pages_volatile = ksm_rmap_items - ksm_pages_shared
-				- ksm_pages_sharing - ksm_pages_unshared;
+	ksm_pages_volatile = atomic_long_read(&ksm_rmap_items)
+				- atomic_long_read(&ksm_pages_shared)
+				- atomic_long_read(&ksm_pages_sharing)
+				- atomic_long_read(&ksm_pages_unshared);
 	/*
 	 * It was not worth any locking to calculate that statistic,
 	 * but it might therefore sometimes be negative: conceal that.
@@ -1966,15 +2283,58 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	unsigned long scanned = 0;
+	int i;
+
+	for (i = 0; i < KSM_MAX_THREADS; i++)
+		scanned += ksm_workers[i].pages_scanned;
+	return sprintf(buf, "%lu\n", scanned);
+}
+KSM_ATTR_RO(pages_scanned);
+
+static ssize_t pages_merged_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	unsigned long merged = 0;
+	int i;
+
+	for (i = 0; i < KSM_MAX_THREADS; i++)
+		merged += ksm_workers[i].pages_merged;
+	return sprintf(buf, "%lu\n", merged);
+}
+KSM_ATTR_RO(pages_merged);
+
+static ssize_t pages_per_second_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_scan_rate);
+}
+KSM_ATTR_RO(pages_per_second);
+
+static ssize_t merges_per_second_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_merge_rate);
+}
+KSM_ATTR_RO(merges_per_second);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
+	&nr_threads_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_scanned_attr.attr,
+	&pages_merged_attr.attr,
+	&pages_per_second_attr.attr,
+	&merges_per_second_attr.attr,
 	NULL,
 };
 
@@ -1986,17 +2346,21 @@ static struct attribute_group ksm_attr_group = {
 
 static int __init ksm_init(void)
 {
-	struct task_struct *ksm_thread;
 	int err;
+	int i;
 
 	err = ksm_slab_init();
 	if (err)
 		goto out;
 
-	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
-	if (IS_ERR(ksm_thread)) {
+	for (i = 0; i < KSM_TREE_BUCKETS; i++)
+		mutex_init(&ksm_trees[i].lock);
+
+	mutex_lock(&ksm_thread_mutex);
+	err = ksm_set_nr_threads(1);
+	mutex_unlock(&ksm_thread_mutex);
+	if (err) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
-		err = PTR_ERR(ksm_thread);
 		goto out_free;
 	}
 
@@ -2004,7 +2368,9 @@ static int __init ksm_init(void)
 	err = sysfs_create_group(mm_kobj, &ksm_attr_group);
 	if (err) {
 		printk(KERN_ERR "ksm: register sysfs failed\n");
-		kthread_stop(ksm_thread);
+		mutex_lock(&ksm_thread_mutex);
+		ksm_set_nr_threads(0);
+		mutex_unlock(&ksm_thread_mutex);
 		goto out_free;
 	}
 #else
@@ -2014,7 +2380,7 @@ static int __init ksm_init(void)
 
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/*
-	 * Choose a high priority since the callback takes ksm_thread_mutex:
+	 * Choose a high priority since the callback takes ksm_scan_sem:
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
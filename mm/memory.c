@@ -3549,6 +3549,10 @@ retry:
 					goto retry;
 				return ret;
 			}
+			if (!pmd_trans_splitting(orig_pmd))
+				huge_pmd_set_accessed(mm, vma, address, pmd,
+						      orig_pmd,
+						      flags & FAULT_FLAG_WRITE);
 			return 0;
 		}
 	}
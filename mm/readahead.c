@@ -17,6 +17,10 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -562,3 +566,331 @@ page_cache_async_readahead(struct address_space *mapping,
 	ondemand_readahead(mapping, ra, filp, true, offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+/*
+ * Readahead footprints.
+ *
+ * Application start-up faults in scattered pages of its executables and
+ * data files (dex/oat files, the central directory of a zip...), a page
+ * at a time, with no pattern that readahead above could follow.  While
+ * recording is switched on, the pages faulted in each file are noted as
+ * a list of extents, keyed by device and inode number so that it outlives
+ * the inode.  Later, the first fault which misses in such a file reads the
+ * whole footprint in a few large requests.
+ */
+#define RA_FP_HASH_BITS		8
+#define RA_FP_MAX_FILES		512
+#define RA_FP_MAX_EXTENTS	64
+#define RA_FP_GAP		8	/* holes read through when replaying */
+#define RA_FP_INTERVAL		(10 * HZ)	/* between replays of a file */
+
+struct ra_extent {
+	pgoff_t start;
+	pgoff_t end;
+};
+
+struct ra_footprint {
+	struct hlist_node hash;
+	atomic_t count;
+	dev_t dev;
+	unsigned long ino;
+	unsigned long replayed;		/* jiffies of the last replay */
+	unsigned int nr_extents;
+	struct ra_extent extents[RA_FP_MAX_EXTENTS];
+};
+
+static struct hlist_head ra_fp_hash[1 << RA_FP_HASH_BITS];
+static DEFINE_SPINLOCK(ra_fp_lock);
+static unsigned int ra_fp_nr;
+static unsigned long ra_fp_replays;
+
+#define RA_FP_STOP	0
+#define RA_FP_RECORD	1
+#define RA_FP_DROP	2
+static unsigned int ra_fp_record;
+
+static struct hlist_head *ra_fp_bucket(dev_t dev, unsigned long ino)
+{
+	return &ra_fp_hash[hash_long(ino ^ dev, RA_FP_HASH_BITS)];
+}
+
+static struct ra_footprint *ra_fp_lookup(dev_t dev, unsigned long ino)
+{
+	struct ra_footprint *fp;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(fp, node, ra_fp_bucket(dev, ino), hash) {
+		if (fp->dev == dev && fp->ino == ino)
+			return fp;
+	}
+	return NULL;
+}
+
+static void ra_fp_put(struct ra_footprint *fp)
+{
+	if (atomic_dec_and_test(&fp->count))
+		kfree(fp);
+}
+
+/*
+ * Add a page to the footprint, keeping the extents sorted and merged.
+ * Once they are all used up, the nearest extent is stretched instead.
+ */
+static void ra_fp_add(struct ra_footprint *fp, pgoff_t index)
+{
+	struct ra_extent *ext = fp->extents;
+	unsigned int i;
+
+	for (i = 0; i < fp->nr_extents; i++) {
+		if (index + 1 < ext[i].start)
+			break;
+		if (index > ext[i].end)
+			continue;
+		if (index < ext[i].start) {
+			ext[i].start = index;
+		} else if (index == ext[i].end) {
+			ext[i].end++;
+			if (i + 1 < fp->nr_extents &&
+			    ext[i].end == ext[i + 1].start) {
+				ext[i].end = ext[i + 1].end;
+				fp->nr_extents--;
+				memmove(&ext[i + 1], &ext[i + 2],
+					(fp->nr_extents - i - 1) * sizeof(*ext));
+			}
+		}
+		return;
+	}
+
+	if (fp->nr_extents == RA_FP_MAX_EXTENTS) {
+		if (i == 0)
+			ext[0].start = index;
+		else if (i == fp->nr_extents ||
+			 index - ext[i - 1].end < ext[i].start - index)
+			ext[i - 1].end = index + 1;
+		else
+			ext[i].start = index;
+		return;
+	}
+
+	memmove(&ext[i + 1], &ext[i], (fp->nr_extents - i) * sizeof(*ext));
+	ext[i].start = index;
+	ext[i].end = index + 1;
+	fp->nr_extents++;
+}
+
+static void ra_fp_record_fault(struct inode *inode, pgoff_t offset)
+{
+	struct ra_footprint *fp, *new = NULL;
+
+	spin_lock(&ra_fp_lock);
+	fp = ra_fp_lookup(inode->i_sb->s_dev, inode->i_ino);
+	if (!fp && ra_fp_nr < RA_FP_MAX_FILES) {
+		spin_unlock(&ra_fp_lock);
+		new = kzalloc(sizeof(*new), GFP_NOFS | __GFP_NOWARN);
+		if (!new)
+			return;
+		atomic_set(&new->count, 1);
+		new->dev = inode->i_sb->s_dev;
+		new->ino = inode->i_ino;
+
+		spin_lock(&ra_fp_lock);
+		fp = ra_fp_lookup(new->dev, new->ino);
+		if (!fp && ra_fp_nr < RA_FP_MAX_FILES) {
+			hlist_add_head(&new->hash,
+				       ra_fp_bucket(new->dev, new->ino));
+			ra_fp_nr++;
+			fp = new;
+			new = NULL;
+		}
+	}
+	if (fp)
+		ra_fp_add(fp, offset);
+	spin_unlock(&ra_fp_lock);
+	kfree(new);
+}
+
+/*
+ * Read in the footprint, running extents less than RA_FP_GAP pages apart
+ * together, all under one plug so that the block layer sees it at once.
+ */
+static void ra_fp_replay(struct ra_footprint *fp,
+			 struct address_space *mapping, struct file *file)
+{
+	struct blk_plug plug;
+	pgoff_t start, end;
+	unsigned int i = 0;
+
+	blk_start_plug(&plug);
+	for (;;) {
+		spin_lock(&ra_fp_lock);
+		if (i >= fp->nr_extents) {
+			spin_unlock(&ra_fp_lock);
+			break;
+		}
+		start = fp->extents[i].start;
+		end = fp->extents[i].end;
+		while (++i < fp->nr_extents &&
+		       fp->extents[i].start - end <= RA_FP_GAP)
+			end = fp->extents[i].end;
+		spin_unlock(&ra_fp_lock);
+
+		force_page_cache_readahead(mapping, file, start, end - start);
+	}
+	blk_finish_plug(&plug);
+}
+
+/**
+ * ra_footprint_fault - note a page fault for readahead footprints
+ * @file: the file faulted on
+ * @offset: the page index faulted on
+ * @miss: the page was not in the page cache
+ *
+ * Records the page while footprints are being recorded, and replays the
+ * footprint of the file, if it has one, on the first miss in a while.
+ */
+void ra_footprint_fault(struct file *file, pgoff_t offset, int miss)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct ra_footprint *fp;
+
+	if (ra_fp_record == RA_FP_RECORD)
+		ra_fp_record_fault(inode, offset);
+
+	if (!miss || !ra_fp_nr)
+		return;
+
+	spin_lock(&ra_fp_lock);
+	fp = ra_fp_lookup(inode->i_sb->s_dev, inode->i_ino);
+	if (fp && fp->replayed &&
+	    time_before(jiffies, fp->replayed + RA_FP_INTERVAL))
+		fp = NULL;
+	if (fp) {
+		fp->replayed = jiffies ? jiffies : 1;
+		atomic_inc(&fp->count);
+		ra_fp_replays++;
+	}
+	spin_unlock(&ra_fp_lock);
+
+	if (fp) {
+		ra_fp_replay(fp, mapping, file);
+		ra_fp_put(fp);
+	}
+}
+
+#ifdef CONFIG_SYSFS
+static void ra_fp_drop_all(void)
+{
+	struct ra_footprint *fp;
+	struct hlist_node *node, *tmp;
+	int i;
+
+	spin_lock(&ra_fp_lock);
+	for (i = 0; i < ARRAY_SIZE(ra_fp_hash); i++) {
+		hlist_for_each_entry_safe(fp, node, tmp, &ra_fp_hash[i], hash) {
+			hlist_del(&fp->hash);
+			ra_fp_put(fp);
+		}
+	}
+	ra_fp_nr = 0;
+	spin_unlock(&ra_fp_lock);
+}
+
+static ssize_t footprint_record_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_fp_record);
+}
+
+static ssize_t footprint_record_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > RA_FP_DROP)
+		return -EINVAL;
+
+	/*
+	 * RA_FP_RECORD starts recording footprints, RA_FP_STOP stops it
+	 * and keeps them for replay, RA_FP_DROP stops it and forgets them.
+	 */
+	if (val == RA_FP_DROP) {
+		ra_fp_record = RA_FP_STOP;
+		ra_fp_drop_all();
+	} else
+		ra_fp_record = val;
+
+	return count;
+}
+
+static struct kobj_attribute footprint_record_attr =
+	__ATTR(footprint_record, 0644, footprint_record_show,
+	       footprint_record_store);
+
+static ssize_t footprint_files_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ra_fp_nr);
+}
+
+static struct kobj_attribute footprint_files_attr =
+	__ATTR_RO(footprint_files);
+
+static ssize_t footprint_pages_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	struct ra_footprint *fp;
+	struct hlist_node *node;
+	unsigned long pages = 0;
+	unsigned int i, j;
+
+	spin_lock(&ra_fp_lock);
+	for (i = 0; i < ARRAY_SIZE(ra_fp_hash); i++) {
+		hlist_for_each_entry(fp, node, &ra_fp_hash[i], hash) {
+			for (j = 0; j < fp->nr_extents; j++)
+				pages += fp->extents[j].end -
+					 fp->extents[j].start;
+		}
+	}
+	spin_unlock(&ra_fp_lock);
+
+	return sprintf(buf, "%lu\n", pages);
+}
+
+static struct kobj_attribute footprint_pages_attr =
+	__ATTR_RO(footprint_pages);
+
+static ssize_t footprint_replays_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ra_fp_replays);
+}
+
+static struct kobj_attribute footprint_replays_attr =
+	__ATTR_RO(footprint_replays);
+
+static struct attribute *readahead_attrs[] = {
+	&footprint_record_attr.attr,
+	&footprint_files_attr.attr,
+	&footprint_pages_attr.attr,
+	&footprint_replays_attr.attr,
+	NULL,
+};
+
+static struct attribute_group readahead_attr_group = {
+	.attrs = readahead_attrs,
+	.name = "readahead",
+};
+
+static int __init readahead_sysfs_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &readahead_attr_group);
+	if (err)
+		printk(KERN_ERR "readahead: register sysfs failed\n");
+	return err;
+}
+module_init(readahead_sysfs_init)
+#endif /* CONFIG_SYSFS */
@@ -1182,6 +1182,7 @@ static struct page *shmem_swapin(swp_entry_t entry, gfp_t gfp,
 	struct page *page;
 
 	/* Create a pseudo vma that just contains the policy */
+	pvma.vm_mm = NULL;
 	pvma.vm_start = 0;
 	pvma.vm_pgoff = idx;
 	pvma.vm_ops = NULL;
@@ -37,7 +37,22 @@
 /* How many pages do we try to swap or page in/out together? */
 int page_cluster;
 
-static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
+/*
+ * Pages on their way onto the LRU are gathered per cpu and added under a
+ * single lru_lock hold.  A pagevec's worth is enough while the lock is
+ * quiet.  Each flush that finds the lock contended doubles the batch, up
+ * to LRU_ADD_BATCH, and each uncontended one halves it again.
+ */
+#define LRU_ADD_MAX_SHIFT	2
+#define LRU_ADD_BATCH		(PAGEVEC_SIZE << LRU_ADD_MAX_SHIFT)
+
+struct lru_add_batch {
+	unsigned int nr;
+	unsigned int shift;	/* flush at PAGEVEC_SIZE << shift pages */
+	struct page *pages[LRU_ADD_BATCH];
+};
+
+static DEFINE_PER_CPU(struct lru_add_batch[NR_LRU_LISTS], lru_add_batches);
 static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
 static DEFINE_PER_CPU(struct pagevec, lru_deactivate_pvecs);
 
@@ -202,30 +217,49 @@ void put_pages_list(struct list_head *pages)
 }
 EXPORT_SYMBOL(put_pages_list);
 
-static void pagevec_lru_move_fn(struct pagevec *pvec,
-				void (*move_fn)(struct page *page, void *arg),
-				void *arg)
+/*
+ * Apply @move_fn to each page under its zone's lru_lock, then drop the
+ * references the batch held.  Returns true if any of the lru_locks had
+ * to be waited for.
+ */
+static bool lru_move_pages(struct page **pages, int nr, int cold,
+			   void (*move_fn)(struct page *page, void *arg),
+			   void *arg)
 {
 	int i;
 	struct zone *zone = NULL;
 	unsigned long flags = 0;
+	bool contended = false;
 
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
 		struct zone *pagezone = page_zone(page);
 
 		if (pagezone != zone) {
 			if (zone)
 				spin_unlock_irqrestore(&zone->lru_lock, flags);
 			zone = pagezone;
-			spin_lock_irqsave(&zone->lru_lock, flags);
+			if (!spin_trylock_irqsave(&zone->lru_lock, flags)) {
+				contended = true;
+				spin_lock_irqsave(&zone->lru_lock, flags);
+			}
 		}
 
 		(*move_fn)(page, arg);
 	}
 	if (zone)
 		spin_unlock_irqrestore(&zone->lru_lock, flags);
-	release_pages(pvec->pages, pvec->nr, pvec->cold);
+	release_pages(pages, nr, cold);
+
+	return contended;
+}
+
+static void pagevec_lru_move_fn(struct pagevec *pvec,
+				void (*move_fn)(struct page *page, void *arg),
+				void *arg)
+{
+	lru_move_pages(pvec->pages, pagevec_count(pvec), pvec->cold,
+		       move_fn, arg);
 	pagevec_reinit(pvec);
 }
 
@@ -371,14 +405,18 @@ void mark_page_accessed(struct page *page)
 
 EXPORT_SYMBOL(mark_page_accessed);
 
+static void lru_add_batch_flush(struct lru_add_batch *batch,
+				enum lru_list lru);
+
 void __lru_cache_add(struct page *page, enum lru_list lru)
 {
-	struct pagevec *pvec = &get_cpu_var(lru_add_pvecs)[lru];
+	struct lru_add_batch *batch = &get_cpu_var(lru_add_batches)[lru];
 
 	page_cache_get(page);
-	if (!pagevec_add(pvec, page))
-		____pagevec_lru_add(pvec, lru);
-	put_cpu_var(lru_add_pvecs);
+	batch->pages[batch->nr++] = page;
+	if (batch->nr >= PAGEVEC_SIZE << batch->shift)
+		lru_add_batch_flush(batch, lru);
+	put_cpu_var(lru_add_batches);
 }
 EXPORT_SYMBOL(__lru_cache_add);
 
@@ -497,14 +535,15 @@ static void lru_deactivate_fn(struct page *page, void *arg)
  */
 static void drain_cpu_pagevecs(int cpu)
 {
-	struct pagevec *pvecs = per_cpu(lru_add_pvecs, cpu);
+	struct lru_add_batch *batches = per_cpu(lru_add_batches, cpu);
 	struct pagevec *pvec;
 	int lru;
 
 	for_each_lru(lru) {
-		pvec = &pvecs[lru - LRU_BASE];
-		if (pagevec_count(pvec))
-			____pagevec_lru_add(pvec, lru);
+		struct lru_add_batch *batch = &batches[lru - LRU_BASE];
+
+		if (batch->nr)
+			lru_add_batch_flush(batch, lru);
 	}
 
 	pvec = &per_cpu(lru_rotate_pvecs, cpu);
@@ -575,7 +614,8 @@ int lru_add_drain_all(void)
  * free it.
  *
  * Avoid taking zone->lru_lock if possible, but if it is taken, retain it
- * for the remainder of the operation.
+ * for up to SWAP_CLUSTER_MAX pages.  The pages are only handed back to the
+ * allocator once the lock has been dropped.
  *
  * The locking in this function is against shrink_inactive_list(): we recheck
  * the page count inside the lock to see whether shrink_inactive_list()
@@ -585,11 +625,11 @@ int lru_add_drain_all(void)
 void release_pages(struct page **pages, int nr, int cold)
 {
 	int i;
-	struct pagevec pages_to_free;
+	LIST_HEAD(pages_to_free);
 	struct zone *zone = NULL;
 	unsigned long uninitialized_var(flags);
+	unsigned int lock_batch = 0;
 
-	pagevec_init(&pages_to_free, cold);
 	for (i = 0; i < nr; i++) {
 		struct page *page = pages[i];
 
@@ -602,6 +642,12 @@ void release_pages(struct page **pages, int nr, int cold)
 			continue;
 		}
 
+		/* Don't keep interrupts off for too long */
+		if (zone && ++lock_batch == SWAP_CLUSTER_MAX) {
+			spin_unlock_irqrestore(&zone->lru_lock, flags);
+			zone = NULL;
+		}
+
 		if (!put_page_testzero(page))
 			continue;
 
@@ -612,6 +658,7 @@ void release_pages(struct page **pages, int nr, int cold)
 				if (zone)
 					spin_unlock_irqrestore(&zone->lru_lock,
 									flags);
+				lock_batch = 0;
 				zone = pagezone;
 				spin_lock_irqsave(&zone->lru_lock, flags);
 			}
@@ -620,22 +667,37 @@ void release_pages(struct page **pages, int nr, int cold)
 			del_page_from_lru(zone, page);
 		}
 
-		if (!pagevec_add(&pages_to_free, page)) {
-			if (zone) {
-				spin_unlock_irqrestore(&zone->lru_lock, flags);
-				zone = NULL;
-			}
-			__pagevec_free(&pages_to_free);
-			pagevec_reinit(&pages_to_free);
-  		}
+		list_add(&page->lru, &pages_to_free);
 	}
 	if (zone)
 		spin_unlock_irqrestore(&zone->lru_lock, flags);
 
-	pagevec_free(&pages_to_free);
+	free_page_list(&pages_to_free, cold);
 }
 EXPORT_SYMBOL(release_pages);
 
+/*
+ * Hand a list of pages, already off the LRU and with no references left,
+ * back to the page allocator.  Called without any lru_lock held.
+ */
+void free_page_list(struct list_head *list, int cold)
+{
+	struct pagevec pvec;
+	struct page *page, *tmp;
+
+	pagevec_init(&pvec, cold);
+
+	list_for_each_entry_safe(page, tmp, list, lru) {
+		list_del(&page->lru);
+		if (!pagevec_add(&pvec, page)) {
+			__pagevec_free(&pvec);
+			pagevec_reinit(&pvec);
+		}
+	}
+
+	pagevec_free(&pvec);
+}
+
 /*
  * The pages which we're about to release may be in the deferred lru-addition
  * queues.  That would prevent them from really being freed right now.  That's
@@ -723,22 +785,18 @@ void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
 
 EXPORT_SYMBOL(____pagevec_lru_add);
 
-/*
- * Try to drop buffers from the pages in a pagevec
- */
-void pagevec_strip(struct pagevec *pvec)
+static void lru_add_batch_flush(struct lru_add_batch *batch,
+				enum lru_list lru)
 {
-	int i;
-
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
+	VM_BUG_ON(is_unevictable_lru(lru));
 
-		if (page_has_private(page) && trylock_page(page)) {
-			if (page_has_private(page))
-				try_to_release_page(page, 0);
-			unlock_page(page);
-		}
-	}
+	if (lru_move_pages(batch->pages, batch->nr, 0,
+			   ____pagevec_lru_add_fn, (void *)lru)) {
+		if (batch->shift < LRU_ADD_MAX_SHIFT)
+			batch->shift++;
+	} else if (batch->shift)
+		batch->shift--;
+	batch->nr = 0;
 }
 
 /**
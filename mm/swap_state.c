@@ -54,6 +54,13 @@ static struct {
 	unsigned long find_total;
 } swap_cache_info;
 
+/*
+ * Pages brought in by readahead are marked PageReadahead until a fault
+ * finds them in the swap cache.  The hits seen since the last readahead
+ * size the next window: see swapin_nr_pages().
+ */
+static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
+
 void show_swap_cache_info(void)
 {
 	printk("%lu pages in swap cache\n", total_swapcache_pages);
@@ -266,8 +273,13 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			atomic_inc(&swapin_readahead_hits);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -279,12 +291,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, bool *allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -351,6 +365,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -368,19 +383,167 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+}
+
+/*
+ * Start reading one readahead page, marking it if we had to read it.
+ * Returns false if the swap entry could not be read.
+ */
+static bool swapin_readahead_one(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+	bool allocated;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+	if (!page)
+		return false;
+	if (allocated) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+	return true;
+}
+
+/*
+ * Size the readahead window for a fault at pos, a swap offset or a virtual
+ * page number: two more than the readahead hits since last time, rounded
+ * up to a power of two and capped at (1 << page_cluster).  With no hits,
+ * only a fault next to the previous one reads more than the one page.
+ * The window is not allowed to shrink by more than half at a time.
+ */
+static unsigned int swapin_nr_pages(unsigned long pos, unsigned long *prev_pos)
+{
+	static atomic_t last_readahead_pages;
+	unsigned int max_pages = 1 << page_cluster;
+	unsigned int pages, last_ra;
+
+	if (max_pages <= 1)
+		return 1;
+
+	pages = atomic_xchg(&swapin_readahead_hits, 0) + 2;
+	if (pages == 2) {
+		if (pos != *prev_pos + 1 && pos != *prev_pos - 1)
+			pages = 1;
+	} else
+		pages = roundup_pow_of_two(pages);
+	*prev_pos = pos;
+
+	if (pages > max_pages)
+		pages = max_pages;
+
+	last_ra = atomic_read(&last_readahead_pages) / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+	atomic_set(&last_readahead_pages, pages);
+
+	return pages;
+}
+
+static pmd_t *swapin_readahead_pmd(struct mm_struct *mm, unsigned long addr)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, addr);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		return NULL;
+	pud = pud_offset(pgd, addr);
+	if (pud_none(*pud) || pud_bad(*pud))
+		return NULL;
+	pmd = pmd_offset(pud, addr);
+	if (pmd_none(*pmd) || pmd_trans_huge(*pmd) || pmd_bad(*pmd))
+		return NULL;
+	return pmd;
+}
+
+/*
+ * Readahead along the vma: after a long uptime, neighbours in the swap
+ * area rarely belong together, but neighbours in the address space often
+ * do.  So read the swap entries found in the ptes around addr, limited
+ * to the vma and to the page table which maps addr.
+ */
+static struct page *swapin_readahead_vma(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	static unsigned long prev_fault;
+	unsigned long fpfn = addr >> PAGE_SHIFT;
+	unsigned long prev = prev_fault;
+	unsigned long lo, hi, start, end, pfn;
+	unsigned int win;
+	pmd_t *pmd;
+
+	win = swapin_nr_pages(fpfn, &prev_fault);
+	if (win <= 1)
+		goto out;
+	pmd = swapin_readahead_pmd(vma->vm_mm, addr);
+	if (!pmd)
+		goto out;
+
+	/*
+	 * Read ahead in the direction the faults are moving in, or around
+	 * addr if they are not moving steadily.
+	 */
+	if (fpfn == prev + 1) {
+		start = fpfn;
+		end = fpfn + win;
+	} else if (fpfn == prev - 1) {
+		start = fpfn + 1 > win ? fpfn + 1 - win : 0;
+		end = fpfn + 1;
+	} else {
+		start = fpfn > win / 2 ? fpfn - win / 2 : 0;
+		end = start + win;
+	}
+	lo = max(vma->vm_start, addr & PMD_MASK) >> PAGE_SHIFT;
+	hi = min(vma->vm_end, (addr & PMD_MASK) + PMD_SIZE) >> PAGE_SHIFT;
+	start = max(start, lo);
+	end = min(end, hi);
+
+	for (pfn = start; pfn < end; pfn++) {
+		unsigned long ra_addr = pfn << PAGE_SHIFT;
+		swp_entry_t ra_entry;
+		pte_t *pte, ptent;
+
+		if (pfn == fpfn)
+			continue;
+		pte = pte_offset_map(pmd, ra_addr);
+		ptent = *pte;
+		pte_unmap(pte);
+		if (!is_swap_pte(ptent))
+			continue;
+		ra_entry = pte_to_swp_entry(ptent);
+		if (non_swap_entry(ra_entry))
+			continue;
+		swapin_readahead_one(ra_entry, gfp_mask, vma, ra_addr);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+out:
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
  * @gfp_mask: memory allocation flags
- * @vma: user vma this address belongs to
+ * @vma: user vma this address belongs to, or a pseudo-vma with no vm_mm
  * @addr: target address for mempolicy
  *
  * Returns the struct page for entry and addr, after queueing swapin.
  *
- * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * For a user vma, the swap entries mapped next to addr are read: see
+ * swapin_readahead_vma().  Otherwise we simply read an aligned block of
+ * entries in the swap area. This method is chosen because it doesn't
+ * cost us any seek time.  We also make sure to queue the 'original'
+ * request together with the readahead ones...  Either way the window
+ * grows and shrinks with the readahead hits, up to (1 << page_cluster).
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -390,10 +553,14 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
+	static unsigned long prev_offset;
 	int nr_pages;
-	struct page *page;
 	unsigned long offset;
 	unsigned long end_offset;
+	unsigned int win;
+
+	if (vma && vma->vm_mm)
+		return swapin_readahead_vma(entry, gfp_mask, vma, addr);
 
 	/*
 	 * Get starting offset for readaround, and number of pages to read.
@@ -402,14 +569,15 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 * more likely that neighbouring swap pages came from the same node:
 	 * so use the same "addr" to choose the same node for each swap read.
 	 */
-	nr_pages = valid_swaphandles(entry, &offset);
+	win = swapin_nr_pages(swp_offset(entry), &prev_offset);
+	nr_pages = valid_swaphandles(entry, &offset, ilog2(win));
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		if (offset == swp_offset(entry))
+			continue;
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		if (!swapin_readahead_one(swp_entry(swp_type(entry), offset),
+					  gfp_mask, vma, addr))
 			break;
-		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
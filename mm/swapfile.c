@@ -2297,13 +2297,16 @@ int swapcache_prepare(swp_entry_t entry)
 }
 
 /*
+ * Find the run of allocated slots around entry, within the aligned block
+ * of (1 << our_page_cluster) slots that holds it.
+ *
  * swap_lock prevents swap_map being freed. Don't grab an extra
  * reference on the swaphandle, it doesn't matter if it becomes unused.
  */
-int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
+int valid_swaphandles(swp_entry_t entry, unsigned long *offset,
+		      int our_page_cluster)
 {
 	struct swap_info_struct *si;
-	int our_page_cluster = page_cluster;
 	pgoff_t target, toff;
 	pgoff_t base, end;
 	int nr_pages = 0;
@@ -1586,6 +1586,10 @@ static void dev_queue_xmit_nit(struct sk_buff *skb, struct net_device *dev)
 			skb2 = skb_clone(skb, GFP_ATOMIC);
 			if (!skb2)
 				break;
+			if (skb_orphan_frags(skb2, GFP_ATOMIC)) {
+				kfree_skb(skb2);
+				break;
+			}
 
 			net_timestamp_set(skb2);
 
@@ -3116,6 +3120,12 @@ static int __netif_receive_skb(struct sk_buff *skb)
 
 	trace_netif_receive_skb(skb);
 
+	/* A looped back zerocopy send may sit in a receive queue forever */
+	if (skb_orphan_frags(skb, GFP_ATOMIC)) {
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+
 	/* if we've gotten here through NAPI, check netpoll */
 	if (netpoll_receive_skb(skb))
 		return NET_RX_DROP;
@@ -41,6 +41,8 @@
 #include <linux/kernel.h>
 #include <linux/kmemcheck.h>
 #include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/capability.h>
 #include <linux/interrupt.h>
 #include <linux/in.h>
 #include <linux/inet.h>
@@ -332,6 +334,7 @@ static void skb_release_data(struct sk_buff *skb)
 		if (skb_has_frag_list(skb))
 			skb_drop_fraglist(skb);
 
+		skb_zcopy_clear(skb, true);
 		kfree(skb->head);
 	}
 }
@@ -696,6 +699,276 @@ struct sk_buff *skb_copy(const struct sk_buff *skb, gfp_t gfp_mask)
 }
 EXPORT_SYMBOL(skb_copy);
 
+static int mm_account_pinned_pages(struct mmpin *mmp, int nr_pages)
+{
+	unsigned long max_pg, new_pg, old_pg;
+	struct user_struct *user;
+
+	if (capable(CAP_IPC_LOCK))
+		return 0;
+
+	max_pg = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	user = mmp->user ? : current_user();
+
+	do {
+		old_pg = atomic_long_read(&user->locked_vm);
+		new_pg = old_pg + nr_pages;
+		if (new_pg > max_pg)
+			return -ENOBUFS;
+	} while (atomic_long_cmpxchg(&user->locked_vm, old_pg, new_pg) !=
+		 old_pg);
+
+	if (!mmp->user)
+		mmp->user = get_uid(user);
+	mmp->num_pg += nr_pages;
+	return 0;
+}
+
+static void mm_unaccount_pinned_pages(struct mmpin *mmp)
+{
+	if (mmp->user) {
+		atomic_long_sub(mmp->num_pg, &mmp->user->locked_vm);
+		free_uid(mmp->user);
+	}
+}
+
+static struct sk_buff *skb_from_uarg(struct ubuf_info *uarg)
+{
+	return container_of((void *)uarg, struct sk_buff, cb);
+}
+
+/**
+ *	sock_zerocopy_alloc - start a MSG_ZEROCOPY send
+ *	@sk: socket to send on
+ *
+ *	Allocates the skb that will carry the completion of the send to
+ *	the socket error queue, with the send's &struct ubuf_info in its
+ *	control buffer. Sends are numbered in order from zero. The
+ *	caller owns the returned reference, and drops it with
+ *	sock_zerocopy_put() once all the data is queued, or with
+ *	sock_zerocopy_put_abort() if none was.
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+
+	skb = sock_omalloc(sk, 0, sk->sk_allocation);
+	if (!skb)
+		return NULL;
+
+	uarg = (void *)skb->cb;
+	uarg->callback = sock_zerocopy_callback;
+	uarg->id = sk->sk_zckey++;
+	uarg->len = 1;
+	uarg->zerocopy = 1;
+	uarg->mmp.user = NULL;
+	uarg->mmp.num_pg = 0;
+	atomic_set(&uarg->refcnt, 1);
+	sock_hold(sk);
+
+	return uarg;
+}
+EXPORT_SYMBOL(sock_zerocopy_alloc);
+
+/* Fold completion @id into the one queued last, if they are consecutive */
+static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 id, u8 code)
+{
+	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+
+	if (serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    serr->ee.ee_code != code || serr->ee.ee_data + 1 != id)
+		return false;
+
+	serr->ee.ee_data = id;
+	return true;
+}
+
+/*
+ * Called when the last skb pointing into the buffers of a send is
+ * freed: the pages are no longer used and userspace may reuse them.
+ * Queues the completion for recvmsg(MSG_ERRQUEUE), with the range of
+ * send ids it covers in ee_info..ee_data.
+ */
+void sock_zerocopy_callback(struct ubuf_info *uarg, bool zerocopy)
+{
+	struct sk_buff *tail, *skb = skb_from_uarg(uarg);
+	struct sock_exterr_skb *serr;
+	struct sock *sk = skb->sk;
+	struct sk_buff_head *q;
+	unsigned long flags;
+	u32 id = uarg->id;
+	u8 code;
+
+	mm_unaccount_pinned_pages(&uarg->mmp);
+
+	/* An aborted send has nothing to report */
+	if (!uarg->len || sock_flag(sk, SOCK_DEAD))
+		goto release;
+
+	/* From here on, the control buffer holds the completion */
+	code = zerocopy ? 0 : SO_EE_CODE_ZEROCOPY_COPIED;
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_code = code;
+	serr->ee.ee_info = id;
+	serr->ee.ee_data = id;
+
+	q = &sk->sk_error_queue;
+	spin_lock_irqsave(&q->lock, flags);
+	tail = skb_peek_tail(q);
+	if (!tail || !skb_zerocopy_notify_extend(tail, id, code)) {
+		__skb_queue_tail(q, skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	sk->sk_error_report(sk);
+
+release:
+	if (skb)
+		consume_skb(skb);
+	sock_put(sk);
+}
+EXPORT_SYMBOL(sock_zerocopy_callback);
+
+/* Drop a send that queued no data: its id is reused, nothing is reported */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	if (uarg) {
+		struct sock *sk = skb_from_uarg(uarg)->sk;
+
+		sk->sk_zckey--;
+		uarg->len--;
+		sock_zerocopy_put(uarg);
+	}
+}
+EXPORT_SYMBOL(sock_zerocopy_put_abort);
+
+/**
+ *	skb_zerocopy_from_user - append user pages to a stream skb
+ *	@sk: stream socket the skb is queued on
+ *	@skb: buffer to append to
+ *	@from: user buffer
+ *	@len: length of @from
+ *	@uarg: the zerocopy send @from belongs to
+ *
+ *	Pins the pages under @from and adds them to @skb as frags, as many
+ *	as there are frags left, charging them to @sk like tcp_sendmsg()
+ *	charges copied data. The pinned pages count against the user's
+ *	RLIMIT_MEMLOCK until the send completes.
+ *
+ *	Returns the number of bytes appended, -EEXIST if @skb already
+ *	points into the buffers of another send, -EMSGSIZE if it has no
+ *	frag left, or another negative error code.
+ */
+int skb_zerocopy_from_user(struct sock *sk, struct sk_buff *skb,
+			   const void __user *from, int len,
+			   struct ubuf_info *uarg)
+{
+	struct ubuf_info *orig = skb_zcopy(skb);
+	unsigned long addr = (unsigned long)from;
+	struct page *pages[MAX_SKB_FRAGS];
+	int i = skb_shinfo(skb)->nr_frags;
+	int off = addr & ~PAGE_MASK;
+	int n, k, size, copied = 0;
+
+	if (orig && orig != uarg)
+		return -EEXIST;
+	if (i == MAX_SKB_FRAGS)
+		return -EMSGSIZE;
+
+	n = min_t(int, MAX_SKB_FRAGS - i, DIV_ROUND_UP(off + len, PAGE_SIZE));
+	n = get_user_pages_fast(addr & PAGE_MASK, n, 0, pages);
+	if (n <= 0)
+		return -EFAULT;
+
+	if (mm_account_pinned_pages(&uarg->mmp, n)) {
+		while (n--)
+			put_page(pages[n]);
+		return -ENOBUFS;
+	}
+
+	for (k = 0; k < n; k++) {
+		size = min_t(int, len - copied, PAGE_SIZE - off);
+		skb_fill_page_desc(skb, i++, pages[k], off, size);
+		copied += size;
+		off = 0;
+	}
+
+	skb->len += copied;
+	skb->data_len += copied;
+	skb->truesize += copied;
+	sk->sk_wmem_queued += copied;
+	sk_mem_charge(sk, copied);
+
+	skb_zcopy_set(skb, uarg);
+	return copied;
+}
+EXPORT_SYMBOL(skb_zerocopy_from_user);
+
+/**
+ *	skb_copy_ubufs - copy the user pages of a zerocopy skb to the kernel
+ *	@skb: buffer to copy the frags of
+ *	@gfp_mask: allocation priority
+ *
+ *	Replaces the frags of @skb, which may point to pinned user pages,
+ *	with copies in kernel pages, unsharing its header first, and drops
+ *	its reference on the zerocopy send, which reports that the data was
+ *	copied. Frags are never larger than a page here. On failure @skb is
+ *	left unchanged and still points to the user pages.
+ */
+int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
+{
+	int i, num_frags;
+	struct page *page, *head = NULL;
+
+	if (skb_shared(skb))
+		return -EINVAL;
+	if (skb_cloned(skb) && pskb_expand_head(skb, 0, 0, gfp_mask))
+		return -ENOMEM;
+
+	num_frags = skb_shinfo(skb)->nr_frags;
+	for (i = 0; i < num_frags; i++) {
+		skb_frag_t *f = &skb_shinfo(skb)->frags[i];
+		u8 *vaddr;
+
+		page = alloc_page(gfp_mask);
+		if (!page) {
+			while (head) {
+				struct page *next = (struct page *)head->private;
+
+				put_page(head);
+				head = next;
+			}
+			return -ENOMEM;
+		}
+		vaddr = kmap_skb_frag(f);
+		memcpy(page_address(page), vaddr + f->page_offset, f->size);
+		kunmap_skb_frag(vaddr);
+		page->private = (unsigned long)head;
+		head = page;
+	}
+
+	/* skb frags release userspace buffers */
+	for (i = 0; i < num_frags; i++)
+		put_page(skb_shinfo(skb)->frags[i].page);
+
+	/* skb frags point to kernel buffers */
+	for (i = num_frags - 1; i >= 0; i--) {
+		skb_shinfo(skb)->frags[i].page = head;
+		skb_shinfo(skb)->frags[i].page_offset = 0;
+		head = (struct page *)head->private;
+	}
+
+	skb_zcopy_clear(skb, false);
+	return 0;
+}
+EXPORT_SYMBOL(skb_copy_ubufs);
+
 /**
  *	pskb_copy	-	create copy of an sk_buff with private head.
  *	@skb: buffer to copy
@@ -736,6 +1009,7 @@ struct sk_buff *pskb_copy(struct sk_buff *skb, gfp_t gfp_mask)
 			get_page(skb_shinfo(n)->frags[i].page);
 		}
 		skb_shinfo(n)->nr_frags = i;
+		skb_zcopy_set(n, skb_zcopy(skb));
 	}
 
 	if (skb_has_frag_list(skb)) {
@@ -825,6 +1099,10 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 		if (skb_has_frag_list(skb))
 			skb_clone_fraglist(skb);
 
+		/* the copied shinfo points to the zerocopy buffers too */
+		if (skb_zcopy(skb))
+			sock_zerocopy_get(skb_zcopy(skb));
+
 		skb_release_data(skb);
 	}
 	off = (data + nhead) - skb->head;
@@ -2081,6 +2359,8 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 {
 	int pos = skb_headlen(skb);
 
+	/* skb1 is fresh, it takes over part of the zerocopy frags */
+	skb_zcopy_set(skb1, skb_zcopy(skb));
 	if (len < pos)	/* Split line is inside header. */
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
@@ -2123,6 +2403,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* Frags cannot move between skbs of different zerocopy sends */
+	if (skb_zcopy(tgt) || skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -2597,6 +2881,8 @@ struct sk_buff *skb_segment(struct sk_buff *skb, u32 features)
 		skb_copy_from_linear_data_offset(skb, offset,
 						 skb_put(nskb, hsize), hsize);
 
+		skb_zcopy_set(nskb, skb_zcopy(skb));
+
 		while (pos < offset + len && i < nfrags) {
 			*frag = skb_shinfo(skb)->frags[i];
 			get_page(frag->page);
@@ -3,7 +3,16 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_deadline(int argc, const char **argv, const char *prefix __used);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_tlb(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_reclaim(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_mmap(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_wake(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_requeue(int argc, const char **argv, const char *prefix __used);
+extern int bench_futex_lock_pi(int argc, const char **argv, const char *prefix __used);
+extern int bench_epoll_accept(int argc, const char **argv, const char *prefix __used);
+extern int bench_net_zerocopy(int argc, const char **argv, const char *prefix __used);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -0,0 +1,220 @@
+/*
+ * epoll-accept.c
+ *
+ * accept: Worker threads, each with an epoll set of its own, wait for
+ *         connections on one shared listening socket and accept() them,
+ *         while client threads connect over loopback.  Without
+ *         EPOLLEXCLUSIVE every connection wakes all idle workers, and
+ *         all but one of them go back to sleep, mostly without even
+ *         returning from epoll_wait().
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE		(1u << 28)
+#endif
+
+static int		nr_workers;
+static int		nr_clients	= 1;
+static int		duration	= 5;
+static bool		exclusive;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_workers,
+		    "Specify number of accepting threads (default: online CPUs)"),
+	OPT_INTEGER('c', "clients", &nr_clients,
+		    "Specify number of connecting threads"),
+	OPT_INTEGER('l', "length", &duration,
+		    "Specify length of the run, in seconds"),
+	OPT_BOOLEAN('x', "exclusive", &exclusive,
+		    "Add the listening socket with EPOLLEXCLUSIVE"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_accept_usage[] = {
+	"perf bench epoll accept <options>",
+	NULL
+};
+
+struct accept_worker {
+	pthread_t	thread;
+	int		epfd;
+	u64		wakeups;
+	u64		spurious;	/* wakeups that found nothing to accept */
+	u64		switches;	/* times the thread went to sleep */
+	u64		ops;
+};
+
+static volatile int done;
+static int listen_fd;
+static struct sockaddr_in addr;
+
+static void *accept_worker(void *arg)
+{
+	struct accept_worker *w = arg;
+	struct epoll_event ev;
+	struct rusage ru;
+	int fd, got;
+
+	getrusage(RUSAGE_THREAD, &ru);
+	w->switches = -ru.ru_nvcsw;
+
+	while (!done) {
+		/* time out now and then to notice the end of the run */
+		if (epoll_wait(w->epfd, &ev, 1, 100) <= 0)
+			continue;
+		w->wakeups++;
+
+		for (got = 0; (fd = accept(listen_fd, NULL, NULL)) >= 0; got++)
+			close(fd);
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			die("accept: %s\n", strerror(errno));
+
+		if (!got)
+			w->spurious++;
+		w->ops += got;
+	}
+
+	getrusage(RUSAGE_THREAD, &ru);
+	w->switches += ru.ru_nvcsw;
+	return NULL;
+}
+
+static void *client_worker(void *arg __used)
+{
+	/* reset the connection on close, not to run out of ports */
+	struct linger lin = { .l_onoff = 1, .l_linger = 0 };
+	int fd;
+
+	while (!done) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			die("socket: %s\n", strerror(errno));
+		setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+			die("connect: %s\n", strerror(errno));
+		close(fd);
+	}
+
+	return NULL;
+}
+
+int bench_epoll_accept(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval tv_start, tv_end, tv_diff;
+	struct accept_worker *workers;
+	struct epoll_event ev;
+	u64 accepts = 0, wakeups = 0, spurious = 0, switches = 0;
+	socklen_t len = sizeof(addr);
+	double secs;
+	int nr, i;
+
+	argc = parse_options(argc, argv, options, bench_epoll_accept_usage, 0);
+
+	if (!nr_workers)
+		nr_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_workers <= 0 || nr_clients <= 0 || duration <= 0) {
+		fprintf(stderr, "Invalid threads, clients or length\n");
+		return 1;
+	}
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0)
+		die("socket: %s\n", strerror(errno));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    getsockname(listen_fd, (struct sockaddr *)&addr, &len) < 0 ||
+	    listen(listen_fd, SOMAXCONN) < 0)
+		die("listen: %s\n", strerror(errno));
+	/* the workers race for each connection, the losers must not block */
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+
+	nr = nr_workers + nr_clients;
+	workers = zalloc(nr * sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+
+	for (i = 0; i < nr_workers; i++) {
+		workers[i].epfd = epoll_create(1);
+		if (workers[i].epfd < 0)
+			die("epoll_create: %s\n", strerror(errno));
+		ev.events = EPOLLIN | (exclusive ? EPOLLEXCLUSIVE : 0);
+		ev.data.u64 = 0;
+		if (epoll_ctl(workers[i].epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+			die("epoll_ctl: %s%s\n", strerror(errno),
+			    exclusive ? " (no EPOLLEXCLUSIVE support?)" : "");
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads accepting%s, %d threads connecting, "
+		       "for %d sec ...\n\n", nr_workers,
+		       exclusive ? " (EPOLLEXCLUSIVE)" : "", nr_clients,
+		       duration);
+
+	BUG_ON(gettimeofday(&tv_start, NULL));
+	for (i = 0; i < nr; i++)
+		if (pthread_create(&workers[i].thread, NULL,
+				   i < nr_workers ? accept_worker : client_worker,
+				   &workers[i]))
+			die("pthread_create failed\n");
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (i < nr_workers) {
+			accepts += workers[i].ops;
+			wakeups += workers[i].wakeups;
+			spurious += workers[i].spurious;
+			switches += workers[i].switches;
+			close(workers[i].epfd);
+		}
+	}
+	BUG_ON(gettimeofday(&tv_end, NULL));
+
+	timersub(&tv_end, &tv_start, &tv_diff);
+	secs = tv_diff.tv_sec + tv_diff.tv_usec / 1e6;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14lf accepts/sec\n", accepts / secs);
+		printf(" %14lf worker sleeps per accept\n",
+		       accepts ? (double)switches / accepts : 0.0);
+		printf(" %14lf%% epoll_wait() returns with nothing to accept\n",
+		       wakeups ? 100.0 * spurious / wakeups : 0.0);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf %lf\n", accepts / secs,
+		       accepts ? (double)switches / accepts : 0.0,
+		       wakeups ? 100.0 * spurious / wakeups : 0.0);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	close(listen_fd);
+	free(workers);
+	return 0;
+}
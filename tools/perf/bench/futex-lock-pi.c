@@ -0,0 +1,141 @@
+/*
+ * futex-lock-pi.c
+ *
+ * lock-pi: Threads take and release a PI futex in a loop, through the
+ *          kernel every time.  By default all threads share one lock;
+ *          with --multi each has its own, so the only contention left
+ *          is on the futex hash buckets.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* one lock per cache line, so that --multi measures the kernel only */
+#define LOCK_STRIDE	(64 / sizeof(u_int32_t))
+
+static int		nr_threads;
+static int		runtime		= 5;
+static bool		multi;
+static bool		shared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online CPUs)"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime, in seconds"),
+	OPT_BOOLEAN('M', "multi", &multi,
+		    "Give each thread its own lock"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_lock_pi_usage[] = {
+	"perf bench futex lock-pi <options>",
+	NULL
+};
+
+struct pi_worker {
+	pthread_t	thread;
+	u_int32_t	*lock;
+	u64		ops;
+};
+
+static volatile int done;
+
+static void *pi_worker(void *arg)
+{
+	struct pi_worker *w = arg;
+
+	while (!done) {
+		if (futex_lock_pi(w->lock, shared))
+			die("futex_lock_pi: %s\n", strerror(errno));
+		if (futex_unlock_pi(w->lock, shared))
+			die("futex_unlock_pi: %s\n", strerror(errno));
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+int bench_futex_lock_pi(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct pi_worker *workers;
+	pthread_attr_t attr;
+	u_int32_t *locks;
+	cpu_set_t cpus;
+	u64 ops = 0;
+	int nr_cpus, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_lock_pi_usage, 0);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (!nr_threads)
+		nr_threads = nr_cpus;
+	if (nr_threads <= 0 || runtime <= 0) {
+		fprintf(stderr, "Invalid threads or runtime\n");
+		return 1;
+	}
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	locks = zalloc(nr_threads * LOCK_STRIDE * sizeof(*locks));
+	if (!workers || !locks)
+		die("memory allocation failed\n");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads on %s %s PI lock%s for %d sec ...\n\n",
+		       nr_threads, multi ? "their own" : "one",
+		       shared ? "shared" : "private", multi ? "s" : "",
+		       runtime);
+
+	pthread_attr_init(&attr);
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].lock = &locks[multi ? i * LOCK_STRIDE : 0];
+		CPU_ZERO(&cpus);
+		CPU_SET(i % nr_cpus, &cpus);
+		if (pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus))
+			die("pthread_attr_setaffinity_np failed\n");
+		if (pthread_create(&workers[i].thread, &attr, pi_worker,
+				   &workers[i]))
+			die("pthread_create failed\n");
+	}
+	pthread_attr_destroy(&attr);
+
+	sleep(runtime);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		ops += workers[i].ops;
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14lf lock/unlock ops/sec\n", (double)ops / runtime);
+		printf(" %14lf ops/sec per thread\n",
+		       (double)ops / runtime / nr_threads);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)ops / runtime);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	free(locks);
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * futex-requeue.c
+ *
+ * requeue: Threads block on one futex, and the main thread moves them
+ *          over to a second one with FUTEX_CMP_REQUEUE, as a condition
+ *          variable broadcast does.  Measures how long moving them all
+ *          takes.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+#include "futex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+static int		nr_threads;
+static int		nr_requeue	= 1;
+static int		rounds		= 10;
+static bool		shared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of waiters (default: online CPUs)"),
+	OPT_INTEGER('q', "nrequeue", &nr_requeue,
+		    "Specify number of threads requeued per call"),
+	OPT_INTEGER('r', "rounds", &rounds,
+		    "Specify number of rounds"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_requeue_usage[] = {
+	"perf bench futex requeue <options>",
+	NULL
+};
+
+static u_int32_t	futex1, futex2;
+static int		nr_waiting;
+
+static void *waiter(void *arg __used)
+{
+	__sync_fetch_and_add(&nr_waiting, 1);
+	while (futex_wait(&futex1, 0, shared) && errno == EINTR)
+		;
+	return NULL;
+}
+
+int bench_futex_requeue(int argc, const char **argv,
+			const char *prefix __used)
+{
+	struct timeval tv_start, tv_end, tv_diff;
+	pthread_t *threads;
+	double usecs = 0.0;
+	int round, moved, woken, i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_requeue_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || nr_requeue <= 0 || rounds <= 0) {
+		fprintf(stderr, "Invalid threads, nrequeue or rounds\n");
+		return 1;
+	}
+
+	threads = zalloc(nr_threads * sizeof(*threads));
+	if (!threads)
+		die("memory allocation failed\n");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Requeuing %d %s waiters, %d per call, %d rounds ...\n\n",
+		       nr_threads, shared ? "shared" : "private", nr_requeue,
+		       rounds);
+
+	for (round = 0; round < rounds; round++) {
+		futex_start_waiters(threads, nr_threads, waiter, &nr_waiting);
+
+		BUG_ON(gettimeofday(&tv_start, NULL));
+		for (moved = 0; moved < nr_threads; ) {
+			int ret = futex_cmp_requeue(&futex1, 0, &futex2, 0,
+						    nr_requeue, shared);
+
+			if (ret < 0)
+				die("futex_cmp_requeue: %s\n",
+				    strerror(errno));
+			moved += ret;
+		}
+		BUG_ON(gettimeofday(&tv_end, NULL));
+
+		timersub(&tv_end, &tv_start, &tv_diff);
+		usecs += tv_diff.tv_sec * 1e6 + tv_diff.tv_usec;
+
+		for (woken = 0; woken < nr_threads; )
+			woken += futex_wake(&futex2, nr_threads, shared);
+		for (i = 0; i < nr_threads; i++)
+			pthread_join(threads[i], NULL);
+	}
+	usecs /= rounds;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14lf usecs to requeue all\n", usecs);
+		printf(" %14lf usecs per waiter\n", usecs / nr_threads);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", usecs);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	free(threads);
+	return 0;
+}
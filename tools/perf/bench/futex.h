@@ -0,0 +1,90 @@
+/*
+ * futex.h
+ *
+ * Glibc has no futex() wrapper, these are the few operations the futex
+ * suites need.  With shared set, the private flag is left out and the
+ * futexes go to the global hash table even within one process.
+ */
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <linux/futex.h>
+
+#define futex(uaddr, op, val, timeout, uaddr2, val3, shared)		\
+	syscall(SYS_futex, uaddr,					\
+		(op) | ((shared) ? 0 : FUTEX_PRIVATE_FLAG),		\
+		val, timeout, uaddr2, val3)
+
+static inline int
+futex_wait(u_int32_t *uaddr, u_int32_t val, int shared)
+{
+	return futex(uaddr, FUTEX_WAIT, val, NULL, NULL, 0, shared);
+}
+
+static inline int
+futex_wake(u_int32_t *uaddr, int nr_wake, int shared)
+{
+	return futex(uaddr, FUTEX_WAKE, nr_wake, NULL, NULL, 0, shared);
+}
+
+/* Wake @nr_wake waiters on @uaddr and move up to @nr_requeue to @uaddr2 */
+static inline int
+futex_cmp_requeue(u_int32_t *uaddr, u_int32_t val, u_int32_t *uaddr2,
+		  int nr_wake, int nr_requeue, int shared)
+{
+	return futex(uaddr, FUTEX_CMP_REQUEUE, nr_wake,
+		     (void *)(long)nr_requeue, uaddr2, val, shared);
+}
+
+static inline int
+futex_lock_pi(u_int32_t *uaddr, int shared)
+{
+	return futex(uaddr, FUTEX_LOCK_PI, 0, NULL, NULL, 0, shared);
+}
+
+static inline int
+futex_unlock_pi(u_int32_t *uaddr, int shared)
+{
+	return futex(uaddr, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0, shared);
+}
+
+/*
+ * Start @nr threads running @fn, spread over the cpus, and return once
+ * they all have counted themselves in @waiting and had time to block.
+ */
+static inline void
+futex_start_waiters(pthread_t *threads, int nr, void *(*fn)(void *),
+		    int *waiting)
+{
+	int nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	int i;
+
+	*waiting = 0;
+	pthread_attr_init(&attr);
+	for (i = 0; i < nr; i++) {
+		CPU_ZERO(&cpus);
+		CPU_SET(i % nr_cpus, &cpus);
+		if (pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus))
+			die("pthread_attr_setaffinity_np failed\n");
+		if (pthread_create(&threads[i], &attr, fn, NULL))
+			die("pthread_create failed\n");
+	}
+	pthread_attr_destroy(&attr);
+
+	/*
+	 * Give the waiters that got this far a moment to actually block:
+	 * the kernel offers no way to tell.
+	 */
+	while (*(volatile int *)waiting < nr)
+		usleep(1000);
+	usleep(100000);
+}
+
+#endif /* _FUTEX_H */
@@ -0,0 +1,182 @@
+/*
+ * mem-mmap.c
+ *
+ * mmap: Threads page-faulting on a shared anonymous region while other
+ *       threads of the same process mmap and munmap, so page faults
+ *       (mmap_sem readers) and address space changes (writers) contend
+ *       on one mmap_sem
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static int		nr_faulters;
+static int		nr_mappers	= 1;
+static const char	*length_str	= "16MB";
+static int		duration	= 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_faulters,
+		    "Specify number of faulting threads (default: online CPUs)"),
+	OPT_INTEGER('m', "mappers", &nr_mappers,
+		    "Specify number of threads doing mmap/munmap"),
+	OPT_STRING('s', "size", &length_str, "16MB",
+		    "Specify size of each faulting thread's part of the region. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('l', "length", &duration,
+		    "Specify length of the run, in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_mem_mmap_usage[] = {
+	"perf bench mem mmap <options>",
+	NULL
+};
+
+struct mmap_worker {
+	pthread_t	thread;
+	char		*start;
+	size_t		len;
+	u64		ops;
+};
+
+static volatile int done;
+static size_t page_size;
+
+/*
+ * Touch every page of our slice, then drop them with MADV_DONTNEED so
+ * that the next pass faults them all in again.  Both the faults and
+ * madvise take mmap_sem for reading.
+ */
+static void *fault_worker(void *arg)
+{
+	struct mmap_worker *w = arg;
+	size_t off;
+
+	while (!done) {
+		for (off = 0; off < w->len && !done; off += page_size) {
+			w->start[off] = 1;
+			w->ops++;
+		}
+		if (madvise(w->start, w->len, MADV_DONTNEED) < 0)
+			die("madvise: %s\n", strerror(errno));
+	}
+
+	return NULL;
+}
+
+/* Each mmap and munmap takes mmap_sem for writing */
+static void *map_worker(void *arg)
+{
+	struct mmap_worker *w = arg;
+	void *p;
+
+	while (!done) {
+		p = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			die("mmap: %s\n", strerror(errno));
+		munmap(p, page_size);
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+int bench_mem_mmap(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval tv_start, tv_end, tv_diff;
+	struct mmap_worker *workers;
+	u64 faults = 0, maps = 0;
+	size_t len;
+	char *region;
+	double secs;
+	int nr, i;
+
+	argc = parse_options(argc, argv, options, bench_mem_mmap_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (!nr_faulters)
+		nr_faulters = sysconf(_SC_NPROCESSORS_ONLN);
+	len = (size_t)perf_atoll((char *)length_str);
+	if ((s64)len <= 0 || len < page_size) {
+		fprintf(stderr, "Invalid size:%s\n", length_str);
+		return 1;
+	}
+	len &= ~(page_size - 1);
+	if (nr_faulters <= 0 || nr_mappers < 0 || duration <= 0) {
+		fprintf(stderr, "Invalid threads, mappers or length\n");
+		return 1;
+	}
+
+	nr = nr_faulters + nr_mappers;
+	workers = zalloc(nr * sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+
+	region = mmap(NULL, len * nr_faulters, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED)
+		die("mmap of %zu bytes failed\n", len * nr_faulters);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads faulting on %s each, %d threads "
+		       "mapping, for %d sec ...\n\n",
+		       nr_faulters, length_str, nr_mappers, duration);
+
+	BUG_ON(gettimeofday(&tv_start, NULL));
+	for (i = 0; i < nr; i++) {
+		struct mmap_worker *w = &workers[i];
+
+		if (i < nr_faulters) {
+			w->start = region + i * len;
+			w->len = len;
+		}
+		if (pthread_create(&w->thread, NULL,
+				   i < nr_faulters ? fault_worker : map_worker, w))
+			die("pthread_create failed\n");
+	}
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (i < nr_faulters)
+			faults += workers[i].ops;
+		else
+			maps += workers[i].ops;
+	}
+	BUG_ON(gettimeofday(&tv_end, NULL));
+
+	timersub(&tv_end, &tv_start, &tv_diff);
+	secs = tv_diff.tv_sec + tv_diff.tv_usec / 1e6;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14lf page faults/sec\n", faults / secs);
+		printf(" %14lf mmap+munmap/sec\n", maps / secs);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf\n", faults / secs, maps / secs);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	munmap(region, len * nr_faulters);
+	free(workers);
+	return 0;
+}
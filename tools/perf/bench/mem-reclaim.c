@@ -0,0 +1,181 @@
+/*
+ * mem-reclaim.c
+ *
+ * reclaim: Several threads stream through a sparse file larger than
+ *          memory, so that page cache additions and reclaim of the
+ *          same zones run concurrently on all CPUs
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#define CHUNK		(64 << 10)
+
+static const char	*size_str;
+static const char	*dir		= ".";
+static int		nr_threads;
+static int		passes		= 2;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "2*RAM",
+		    "Specify size of the file to stream through. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_STRING('d', "dir", &dir, ".",
+		    "Directory for the file, must not be on tmpfs"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads (default: online CPUs)"),
+	OPT_INTEGER('p', "passes", &passes,
+		    "Specify number of passes over the file"),
+	OPT_END()
+};
+
+static const char * const bench_mem_reclaim_usage[] = {
+	"perf bench mem reclaim <options>",
+	NULL
+};
+
+struct reclaim_worker {
+	pthread_t	thread;
+	int		fd;
+	off_t		start;
+	off_t		len;
+	u64		bytes;
+};
+
+static void *reclaim_worker(void *arg)
+{
+	struct reclaim_worker *w = arg;
+	char *buf = malloc(CHUNK);
+	off_t off;
+	ssize_t ret;
+	int pass;
+
+	if (!buf)
+		die("memory allocation failed\n");
+
+	for (pass = 0; pass < passes; pass++) {
+		for (off = 0; off < w->len; off += ret) {
+			ret = pread(w->fd, buf, CHUNK, w->start + off);
+			if (ret <= 0)
+				die("pread: %s\n", strerror(errno));
+			w->bytes += ret;
+		}
+	}
+
+	free(buf);
+	return NULL;
+}
+
+/* Sum of the /proc/vmstat counters whose names start with @prefix */
+static u64 vmstat_sum(const char *prefix)
+{
+	char name[64];
+	unsigned long long val;
+	u64 sum = 0;
+	FILE *f;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %llu", name, &val) == 2)
+		if (!strncmp(name, prefix, strlen(prefix)))
+			sum += val;
+	fclose(f);
+
+	return sum;
+}
+
+int bench_mem_reclaim(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval tv_start, tv_end, tv_diff;
+	struct reclaim_worker *workers;
+	u64 steal, scan, bytes = 0;
+	char path[PATH_MAX];
+	double secs;
+	off_t size, slice;
+	int fd, i;
+
+	argc = parse_options(argc, argv, options, bench_mem_reclaim_usage, 0);
+
+	if (size_str)
+		size = (off_t)perf_atoll((char *)size_str);
+	else
+		size = 2 * (off_t)sysconf(_SC_PHYS_PAGES) *
+			sysconf(_SC_PAGESIZE);
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (size <= 0 || nr_threads <= 0 || passes <= 0) {
+		fprintf(stderr, "Invalid size, threads or passes\n");
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/perf-bench-reclaim.XXXXXX", dir);
+	fd = mkstemp(path);
+	if (fd < 0)
+		die("mkstemp %s: %s\n", path, strerror(errno));
+	unlink(path);
+	/* holes read back as zeroes but still fill the page cache */
+	if (ftruncate(fd, size) < 0)
+		die("ftruncate: %s\n", strerror(errno));
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	if (!workers)
+		die("memory allocation failed\n");
+	slice = (size / nr_threads) & ~((off_t)CHUNK - 1);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d threads streaming %d times through %lld MB ...\n\n",
+		       nr_threads, passes, (long long)size >> 20);
+
+	steal = vmstat_sum("pgsteal");
+	scan = vmstat_sum("pgscan");
+	BUG_ON(gettimeofday(&tv_start, NULL));
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].fd = fd;
+		workers[i].start = i * slice;
+		workers[i].len = slice;
+		if (pthread_create(&workers[i].thread, NULL,
+				   reclaim_worker, &workers[i]))
+			die("pthread_create failed\n");
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		bytes += workers[i].bytes;
+	}
+	BUG_ON(gettimeofday(&tv_end, NULL));
+	steal = vmstat_sum("pgsteal") - steal;
+	scan = vmstat_sum("pgscan") - scan;
+
+	timersub(&tv_end, &tv_start, &tv_diff);
+	secs = tv_diff.tv_sec + tv_diff.tv_usec / 1e6;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14lf MB/sec\n", bytes / secs / (1 << 20));
+		printf(" %14lf pages reclaimed/sec\n", steal / secs);
+		printf(" %14lf pages scanned/sec\n", scan / secs);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf %lf\n", bytes / secs / (1 << 20),
+		       steal / secs, scan / secs);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	free(workers);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * mem-tlb.c
+ *
+ * tlb: Pointer chasing over a large anonymous buffer, one hop per page,
+ *      mapped with small pages and with transparent huge pages
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE		14
+#endif
+#ifndef MADV_NOHUGEPAGE
+#define MADV_NOHUGEPAGE		15
+#endif
+
+/* PMD size on both x86 and ARM, the buffer is aligned to it */
+#define HUGE_ALIGN		(2UL << 20)
+#define CACHELINE		64
+
+static const char	*length_str	= "256MB";
+static int		accesses	= 10000000;
+static const char	*mode		= "both";
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "256MB",
+		    "Specify length of the buffer. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('n', "accesses", &accesses,
+		    "Specify number of pointer hops"),
+	OPT_STRING('m', "mode", &mode, "both",
+		    "Page size to run with: small, huge or both"),
+	OPT_END()
+};
+
+static const char * const bench_mem_tlb_usage[] = {
+	"perf bench mem tlb <options>",
+	NULL
+};
+
+static void * volatile sink;
+
+/*
+ * Link one slot per page into a single random cycle (Sattolo's
+ * algorithm), so every hop lands on another page and the hardware
+ * prefetchers can't help.  Each slot sits on a random cache line of its
+ * page: a fixed pattern would alias in the physically indexed caches
+ * once the pages are contiguous.  Returns nanoseconds per hop.
+ */
+static double do_chase(size_t len, int advice)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t nr = len / page, i;
+	struct timeval tv_start, tv_end, tv_diff;
+	size_t *next, *line;
+	char *map, *buf;
+	void **p;
+	int n;
+
+#define SLOT(k)	((void **)(buf + (k) * page + line[k] * CACHELINE))
+
+	map = mmap(NULL, len + HUGE_ALIGN, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		die("mmap of %zu bytes failed\n", len);
+	buf = (char *)(((unsigned long)map + HUGE_ALIGN - 1) &
+		       ~(HUGE_ALIGN - 1));
+
+	if (madvise(buf, len, advice) < 0 && advice == MADV_HUGEPAGE)
+		fprintf(stderr, "madvise(MADV_HUGEPAGE): %s, "
+			"no transparent huge page support?\n",
+			strerror(errno));
+
+	next = malloc(nr * sizeof(*next));
+	line = malloc(nr * sizeof(*line));
+	if (!next || !line)
+		die("memory allocation failed\n");
+
+	srandom(1);
+	for (i = 0; i < nr; i++) {
+		next[i] = i;
+		line[i] = random() % (page / CACHELINE);
+	}
+	for (i = nr - 1; i > 0; i--) {
+		size_t j = random() % i, tmp = next[i];
+
+		next[i] = next[j];
+		next[j] = tmp;
+	}
+
+	/* this also faults the whole buffer in */
+	for (i = 0; i < nr; i++)
+		*SLOT(i) = SLOT(next[i]);
+
+	p = SLOT(0);
+	free(next);
+	free(line);
+	BUG_ON(gettimeofday(&tv_start, NULL));
+	for (n = 0; n < accesses; n++)
+		p = *p;
+	BUG_ON(gettimeofday(&tv_end, NULL));
+	sink = p;
+
+	timersub(&tv_end, &tv_start, &tv_diff);
+	munmap(map, len + HUGE_ALIGN);
+#undef SLOT
+
+	return ((double)tv_diff.tv_sec * 1e9 + (double)tv_diff.tv_usec * 1e3)
+		/ (double)accesses;
+}
+
+int bench_mem_tlb(int argc, const char **argv, const char *prefix __used)
+{
+	double result[2] = { 0.0, 0.0 };
+	bool small, huge;
+	size_t len;
+
+	argc = parse_options(argc, argv, options, bench_mem_tlb_usage, 0);
+
+	len = (size_t)perf_atoll((char *)length_str);
+	if ((s64)len <= 0 || len < HUGE_ALIGN) {
+		fprintf(stderr, "Invalid length:%s\n", length_str);
+		return 1;
+	}
+	if (accesses <= 0) {
+		fprintf(stderr, "Invalid number of accesses:%d\n", accesses);
+		return 1;
+	}
+
+	small = !strcmp(mode, "small") || !strcmp(mode, "both");
+	huge = !strcmp(mode, "huge") || !strcmp(mode, "both");
+	if (!small && !huge) {
+		fprintf(stderr, "Unknown mode:%s\n", mode);
+		return 1;
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# Chasing %d pointers over %s ...\n\n",
+		       accesses, length_str);
+
+	if (small)
+		result[0] = do_chase(len, MADV_NOHUGEPAGE);
+	if (huge)
+		result[1] = do_chase(len, MADV_HUGEPAGE);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		if (small)
+			printf(" %14lf ns/access\n", result[0]);
+		if (huge)
+			printf(" %14lf ns/access (transparent huge pages)\n",
+			       result[1]);
+		if (small && huge)
+			printf(" %14lf speedup\n", result[0] / result[1]);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		if (small && huge)
+			printf("%lf %lf\n", result[0], result[1]);
+		else
+			printf("%lf\n", small ? result[0] : result[1]);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * net-zerocopy.c
+ *
+ * zerocopy: One thread sends large buffers over a TCP connection on
+ *           loopback while another one reads and drops them, with or
+ *           without MSG_ZEROCOPY.  Reports the cpu time the sender spends
+ *           per byte, and how many of the zerocopy sends completed
+ *           without their data being copied after all.
+ *
+ *           Loopback hands the pages to the receive queue of the local
+ *           socket, which copies them (the completions are flagged
+ *           SO_EE_CODE_ZEROCOPY_COPIED), so the copy is only saved when
+ *           the connection goes out through a NIC doing scatter-gather;
+ *           use -H to send to such a host, running this with -R.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_ZEROCOPY
+# if defined(__sparc__)
+#  define SO_ZEROCOPY		0x003e
+# elif defined(__hppa__)
+#  define SO_ZEROCOPY		0x4035
+# else
+#  define SO_ZEROCOPY		60
+# endif
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY		0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY		5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED	1
+#endif
+
+static const char	*size_str	= "64KB";
+static const char	*host;
+static int		port		= 8000;
+static int		duration	= 5;
+static bool		zerocopy;
+static bool		receive;
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &size_str, "64KB",
+		    "Specify size of each send. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('l', "length", &duration,
+		    "Specify length of the run, in seconds"),
+	OPT_BOOLEAN('z', "zerocopy", &zerocopy,
+		    "Send with MSG_ZEROCOPY"),
+	OPT_STRING('H', "host", &host, "IPv4 address",
+		    "Send to a receiver on this host instead of over loopback"),
+	OPT_INTEGER('p', "port", &port,
+		    "Specify TCP port of the receiver, with -H or -R"),
+	OPT_BOOLEAN('R', "receive", &receive,
+		    "Only receive, for a sender on another host"),
+	OPT_END()
+};
+
+static const char * const bench_net_zerocopy_usage[] = {
+	"perf bench net zerocopy <options>",
+	NULL
+};
+
+static volatile int done;
+static size_t send_size;
+
+struct zc_stats {
+	u64		bytes;
+	u64		sends;
+	u64		completions;	/* sends the kernel is done with */
+	u64		copied;		/* of which were copied after all */
+	u64		cpu_us;		/* sender user + system time */
+};
+
+static u64 tv_to_us(const struct timeval *tv)
+{
+	return (u64)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static u64 thread_cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_THREAD, &ru);
+	return tv_to_us(&ru.ru_utime) + tv_to_us(&ru.ru_stime);
+}
+
+/*
+ * Read the completions queued on the error queue of @fd.  Each one
+ * covers the range of sends ee_info..ee_data, numbered from zero in the
+ * order they were made.
+ */
+static void read_completions(int fd, struct zc_stats *st, int block)
+{
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+	struct sock_extended_err *serr;
+	struct pollfd pfd = { .fd = fd, .events = 0 };
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	u64 n;
+
+	if (block && poll(&pfd, 1, 1000) < 0)
+		die("poll: %s\n", strerror(errno));
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			die("recvmsg(MSG_ERRQUEUE): %s\n", strerror(errno));
+		}
+
+		cm = CMSG_FIRSTHDR(&msg);
+		if (!cm)
+			die("completion without a control message\n");
+		serr = (void *)CMSG_DATA(cm);
+		if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+			die("unexpected error queue entry: origin %d errno %d\n",
+			    serr->ee_origin, serr->ee_errno);
+
+		n = serr->ee_data - serr->ee_info + 1;
+		st->completions += n;
+		if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+			st->copied += n;
+	}
+}
+
+static void *send_worker(void *arg)
+{
+	struct zc_stats *st = arg;
+	size_t len = send_size;
+	const char *addr = host ? host : "127.0.0.1";
+	int flags = zerocopy ? MSG_ZEROCOPY : 0;
+	struct sockaddr_in sin;
+	char *buf;
+	ssize_t ret;
+	int fd, one = 1;
+
+	/*
+	 * The buffer is reused without waiting for the previous sends to
+	 * complete: its contents do not matter here.  A real sender must
+	 * not touch the buffer of a zerocopy send before its completion.
+	 */
+	buf = malloc(len);
+	if (!buf)
+		die("memory allocation failed\n");
+	memset(buf, 'z', len);
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	if (!inet_aton(addr, &sin.sin_addr))
+		die("invalid address: %s\n", addr);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		die("socket: %s\n", strerror(errno));
+	if (zerocopy &&
+	    setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+		die("setsockopt(SO_ZEROCOPY): %s\n", strerror(errno));
+	if (connect(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		die("connect: %s\n", strerror(errno));
+
+	st->cpu_us = thread_cpu_us();
+	while (!done) {
+		ret = send(fd, buf, len, flags);
+		if (ret < 0) {
+			/*
+			 * The pages pinned by pending zerocopy sends count
+			 * against RLIMIT_MEMLOCK: wait for some to complete.
+			 */
+			if (zerocopy && errno == ENOBUFS) {
+				read_completions(fd, st, 1);
+				continue;
+			}
+			die("send: %s\n", strerror(errno));
+		}
+		st->bytes += ret;
+		st->sends++;
+		if (zerocopy)
+			read_completions(fd, st, 0);
+	}
+
+	/* collect what is still in flight */
+	shutdown(fd, SHUT_WR);
+	while (zerocopy && st->completions < st->sends) {
+		u64 before = st->completions;
+
+		read_completions(fd, st, 1);
+		if (st->completions == before)
+			break;
+	}
+	st->cpu_us = thread_cpu_us() - st->cpu_us;
+
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static void *recv_worker(void *arg)
+{
+	int listen_fd = (long)arg;
+	char buf[64 << 10];
+	int fd;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		die("accept: %s\n", strerror(errno));
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+
+	close(fd);
+	return NULL;
+}
+
+static int listen_on(int port_nr, const char *addr)
+{
+	struct sockaddr_in sin;
+	int fd, one = 1;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port_nr);
+	sin.sin_addr.s_addr = inet_addr(addr);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		die("socket: %s\n", strerror(errno));
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+	    listen(fd, 1) < 0)
+		die("listen on port %d: %s\n", port_nr, strerror(errno));
+
+	return fd;
+}
+
+int bench_net_zerocopy(int argc, const char **argv, const char *prefix __used)
+{
+	struct timeval tv_start, tv_end, tv_diff;
+	pthread_t sender, receiver;
+	struct zc_stats st;
+	s64 len;
+	int listen_fd = -1;
+	double secs, gb;
+
+	argc = parse_options(argc, argv, options, bench_net_zerocopy_usage, 0);
+
+	len = perf_atoll((char *)size_str);
+	if (len <= 0 || duration <= 0 || port <= 0 || port > 65535) {
+		fprintf(stderr, "Invalid size, length or port\n");
+		return 1;
+	}
+	send_size = len;
+
+	if (receive) {
+		listen_fd = listen_on(port, "0.0.0.0");
+		printf("# receiving on port %d ...\n", port);
+		recv_worker((void *)(long)listen_fd);
+		close(listen_fd);
+		return 0;
+	}
+
+	if (!host) {
+		/* any free port on loopback */
+		socklen_t alen = sizeof(struct sockaddr_in);
+		struct sockaddr_in sin;
+
+		listen_fd = listen_on(0, "127.0.0.1");
+		if (getsockname(listen_fd, (struct sockaddr *)&sin, &alen) < 0)
+			die("getsockname: %s\n", strerror(errno));
+		port = ntohs(sin.sin_port);
+		if (pthread_create(&receiver, NULL, recv_worker,
+				   (void *)(long)listen_fd))
+			die("pthread_create failed\n");
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# sending %s at a time%s to %s for %d sec ...\n\n",
+		       size_str, zerocopy ? " with MSG_ZEROCOPY" : "",
+		       host ? host : "loopback", duration);
+
+	memset(&st, 0, sizeof(st));
+	BUG_ON(gettimeofday(&tv_start, NULL));
+	if (pthread_create(&sender, NULL, send_worker, &st))
+		die("pthread_create failed\n");
+
+	sleep(duration);
+	done = 1;
+
+	pthread_join(sender, NULL);
+	BUG_ON(gettimeofday(&tv_end, NULL));
+	if (!host) {
+		pthread_join(receiver, NULL);
+		close(listen_fd);
+	}
+
+	timersub(&tv_end, &tv_start, &tv_diff);
+	secs = tv_diff.tv_sec + tv_diff.tv_usec / 1e6;
+	gb = st.bytes / (double)(1 << 30);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14lf MB/sec\n", st.bytes / secs / (1 << 20));
+		printf(" %14lf msecs of sender cpu time per GB\n",
+		       gb ? st.cpu_us / 1e3 / gb : 0.0);
+		if (zerocopy)
+			printf(" %14lf%% of %" PRIu64 " completed sends "
+			       "were copied\n",
+			       st.completions ? 100.0 * st.copied /
+						st.completions : 0.0,
+			       st.completions);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf %lf\n", st.bytes / secs / (1 << 20),
+		       gb ? st.cpu_us / 1e3 / gb : 0.0,
+		       st.completions ? 100.0 * st.copied / st.completions :
+					0.0);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
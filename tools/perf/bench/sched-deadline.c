@@ -0,0 +1,293 @@
+/*
+ * sched-deadline.c
+ *
+ * deadline: Periodic threads, each doing a fixed amount of work every
+ *           period, scheduled with SCHED_DEADLINE or SCHED_FIFO while
+ *           the same number of busy SCHED_OTHER hogs compete for the
+ *           cpus.  Counts the jobs that finish after their deadline.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE		6
+#endif
+
+#ifndef __NR_sched_setattr
+# if defined(__x86_64__)
+#  define __NR_sched_setattr	314
+# elif defined(__i386__)
+#  define __NR_sched_setattr	351
+# elif defined(__arm__)
+#  define __NR_sched_setattr	380
+# endif
+#endif
+
+struct bench_sched_attr {
+	u32 size;
+	u32 sched_policy;
+	u64 sched_flags;
+	s32 sched_nice;
+	u32 sched_priority;
+	u64 sched_runtime;
+	u64 sched_deadline;
+	u64 sched_period;
+};
+
+static int		nr_threads	= 4;
+static int		nr_hogs		= -1;
+static int		work_us		= 2000;
+static int		runtime_us	= 3000;
+static int		deadline_us	= 10000;
+static int		period_us	= 10000;
+static int		duration	= 5;
+static const char	*policy_str	= "deadline";
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of periodic threads"),
+	OPT_INTEGER('H', "hogs", &nr_hogs,
+		    "Specify number of busy SCHED_OTHER threads (default: online CPUs)"),
+	OPT_INTEGER('w', "work", &work_us,
+		    "Specify cpu time each job needs, in usecs"),
+	OPT_INTEGER('r', "runtime", &runtime_us,
+		    "Specify runtime reserved per period, in usecs"),
+	OPT_INTEGER('d', "deadline", &deadline_us,
+		    "Specify relative deadline of each job, in usecs"),
+	OPT_INTEGER('p', "period", &period_us,
+		    "Specify period, in usecs"),
+	OPT_INTEGER('l', "length", &duration,
+		    "Specify length of the run, in seconds"),
+	OPT_STRING('P', "policy", &policy_str, "deadline",
+		   "Policy of the periodic threads: deadline or fifo"),
+	OPT_END()
+};
+
+static const char * const bench_sched_deadline_usage[] = {
+	"perf bench sched deadline <options>",
+	NULL
+};
+
+struct periodic_worker {
+	pthread_t	thread;
+	int		fifo;
+	int		err;
+	u64		jobs;
+	u64		misses;
+	u64		max_lateness;	/* ns past the deadline */
+};
+
+static volatile int done;
+
+static inline u64 ts_to_ns(const struct timespec *ts)
+{
+	return (u64)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static inline void ns_to_ts(u64 ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+}
+
+static u64 thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts_to_ns(&ts);
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_to_ns(&ts);
+}
+
+/* Burn @us of cpu time, however long that takes on the clock */
+static void burn(int us)
+{
+	u64 end = thread_cpu_ns() + (u64)us * 1000;
+
+	while (thread_cpu_ns() < end)
+		;
+}
+
+static int set_policy(struct periodic_worker *w)
+{
+	struct bench_sched_attr attr;
+	struct sched_param param;
+
+	if (w->fifo) {
+		param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+		return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	}
+
+#ifdef __NR_sched_setattr
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_runtime = (u64)runtime_us * 1000;
+	attr.sched_deadline = (u64)deadline_us * 1000;
+	attr.sched_period = (u64)period_us * 1000;
+
+	if (syscall(__NR_sched_setattr, 0, &attr, 0) < 0)
+		return errno;
+	return 0;
+#else
+	(void)attr;
+	return ENOSYS;
+#endif
+}
+
+static void *periodic_worker(void *arg)
+{
+	struct periodic_worker *w = arg;
+	struct timespec ts;
+	u64 release, finish;
+
+	w->err = set_policy(w);
+	if (w->err)
+		return NULL;
+
+	release = now_ns();
+	while (!done) {
+		burn(work_us);
+		finish = now_ns();
+
+		w->jobs++;
+		if (finish > release + (u64)deadline_us * 1000) {
+			u64 late = finish - release - (u64)deadline_us * 1000;
+
+			w->misses++;
+			if (late > w->max_lateness)
+				w->max_lateness = late;
+		}
+
+		/*
+		 * Jobs are released strictly periodically: a late job
+		 * eats into the next period instead of shifting it.
+		 */
+		release += (u64)period_us * 1000;
+		if (release < finish)
+			continue;
+		ns_to_ts(release, &ts);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &ts, NULL) == EINTR)
+			;
+	}
+
+	return NULL;
+}
+
+static void *hog_worker(void *arg __used)
+{
+	while (!done)
+		;
+	return NULL;
+}
+
+int bench_sched_deadline(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	struct periodic_worker *workers;
+	pthread_t *hogs;
+	u64 jobs = 0, misses = 0, max_lateness = 0;
+	int fifo, i;
+
+	argc = parse_options(argc, argv, options, bench_sched_deadline_usage, 0);
+
+	if (!strcmp(policy_str, "fifo"))
+		fifo = 1;
+	else if (!strcmp(policy_str, "deadline"))
+		fifo = 0;
+	else {
+		fprintf(stderr, "Unknown policy:%s\n", policy_str);
+		return 1;
+	}
+	if (nr_hogs < 0)
+		nr_hogs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads <= 0 || work_us <= 0 || runtime_us <= 0 ||
+	    deadline_us < runtime_us || period_us < deadline_us ||
+	    duration <= 0) {
+		fprintf(stderr, "Invalid parameters, need "
+			"runtime <= deadline <= period\n");
+		return 1;
+	}
+
+	workers = zalloc(nr_threads * sizeof(*workers));
+	hogs = zalloc((nr_hogs + 1) * sizeof(*hogs));
+	if (!workers || !hogs)
+		die("memory allocation failed\n");
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d %s threads doing %d us every %d us "
+		       "(deadline %d us) against %d hogs for %d sec ...\n\n",
+		       nr_threads, fifo ? "SCHED_FIFO" : "SCHED_DEADLINE",
+		       work_us, period_us, deadline_us, nr_hogs, duration);
+
+	for (i = 0; i < nr_hogs; i++)
+		if (pthread_create(&hogs[i], NULL, hog_worker, NULL))
+			die("pthread_create failed\n");
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].fifo = fifo;
+		if (pthread_create(&workers[i].thread, NULL,
+				   periodic_worker, &workers[i]))
+			die("pthread_create failed\n");
+	}
+
+	sleep(duration);
+	done = 1;
+
+	for (i = 0; i < nr_hogs; i++)
+		pthread_join(hogs[i], NULL);
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].err) {
+			fprintf(stderr, "Setting %s failed: %s%s\n", policy_str,
+				strerror(workers[i].err),
+				workers[i].err == EBUSY ?
+				" (bandwidth over the admission limit)" : "");
+			return 1;
+		}
+		jobs += workers[i].jobs;
+		misses += workers[i].misses;
+		if (workers[i].max_lateness > max_lateness)
+			max_lateness = workers[i].max_lateness;
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14" PRIu64 " jobs\n", jobs);
+		printf(" %14" PRIu64 " deadline misses (%lf%%)\n", misses,
+		       jobs ? 100.0 * misses / jobs : 0.0);
+		printf(" %14lf usecs max lateness\n", max_lateness / 1e3);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%" PRIu64 " %" PRIu64 " %lf\n", jobs, misses,
+		       max_lateness / 1e3);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	free(workers);
+	free(hogs);
+	return 0;
+}
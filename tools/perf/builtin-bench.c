@@ -13,6 +13,9 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  futex ... futex operations and hash scalability
+ *  epoll ... event polling scalability
+ *  net   ... network send paths
  *
  */
 
@@ -42,6 +45,9 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "deadline",
+	  "Deadline misses of periodic threads against cpu hogs",
+	  bench_sched_deadline },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -52,6 +58,51 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "tlb",
+	  "Random page walk with small and transparent huge pages",
+	  bench_mem_tlb },
+	{ "reclaim",
+	  "Concurrent page cache streaming under memory pressure",
+	  bench_mem_reclaim },
+	{ "mmap",
+	  "Page faults against concurrent mmap/munmap in one process",
+	  bench_mem_mmap },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "wake",
+	  "Wake up threads blocked on one futex",
+	  bench_futex_wake },
+	{ "requeue",
+	  "Requeue threads from one futex to another",
+	  bench_futex_requeue },
+	{ "lock-pi",
+	  "Take and release PI futexes from all cpus",
+	  bench_futex_lock_pi },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite epoll_suites[] = {
+	{ "accept",
+	  "Threads with an epoll set each accepting on one socket",
+	  bench_epoll_accept },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
+static struct bench_suite net_suites[] = {
+	{ "zerocopy",
+	  "TCP stream sends with and without MSG_ZEROCOPY",
+	  bench_net_zerocopy },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -71,6 +122,15 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "futex",
+	  "futex operations",
+	  futex_suites },
+	{ "epoll",
+	  "event polling",
+	  epoll_suites },
+	{ "net",
+	  "network send paths",
+	  net_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },
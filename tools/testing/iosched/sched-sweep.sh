@@ -0,0 +1,173 @@
+#!/bin/sh
+#
+# Run the same workload against a block device under each I/O scheduler
+# and report IOPS and CPU cost per request.
+#
+# Meant for the null_blk driver, where the device costs nothing and all
+# of the time measured is spent in the block layer:
+#
+#	modprobe null_blk queue_mode=1 irqmode=1
+#	tools/testing/iosched/sched-sweep.sh -d nullb0
+#
+# The workload is fio if it is installed, parallel O_DIRECT dd readers
+# otherwise.  CPU cost is reported in cycles per request when perf is
+# available, in microseconds of busy CPU time per request otherwise.
+#
+# Licensed under the terms of the GNU GPL License version 2
+
+dev=nullb0
+scheds="noop deadline cfq bfq row sio zen"
+runtime=10
+jobs=$(grep -c ^processor /proc/cpuinfo)
+depth=32
+bs=4k
+rw=randread
+count=100000
+
+usage()
+{
+	cat <<USAGE
+usage: $0 [options]
+  -d dev	block device under /sys/block (default: $dev)
+  -s scheds	schedulers to test (default: "$scheds")
+  -t secs	run time per scheduler with fio (default: $runtime)
+  -j jobs	parallel submitters, or a list of counts to measure
+		scaling, e.g. "1 2 4" (default: nr of CPUs, $jobs)
+  -q depth	I/O depth per fio job (default: $depth)
+  -b bs		block size (default: $bs)
+  -w rw		fio pattern, e.g. randread, read, randwrite (default: $rw)
+  -n count	requests per dd reader when fio is missing (default: $count)
+USAGE
+	exit 1
+}
+
+while getopts "d:s:t:j:q:b:w:n:h" opt; do
+	case $opt in
+	d) dev=$OPTARG ;;
+	s) scheds=$OPTARG ;;
+	t) runtime=$OPTARG ;;
+	j) jobs=$OPTARG ;;
+	q) depth=$OPTARG ;;
+	b) bs=$OPTARG ;;
+	w) rw=$OPTARG ;;
+	n) count=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+
+sysq=/sys/block/$dev/queue
+if [ ! -d $sysq ]; then
+	echo "$0: no such block device: $dev" >&2
+	exit 1
+fi
+if [ ! -b /dev/$dev ]; then
+	echo "$0: /dev/$dev is missing" >&2
+	exit 1
+fi
+
+have() { command -v $1 >/dev/null 2>&1; }
+
+# completed reads + writes
+nr_ios()
+{
+	awk '{ print $1 + $5 }' /sys/block/$dev/stat
+}
+
+# busy jiffies across all CPUs: user nice system irq softirq
+busy_ticks()
+{
+	awk '/^cpu / { print $2 + $3 + $4 + $7 + $8 }' /proc/stat
+}
+
+now_ms()
+{
+	awk '{ printf "%d\n", $1 * 1000 }' /proc/uptime
+}
+
+workload()
+{
+	if have fio; then
+		fio --name=sweep --filename=/dev/$dev --direct=1 \
+		    --ioengine=libaio --rw=$rw --bs=$bs --iodepth=$depth \
+		    --numjobs=$jobs --time_based --runtime=$runtime \
+		    --group_reporting --minimal >/dev/null
+	else
+		i=0
+		pids=
+		while [ $i -lt $jobs ]; do
+			dd if=/dev/$dev of=/dev/null bs=$bs count=$count \
+			   skip=$((i * count)) iflag=direct 2>/dev/null &
+			pids="$pids $!"
+			i=$((i + 1))
+		done
+		wait $pids
+	fi
+}
+
+hz=$(getconf CLK_TCK 2>/dev/null || echo 100)
+tmp=$(mktemp /tmp/sched-sweep.XXXXXX) || exit 1
+trap 'rm -f $tmp' EXIT
+saved=$(sed -e 's/.*\[\(.*\)\].*/\1/' $sysq/scheduler)
+
+# bio based and multi-queue devices have no I/O scheduler
+if [ "$(cat $sysq/scheduler)" = none ]; then
+	scheds=none
+fi
+
+job_counts=$jobs
+
+printf "%-10s %5s %12s %12s\n" scheduler jobs IOPS "cost/req"
+
+for jobs in $job_counts; do
+for s in $scheds; do
+	if [ $s != none ]; then
+		if ! grep -qw $s $sysq/scheduler; then
+			printf "%-10s %5d %12s\n" $s $jobs "n/a"
+			continue
+		fi
+		echo $s > $sysq/scheduler
+	fi
+
+	cycles=
+	perf_pid=
+	if have perf; then
+		# system wide, so that softirq and kblockd work is counted
+		perf stat -a -x, -e cycles -o $tmp sleep 1000000 2>/dev/null &
+		perf_pid=$!
+	fi
+
+	ios0=$(nr_ios)
+	busy0=$(busy_ticks)
+	t0=$(now_ms)
+	workload
+	t1=$(now_ms)
+	busy1=$(busy_ticks)
+	ios1=$(nr_ios)
+
+	if [ -n "$perf_pid" ]; then
+		kill -INT $perf_pid
+		wait $perf_pid
+		cycles=$(awk -F, '/cycles/ { print $1 }' $tmp)
+		case $cycles in
+		''|*[!0-9]*) cycles= ;;
+		esac
+	fi
+
+	ios=$((ios1 - ios0))
+	ms=$((t1 - t0))
+	[ $ms -gt 0 ] || ms=1
+	[ $ios -gt 0 ] || ios=1
+
+	iops=$((ios * 1000 / ms))
+	if [ -n "$cycles" ]; then
+		per=$(awk "BEGIN { printf \"%d\", $cycles / $ios }")
+		unit=cycles
+	else
+		per=$(awk "BEGIN { printf \"%.2f\", ($busy1 - $busy0) * 1000000 / $hz / $ios }")
+		unit=cpu-us
+	fi
+	printf "%-10s %5d %12d %12s %s\n" $s $jobs $iops $per $unit
+done
+done
+
+[ $saved = none ] || echo $saved > $sysq/scheduler
@@ -0,0 +1,146 @@
+#!/bin/sh
+#
+# Check big.LITTLE task placement on a machine whose cpus are all the
+# same, by capping the capacity of some of them through debugfs.
+#
+# Meant to run in a guest, e.g. an ARM kernel with CONFIG_ARM_CPU_TOPOLOGY
+# and CONFIG_DEBUG_FS under
+#
+#	qemu-system-arm -M vexpress-a15 -smp 4 -kernel zImage ...
+#	tools/testing/sched/hmp-placement.sh -s "2 3" -c 430
+#
+# which models two Cortex-A15s and two Cortex-A7s.  A cpu bound loop
+# should end up on the fast cpus and a mostly sleeping one on the slow
+# cpus.  The sched_hmp_migrate tracepoint counts the moves made at
+# wakeup and those forced from the tick.
+#
+# Licensed under the terms of the GNU GPL License version 2
+
+debugfs=/sys/kernel/debug
+ncpus=$(grep -c ^processor /proc/cpuinfo)
+slow=
+capacity=430
+runtime=10
+samples=50
+pass=90
+
+usage()
+{
+	cat <<USAGE
+usage: $0 [options]
+  -s cpus	cpus to cap (default: the upper half)
+  -c cap	capacity of the capped cpus, out of 1024 (default: $capacity)
+  -t secs	settling time before sampling (default: $runtime)
+  -n count	placement samples, taken 100ms apart (default: $samples)
+  -p pct	share of samples on the right cpus to pass (default: $pass)
+USAGE
+	exit 1
+}
+
+while getopts "s:c:t:n:p:h" opt; do
+	case $opt in
+	s) slow=$OPTARG ;;
+	c) capacity=$OPTARG ;;
+	t) runtime=$OPTARG ;;
+	n) samples=$OPTARG ;;
+	p) pass=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+
+topo=$debugfs/cpu_topo
+events=$debugfs/tracing/events/sched/sched_hmp_migrate
+if [ ! -e $topo/cpu0/cpu_capacity ]; then
+	echo "$0: no $topo/cpu0/cpu_capacity, is debugfs mounted?" >&2
+	exit 1
+fi
+if [ $ncpus -lt 2 ]; then
+	echo "$0: needs at least two cpus" >&2
+	exit 1
+fi
+
+if [ -z "$slow" ]; then
+	i=$((ncpus / 2))
+	while [ $i -lt $ncpus ]; do
+		slow="$slow $i"
+		i=$((i + 1))
+	done
+fi
+
+is_slow()
+{
+	for s in $slow; do
+		[ $s -eq $1 ] && return 0
+	done
+	return 1
+}
+
+# cpu a task last ran on, field 39 of /proc/pid/stat
+task_cpu()
+{
+	awk '{ print $39 }' /proc/$1/stat
+}
+
+set_capacities()
+{
+	i=0
+	while [ $i -lt $ncpus ]; do
+		if is_slow $i; then
+			echo $1 > $topo/cpu$i/cpu_capacity
+		else
+			echo 1024 > $topo/cpu$i/cpu_capacity
+		fi
+		i=$((i + 1))
+	done
+}
+
+busy_pid=
+light_pid=
+cleanup()
+{
+	[ -n "$busy_pid" ] && kill $busy_pid 2>/dev/null
+	[ -n "$light_pid" ] && kill $light_pid 2>/dev/null
+	[ -e $events/enable ] && echo 0 > $events/enable
+	set_capacities 1024
+}
+trap cleanup EXIT
+
+set_capacities $capacity
+if [ -e $events/enable ]; then
+	echo > $debugfs/tracing/trace
+	echo 1 > $events/enable
+fi
+
+sh -c 'while :; do :; done' &
+busy_pid=$!
+sh -c 'while :; do sleep 1; done' &
+light_pid=$!
+
+sleep $runtime
+
+busy_ok=0
+light_ok=0
+i=0
+while [ $i -lt $samples ]; do
+	is_slow $(task_cpu $busy_pid) || busy_ok=$((busy_ok + 1))
+	is_slow $(task_cpu $light_pid) && light_ok=$((light_ok + 1))
+	sleep 0.1
+	i=$((i + 1))
+done
+
+busy_pct=$((busy_ok * 100 / samples))
+light_pct=$((light_ok * 100 / samples))
+printf "slow cpus:%s at capacity %d\n" "$slow" $capacity
+printf "%-8s %3d%% of samples on a fast cpu\n" busy $busy_pct
+printf "%-8s %3d%% of samples on a slow cpu\n" light $light_pct
+if [ -e $events/enable ]; then
+	printf "%-8s %3d up/down at wakeup, %d forced up\n" migrations \
+		$(grep -c "force=0" $debugfs/tracing/trace) \
+		$(grep -c "force=1" $debugfs/tracing/trace)
+fi
+
+if [ $busy_pct -lt $pass ] || [ $light_pct -lt $pass ]; then
+	echo FAIL
+	exit 1
+fi
+echo PASS